@@ -84,7 +84,7 @@ charbuf::seekoff(std::ios::off_type off, std::ios_base::seekdir dir,
             cpos = gptr() + off;
             break;
         case std::ios::end:
-            cpos = egptr() - off;
+            cpos = egptr() + off;
             break;
         default:
             break;  // Should never happen.
@@ -105,7 +105,7 @@ charbuf::seekoff(std::ios::off_type off, std::ios_base::seekdir dir,
             cpos = pptr() + off;
             break;
         case std::ios::end:
-            cpos = egptr() - off;
+            cpos = epptr() + off;
             break;
         default:
             break;  // Should never happen.
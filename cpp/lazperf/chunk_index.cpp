@@ -0,0 +1,270 @@
+/******************************************************************************
+* Copyright (c) 2026, Hobu Inc., info@hobu.co
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following
+* conditions are met:
+*
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in
+*       the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of Hobu, Inc. or Flaxen Geo Consulting nor the
+*       names of its contributors may be used to endorse or promote
+*       products derived from this software without specific prior
+*       written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+* COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+* OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+* AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+* OF SUCH DAMAGE.
+****************************************************************************/
+
+
+#include <algorithm>
+#include <fstream>
+
+#include "chunk_index.hpp"
+#include "Extractor.hpp"
+#include "Inserter.hpp"
+#include "excepts.hpp"
+
+namespace lazperf
+{
+
+namespace
+{
+
+const char Magic[4] { 'L', 'Z', 'I', 'X' };
+const uint32_t Version = 1;
+const size_t HeaderSize = 4 + 4 + 8 + 8 + 4;
+const size_t ChunkSize = 8 * sizeof(double);
+const size_t TreeHeaderSize = 4 * sizeof(double) + 4 + 4;
+const size_t CellHeaderSize = 4 * sizeof(uint32_t);
+
+} // unnamed namespace
+
+chunk_index::chunk_index() : point_count(0), data_end(0)
+{}
+
+uint64_t chunk_index::key(uint32_t level, uint32_t x, uint32_t y)
+{
+    return ((uint64_t)level << 48) | ((uint64_t)x << 24) | y;
+}
+
+uint32_t chunk_index::cell(double v, double min, double max, uint32_t level) const
+{
+    const uint32_t cells = 1 << level;
+    if (max <= min || v <= min)
+        return 0;
+    double pos = (v - min) / (max - min) * cells;
+    return pos >= cells ? cells - 1 : (uint32_t)pos;
+}
+
+void chunk_index::build(const std::vector<box>& bounds, const std::vector<double>& minTime,
+    const std::vector<double>& maxTime, uint64_t pointCount, uint64_t dataEnd)
+{
+    if (minTime.size() != bounds.size() || maxTime.size() != bounds.size())
+        throw error("Chunk index bounds and times must have the same number of entries.");
+
+    this->bounds = bounds;
+    min_time = minTime;
+    max_time = maxTime;
+    point_count = pointCount;
+    data_end = dataEnd;
+
+    extent_ = box();
+    for (const box& b : bounds)
+        if (!b.empty())
+        {
+            extent_.grow(b.min.x, b.min.y, b.min.z);
+            extent_.grow(b.max.x, b.max.y, b.max.z);
+        }
+    cells_.clear();
+    for (size_t i = 0; i < bounds.size(); ++i)
+        insert(i);
+}
+
+void chunk_index::insert(size_t chunk)
+{
+    const box& b = bounds[chunk];
+    if (b.empty())
+        return;
+
+    uint32_t level = Levels;
+    while (true)
+    {
+        uint32_t x = cell(b.min.x, extent_.min.x, extent_.max.x, level);
+        uint32_t y = cell(b.min.y, extent_.min.y, extent_.max.y, level);
+        if ((x == cell(b.max.x, extent_.min.x, extent_.max.x, level) &&
+            y == cell(b.max.y, extent_.min.y, extent_.max.y, level)) || level == 0)
+        {
+            cells_[key(level, x, y)].push_back((uint32_t)chunk);
+            return;
+        }
+        level--;
+    }
+}
+
+std::vector<size_t> chunk_index::query(const box& region, double minTime,
+    double maxTime) const
+{
+    std::vector<size_t> chunks;
+    // Only the XY extent is used for the tree.
+    if (cells_.empty() || region.min.x > extent_.max.x || region.max.x < extent_.min.x ||
+            region.min.y > extent_.max.y || region.max.y < extent_.min.y)
+        return chunks;
+
+    for (uint32_t level = 0; level <= Levels; ++level)
+    {
+        uint32_t x0 = cell(region.min.x, extent_.min.x, extent_.max.x, level);
+        uint32_t x1 = cell(region.max.x, extent_.min.x, extent_.max.x, level);
+        uint32_t y0 = cell(region.min.y, extent_.min.y, extent_.max.y, level);
+        uint32_t y1 = cell(region.max.y, extent_.min.y, extent_.max.y, level);
+        for (uint32_t x = x0; x <= x1; ++x)
+            for (uint32_t y = y0; y <= y1; ++y)
+            {
+                auto it = cells_.find(key(level, x, y));
+                if (it == cells_.end())
+                    continue;
+                for (uint32_t c : it->second)
+                    if (bounds[c].intersects(region) && max_time[c] >= minTime &&
+                            min_time[c] <= maxTime)
+                        chunks.push_back(c);
+            }
+    }
+    std::sort(chunks.begin(), chunks.end());
+    return chunks;
+}
+
+bool chunk_index::fill(const char *buf, size_t size)
+{
+    if (size < HeaderSize || !std::equal(Magic, Magic + 4, buf))
+        return false;
+
+    LeExtractor s(buf + 4, size - 4);
+    uint32_t version;
+    uint64_t pointCount;
+    uint64_t dataEnd;
+    uint32_t chunkCount;
+    s >> version >> pointCount >> dataEnd >> chunkCount;
+    if (version != Version || size < HeaderSize + chunkCount * ChunkSize + TreeHeaderSize)
+        return false;
+
+    std::vector<box> b(chunkCount);
+    std::vector<double> minTime(chunkCount);
+    std::vector<double> maxTime(chunkCount);
+    for (uint32_t i = 0; i < chunkCount; ++i)
+        s >> b[i].min.x >> b[i].min.y >> b[i].min.z >> b[i].max.x >> b[i].max.y >>
+            b[i].max.z >> minTime[i] >> maxTime[i];
+
+    box extent;
+    uint32_t levels;
+    uint32_t cellCount;
+    s >> extent.min.x >> extent.min.y >> extent.max.x >> extent.max.y >> levels >> cellCount;
+    if (levels != Levels)
+        return false;
+
+    std::map<uint64_t, std::vector<uint32_t>> cells;
+    size_t pos = HeaderSize + chunkCount * ChunkSize + TreeHeaderSize;
+    for (uint32_t i = 0; i < cellCount; ++i)
+    {
+        if (size < pos + CellHeaderSize)
+            return false;
+        uint32_t level, x, y, count;
+        s >> level >> x >> y >> count;
+        pos += CellHeaderSize + (size_t)count * sizeof(uint32_t);
+        if (size < pos || level > Levels || x >= (1u << level) || y >= (1u << level))
+            return false;
+        std::vector<uint32_t>& ids = cells[key(level, x, y)];
+        ids.resize(count);
+        for (uint32_t& id : ids)
+        {
+            s >> id;
+            if (id >= chunkCount)
+                return false;
+        }
+    }
+
+    bounds.swap(b);
+    min_time.swap(minTime);
+    max_time.swap(maxTime);
+    extent_ = extent;
+    cells_.swap(cells);
+    point_count = pointCount;
+    data_end = dataEnd;
+    return true;
+}
+
+std::vector<char> chunk_index::data() const
+{
+    size_t size = HeaderSize + bounds.size() * ChunkSize + TreeHeaderSize;
+    for (auto& c : cells_)
+        size += CellHeaderSize + c.second.size() * sizeof(uint32_t);
+
+    std::vector<char> buf(size);
+    std::copy(Magic, Magic + 4, buf.begin());
+    LeInserter s(buf.data() + 4, buf.size() - 4);
+    s << Version << point_count << data_end << (uint32_t)bounds.size();
+    for (size_t i = 0; i < bounds.size(); ++i)
+    {
+        const box& b = bounds[i];
+        s << b.min.x << b.min.y << b.min.z << b.max.x << b.max.y << b.max.z <<
+            min_time[i] << max_time[i];
+    }
+    s << extent_.min.x << extent_.min.y << extent_.max.x << extent_.max.y << Levels <<
+        (uint32_t)cells_.size();
+    for (auto& c : cells_)
+    {
+        s << (uint32_t)(c.first >> 48) << (uint32_t)((c.first >> 24) & 0xFFFFFF) <<
+            (uint32_t)(c.first & 0xFFFFFF) << (uint32_t)c.second.size();
+        for (uint32_t chunk : c.second)
+            s << chunk;
+    }
+    return buf;
+}
+
+bool chunk_index::read(const std::string& filename)
+{
+    std::ifstream in(filename, std::ios::binary | std::ios::ate);
+    if (!in)
+        return false;
+    std::vector<char> buf((size_t)in.tellg());
+    in.seekg(0);
+    in.read(buf.data(), buf.size());
+    if (!in)
+        return false;
+    return fill(buf.data(), buf.size());
+}
+
+void chunk_index::write(const std::string& filename) const
+{
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    std::vector<char> buf = data();
+    out.write(buf.data(), buf.size());
+    if (!out)
+        throw error("Couldn't write index file '" + filename + "'.");
+}
+
+std::string chunk_index::filename(const std::string& pointFilename)
+{
+    size_t slash = pointFilename.find_last_of("/\\");
+    size_t dot = pointFilename.find_last_of('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return pointFilename + ".lzi";
+    return pointFilename.substr(0, dot) + ".lzi";
+}
+
+} // namespace lazperf
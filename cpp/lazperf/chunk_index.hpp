@@ -0,0 +1,95 @@
+/******************************************************************************
+* Copyright (c) 2026, Hobu Inc., info@hobu.co
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following
+* conditions are met:
+*
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in
+*       the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of Hobu, Inc. or Flaxen Geo Consulting nor the
+*       names of its contributors may be used to endorse or promote
+*       products derived from this software without specific prior
+*       written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+* COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+* OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+* AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+* OF SUCH DAMAGE.
+****************************************************************************/
+
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "header.hpp"
+
+namespace lazperf
+{
+
+#pragma warning (push)
+#pragma warning (disable: 4251)
+// Spatial and temporal extents of the chunks of a compressed file, along with a coarse
+// quadtree of the chunks for finding those that may contain points in a query region.
+// The index can be saved to a sidecar file so that it needn't be recomputed.
+struct LAZPERF_EXPORT chunk_index
+{
+    chunk_index();
+
+    // Build the index from the extents of the chunks. 'pointCount' and 'dataEnd'
+    // (the position of the end of the last chunk) identify the file that was indexed.
+    void build(const std::vector<box>& bounds, const std::vector<double>& minTime,
+        const std::vector<double>& maxTime, uint64_t pointCount, uint64_t dataEnd);
+    // Find the chunks that may contain points in the region. Returned chunk indices are
+    // in ascending order.
+    std::vector<size_t> query(const box& region, double minTime, double maxTime) const;
+    bool empty() const
+    { return bounds.empty(); }
+
+    // Read an index from the serialized data. Returns false if the data isn't valid.
+    bool fill(const char *buf, size_t size);
+    std::vector<char> data() const;
+    // Read/write an index to a sidecar file. read() returns false if the file doesn't
+    // exist or isn't a valid index.
+    bool read(const std::string& filename);
+    void write(const std::string& filename) const;
+    // The name of the sidecar index file for a point file.
+    static std::string filename(const std::string& pointFilename);
+
+    std::vector<box> bounds;
+    std::vector<double> min_time;
+    std::vector<double> max_time;
+    uint64_t point_count;
+    uint64_t data_end;
+
+private:
+    // Chunks are placed in the deepest quadtree cell that contains their XY bounds.
+    // Cells are keyed by level and position.
+    static const uint32_t Levels = 6;
+    static uint64_t key(uint32_t level, uint32_t x, uint32_t y);
+    void insert(size_t chunk);
+    uint32_t cell(double v, double min, double max, uint32_t level) const;
+
+    box extent_;
+    std::map<uint64_t, std::vector<uint32_t>> cells_;
+};
+#pragma warning (pop)
+
+} // namespace lazperf
@@ -0,0 +1,154 @@
+/******************************************************************************
+* Copyright (c) 2026, Hobu Inc., info@hobu.co
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following
+* conditions are met:
+*
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in
+*       the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of Hobu, Inc. or Flaxen Geo Consulting nor the
+*       names of its contributors may be used to endorse or promote
+*       products derived from this software without specific prior
+*       written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+* COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+* OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+* AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+* OF SUCH DAMAGE.
+****************************************************************************/
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace lazperf
+{
+
+// The values of one dimension. Value 'i' is at (char *)data + i * stride. Columns are
+// destinations when decoding and sources when writing. A column without data isn't
+// written when decoding, and is read as zero when writing.
+template <typename T>
+struct column
+{
+    column() : data(nullptr), stride(sizeof(T))
+    {}
+
+    column(T *data, size_t stride = sizeof(T)) : data(data), stride(stride)
+    {}
+
+    explicit operator bool() const
+    { return data != nullptr; }
+
+    char *at(size_t i) const
+    { return reinterpret_cast<char *>(data) + i * stride; }
+
+    // The stride needn't be a multiple of the value size, so we don't assume alignment.
+    void put(size_t i, T val) const
+    { std::memcpy(at(i), &val, sizeof(T)); }
+
+    T get(size_t i) const
+    {
+        T val;
+        std::memcpy(&val, at(i), sizeof(T));
+        return val;
+    }
+
+    // Move the start of the column forward 'count' values.
+    void advance(size_t count)
+    {
+        if (data)
+            data = reinterpret_cast<T *>(at(count));
+    }
+
+    T *data;
+    size_t stride;
+};
+
+// Columns for decoded point data, or for point data to be written. Any column can be left
+// empty. Fields that don't exist in the point format are not written or read.
+struct point_columns
+{
+    point_columns() : origin{0, 0, 0}
+    {}
+
+    column<int32_t> x;
+    column<int32_t> y;
+    column<int32_t> z;
+    column<uint16_t> intensity;
+    column<uint8_t> return_number;
+    column<uint8_t> number_of_returns;
+    column<uint8_t> classification_flags;     // Formats 6-8 only.
+    column<uint8_t> scanner_channel;          // Formats 6-8 only.
+    column<uint8_t> scan_direction_flag;
+    column<uint8_t> edge_of_flight_line;
+    column<uint8_t> classification;
+    column<uint8_t> user_data;
+    column<int16_t> scan_angle;               // Scan angle rank for formats 0-3.
+    column<uint16_t> point_source_id;
+    column<double> gps_time;
+    column<uint16_t> red;
+    column<uint16_t> green;
+    column<uint16_t> blue;
+    column<uint16_t> nir;
+    // Each point's extra bytes are written contiguously starting at extra_bytes.at(i).
+    column<uint8_t> extra_bytes;
+    // X, Y and Z with the header scale and offset applied.
+    column<double> world_x;
+    column<double> world_y;
+    column<double> world_z;
+    // X, Y and Z with the header scale and offset applied, relative to 'origin'.
+    column<float> local_x;
+    column<float> local_y;
+    column<float> local_z;
+    double origin[3];
+
+    void advance(size_t count)
+    {
+        x.advance(count);
+        y.advance(count);
+        z.advance(count);
+        intensity.advance(count);
+        return_number.advance(count);
+        number_of_returns.advance(count);
+        classification_flags.advance(count);
+        scanner_channel.advance(count);
+        scan_direction_flag.advance(count);
+        edge_of_flight_line.advance(count);
+        classification.advance(count);
+        user_data.advance(count);
+        scan_angle.advance(count);
+        point_source_id.advance(count);
+        gps_time.advance(count);
+        red.advance(count);
+        green.advance(count);
+        blue.advance(count);
+        nir.advance(count);
+        extra_bytes.advance(count);
+        world_x.advance(count);
+        world_y.advance(count);
+        world_z.advance(count);
+        local_x.advance(count);
+        local_y.advance(count);
+        local_z.advance(count);
+    }
+};
+
+} // namespace lazperf
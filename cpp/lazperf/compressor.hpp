@@ -83,19 +83,34 @@ public:
         using models::arithmetic;
         using models::arithmetic_bit;
 
-        // maybe create the models
+        // maybe create the models, with their tables in one slab
         if (mBits.empty()) {
-            for (uint32_t i = 0; i < contexts; i++)
-                mBits.push_back(arithmetic(corr_bits+1));
+            size_t bytes = contexts * arithmetic::bytes(corr_bits + 1);
+            for (uint32_t i = 1; i <= corr_bits; i++)
+                bytes += arithmetic::bytes(i <= bits_high ? 1 << i : 1 << bits_high);
+            mSlab.allocate(bytes);
+
+            mBits = models::build(mSlab, contexts, corr_bits + 1);
 
             // mcorrector0 is already in init state
+            mCorrector.reserve(corr_bits);
             for (uint32_t i = 1; i <= corr_bits; i++) {
                 uint32_t v = i <= bits_high ? 1 << i : 1 << bits_high;
-                mCorrector.push_back(arithmetic(v));
+                mCorrector.emplace_back(mSlab, v);
             }
         }
     }
 
+    // Restore the models to their initial state without reallocating them.
+    void reset()
+    {
+        k = 0;
+        models::reset(mBits);
+        mCorrector0.reset();
+        for (models::arithmetic& m : mCorrector)
+            m.reset();
+    }
+
     unsigned int getK() const
     { return k; }
 
@@ -188,6 +203,7 @@ public:
     int32_t corr_min;
     int32_t corr_max;
 
+    models::slab mSlab;
     std::vector<models::arithmetic> mBits;
 
     models::arithmetic_bit mCorrector0;
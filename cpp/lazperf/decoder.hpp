@@ -130,6 +130,12 @@ public:
     ~arithmetic() {
     }
 
+    // Prepare to decode a new sequence from the same stream.
+    void reset()
+    {
+        init();
+    }
+
     template <typename TSrcStream>
     void initStream(TSrcStream& src, uint32_t cnt)
     {
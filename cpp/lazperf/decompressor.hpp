@@ -85,21 +85,37 @@ namespace decompressors
 
 				uint32_t i;
 
-				// maybe create the models
+				// maybe create the models, with their tables in one slab
 				if (mBits.empty()) {
-					for (i = 0; i < contexts; i++)
-						mBits.push_back(arithmetic(corr_bits+1));
+					size_t bytes = contexts * arithmetic::bytes(corr_bits + 1);
+#ifndef COMPRESS_ONLY_K
+					for (i = 1; i <= corr_bits; i++)
+						bytes += arithmetic::bytes(i <= bits_high ? 1 << i : 1 << bits_high);
+#endif
+					mSlab.allocate(bytes);
+
+					mBits = models::build(mSlab, contexts, corr_bits + 1);
 
 #ifndef COMPRESS_ONLY_K
 					// mcorrector0 is already initialized
+					mCorrector.reserve(corr_bits);
 					for (i = 1; i <= corr_bits; i++) {
 						uint32_t v = i <= bits_high ? 1 << i : 1 << bits_high;
-						mCorrector.push_back(arithmetic(v));
+						mCorrector.emplace_back(mSlab, v);
 					}
 #endif
 				}
 			}
 
+			// Restore the models to their initial state without reallocating them.
+			void reset() {
+				k = 0;
+				models::reset(mBits);
+				mCorrector0.reset();
+				for (models::arithmetic& m : mCorrector)
+					m.reset();
+			}
+
 			template<
 				typename TDecoder
 			>
@@ -214,6 +230,7 @@ namespace decompressors
 			int32_t corr_max;
 
 
+			models::slab mSlab;
 			std::vector<models::arithmetic> mBits;
 
 			models::arithmetic_bit mCorrector0;
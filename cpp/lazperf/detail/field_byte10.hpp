@@ -22,7 +22,7 @@
 ===============================================================================
 */
 
-#include <deque>
+#include <vector>
 
 namespace lazperf
 {
@@ -31,6 +31,9 @@ namespace detail
 
 class Byte10Base
 {
+public:
+    void reset();
+
 protected:
     Byte10Base(size_t count);
 
@@ -38,30 +41,130 @@ protected:
     bool have_last_;
     std::vector<uint8_t> lasts_;
     std::vector<uint8_t> diffs_;
-    std::deque<models::arithmetic> models_;
+    models::slab slab_;
+    std::vector<models::arithmetic> models_;
 };
 
+// If Count isn't negative, it's the number of bytes, which is then known at compile time,
+// and the 'count' passed to the constructor is ignored.
+template <typename TStream, int Count = -1>
 class Byte10Compressor : public Byte10Base
 {
 public:
-    Byte10Compressor(encoders::arithmetic<OutCbStream>& encoder, size_t count);
+    Byte10Compressor(encoders::arithmetic<TStream>& encoder, size_t count);
 
     const char *compress(const char *buf);
 
 private:
-    encoders::arithmetic<OutCbStream>& enc_;
+    size_t count() const
+    { return Count < 0 ? count_ : (size_t)Count; }
+
+    encoders::arithmetic<TStream>& enc_;
 };
 
+template <typename TStream, int Count = -1>
 class Byte10Decompressor : public Byte10Base
 {
 public:
-    Byte10Decompressor(decoders::arithmetic<InCbStream>& decoder, size_t count);
+    Byte10Decompressor(decoders::arithmetic<TStream>& decoder, size_t count);
 
     char *decompress(char *buf);
+    void decompress(const point_columns& cols, size_t idx);
 
 private:
-    decoders::arithmetic<InCbStream>& dec_;
+    size_t count() const
+    { return Count < 0 ? count_ : (size_t)Count; }
+
+    decoders::arithmetic<TStream>& dec_;
 };
 
+inline Byte10Base::Byte10Base(size_t count) : count_(count), have_last_(false),
+    lasts_(count), diffs_(count), slab_(count * models::arithmetic::bytes(256)),
+    models_(models::build(slab_, count, 256))
+{}
+
+// Restore the state at construction without reallocating the models.
+inline void Byte10Base::reset()
+{
+    have_last_ = false;
+    std::fill(lasts_.begin(), lasts_.end(), 0);
+    std::fill(diffs_.begin(), diffs_.end(), 0);
+    models::reset(models_);
+}
+
+// COMPRESSOR
+
+template <typename TStream, int Count>
+Byte10Compressor<TStream, Count>::Byte10Compressor(encoders::arithmetic<TStream>& encoder,
+        size_t count) : Byte10Base(Count < 0 ? count : (size_t)Count), enc_(encoder)
+{}
+
+template <typename TStream, int Count>
+const char *Byte10Compressor<TStream, Count>::compress(const char *buf)
+{
+    const size_t n = count();
+    if (n == 0)
+        return buf;
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        diffs_[i] = buf[i] - lasts_[i];
+        lasts_[i] = buf[i];
+    }
+
+    if (!have_last_)
+    {
+        enc_.getOutStream().putBytes(lasts_.data(), n);
+        have_last_ = true;
+    }
+    else
+    {
+        auto mi = models_.begin();
+        for (size_t i = 0; i < n; ++i)
+            enc_.encodeSymbol(*mi++, diffs_[i]);
+    }
+    return buf + n;
+}
+
+// DECOMPRESSOR
+
+template <typename TStream, int Count>
+Byte10Decompressor<TStream, Count>::Byte10Decompressor(decoders::arithmetic<TStream>& decoder,
+        size_t count) : Byte10Base(Count < 0 ? count : (size_t)Count), dec_(decoder)
+{}
+
+template <typename TStream, int Count>
+char *Byte10Decompressor<TStream, Count>::decompress(char *buf)
+{
+    const size_t n = count();
+    if (n == 0)
+        return buf;
+
+    if (!have_last_)
+    {
+        dec_.getInStream().getBytes((unsigned char *)buf, n);
+        std::copy(buf, buf + n, lasts_.data());
+        have_last_ = true;
+        return buf + n;
+    }
+    auto mi = models_.begin();
+    for (size_t i = 0; i < n; ++i)
+        lasts_[i] = buf[i] = (uint8_t)(lasts_[i] + dec_.decodeSymbol(*mi++));
+    return buf + n;
+}
+
+template <typename TStream, int Count>
+void Byte10Decompressor<TStream, Count>::decompress(const point_columns& cols, size_t idx)
+{
+    if (count() == 0)
+        return;
+
+    // Without a destination, decompress into the diff vector, which is scratch space.
+    if (cols.extra_bytes)
+        decompress(cols.extra_bytes.at(idx));
+    else
+        decompress(reinterpret_cast<char *>(diffs_.data()));
+}
+
 } // namespace detail
 } // namespace lazperf
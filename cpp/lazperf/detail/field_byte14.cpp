@@ -35,8 +35,7 @@ namespace lazperf
 namespace detail
 {
 
-Byte14Base::Byte14Base(size_t count) : count_(count), last_channel_(-1),
-    chan_ctxs_ { count_, count_, count_, count_ }
+Byte14Base::Byte14Base(size_t count) : count_(count), last_channel_(-1)
 {}
 
 size_t Byte14Base::count() const
@@ -44,6 +43,14 @@ size_t Byte14Base::count() const
     return count_;
 }
 
+void Byte14Base::reset()
+{
+    for (std::unique_ptr<ChannelCtx>& c : chan_ctxs_)
+        if (c)
+            c->reset();
+    last_channel_ = -1;
+}
+
 // COMPRESSOR
 
 Byte14Compressor::Byte14Compressor(OutCbStream& stream, size_t count) :
@@ -51,6 +58,18 @@ Byte14Compressor::Byte14Compressor(OutCbStream& stream, size_t count) :
     byte_enc_(count, encoders::arithmetic<MemoryStream>(true))
 {}
 
+// Prepare to compress a new chunk once its data has been written.
+void Byte14Compressor::reset()
+{
+    Byte14Base::reset();
+    for (size_t i = 0; i < count_; ++i)
+    {
+        valid_[i] = false;
+        byte_enc_[i].reset();
+        byte_enc_[i].getOutStream().clear();
+    }
+}
+
 void Byte14Compressor::writeSizes()
 {
     for (size_t i = 0; i < count_; ++i)
@@ -85,15 +104,15 @@ const char *Byte14Compressor::compress(const char *buf, int& sc)
     // have last stuff and move on
     if (last_channel_ == -1)
     {
-        ChannelCtx& c = chan_ctxs_[sc];
+        ChannelCtx& c = channelCtx(sc);
         stream_.putBytes((const unsigned char *)buf, count_);
         c.last_.assign(buf, buf + count_);
         c.have_last_ = true;
         last_channel_ = sc;
         return buf + count_;
     }
-    ChannelCtx& c = chan_ctxs_[sc];
-    las::byte14 *pLastBytes = &chan_ctxs_[last_channel_].last_;
+    ChannelCtx& c = channelCtx(sc);
+    las::byte14 *pLastBytes = &channelCtx(last_channel_).last_;
     if (!c.have_last_)
     {
         c.have_last_ = true;
@@ -116,14 +135,25 @@ const char *Byte14Compressor::compress(const char *buf, int& sc)
     }
 
     last_channel_ = sc;
-    return buf + count_;
+    return buf;
 }
 
 // DECOMPRESSOR
 
-Byte14Decompressor::Byte14Decompressor(InCbStream& stream, size_t count) : Byte14Base(count),
-    stream_(stream), byte_cnt_(count_), byte_dec_(count_, decoders::arithmetic<MemoryStream>())
-{}
+Byte14Decompressor::Byte14Decompressor(LayerSource& stream, size_t count, uint32_t layers) :
+    Byte14Base(count), stream_(stream), selected_(count_), scratch_(count_), byte_cnt_(count_),
+    byte_dec_(count_, decoders::arithmetic<LayerStream>())
+{
+    for (size_t i = 0; i < count_; ++i)
+        selected_[i] = layer::byteSelected(layers, i);
+}
+
+void Byte14Decompressor::reset()
+{
+    Byte14Base::reset();
+    for (auto& dec : byte_dec_)
+        dec.reset();
+}
 
 void Byte14Decompressor::readSizes()
 {
@@ -134,7 +164,15 @@ void Byte14Decompressor::readSizes()
 void Byte14Decompressor::readData()
 {
     for (size_t i = 0; i < count_; ++i)
-        byte_dec_[i].initStream(stream_, byte_cnt_[i]);
+    {
+        if (selected_[i])
+            byte_dec_[i].initStream(stream_, byte_cnt_[i]);
+        else
+        {
+            stream_.skip(byte_cnt_[i]);
+            byte_cnt_[i] = 0;
+        }
+    }
 }
 
 void Byte14Decompressor::dumpSums()
@@ -146,16 +184,19 @@ char *Byte14Decompressor::decompress(char *buf, int& sc)
 {
     if (last_channel_ == -1)
     {
-        ChannelCtx& c = chan_ctxs_[sc];
+        ChannelCtx& c = channelCtx(sc);
         stream_.getBytes((unsigned char *)buf, count_);
         c.last_.assign(buf, buf + count_);
         c.have_last_ = true;
         last_channel_ = sc;
+        for (size_t i = 0; i < count_; ++i)
+            if (!selected_[i])
+                buf[i] = 0;
         return buf + count_;
     }
 
-    ChannelCtx& c = chan_ctxs_[sc];
-    las::byte14 *pLastByte = &chan_ctxs_[last_channel_].last_;
+    ChannelCtx& c = channelCtx(sc);
+    las::byte14 *pLastByte = &channelCtx(last_channel_).last_;
     if (sc != last_channel_)
     {
         last_channel_ = sc;
@@ -163,7 +204,7 @@ char *Byte14Decompressor::decompress(char *buf, int& sc)
         {
             c.have_last_ = true;
             c.last_ = *pLastByte;
-            pLastByte = &chan_ctxs_[last_channel_].last_;
+            pLastByte = &channelCtx(last_channel_).last_;
         }
     }
     las::byte14& lastByte = *pLastByte;
@@ -175,13 +216,23 @@ char *Byte14Decompressor::decompress(char *buf, int& sc)
             *buf = lastByte[i] + byte_dec_[i].decodeSymbol(c.byte_model_[i]);
             lastByte[i] = *buf;
         }
-        else
+        else if (selected_[i])
             *buf = lastByte[i];
+        else
+            *buf = 0;
     }
     LAZDEBUG(sumByte.add(lastByte.data(), count_));
 
     return buf;
 }
 
+void Byte14Decompressor::decompress(const point_columns& cols, size_t idx, int& sc)
+{
+    if (cols.extra_bytes)
+        decompress(cols.extra_bytes.at(idx), sc);
+    else
+        decompress(scratch_.data(), sc);
+}
+
 } // namespace detail
 } // namespace lazperf
@@ -40,11 +40,20 @@ protected:
     {
         int have_last_;
         las::byte14 last_;
+        models::slab slab_;
         std::vector<models::arithmetic> byte_model_;
 
         ChannelCtx(size_t count) : have_last_(false), last_(count),
-            byte_model_(count, models::arithmetic(256))
+            slab_(count * models::arithmetic::bytes(256)),
+            byte_model_(models::build(slab_, count, 256))
         {}
+
+        void reset()
+        {
+            have_last_ = false;
+            std::fill(last_.begin(), last_.end(), 0);
+            models::reset(byte_model_);
+        }
     };
 
 public:
@@ -53,9 +62,20 @@ public:
 protected:
     Byte14Base(size_t count);
 
+    void reset();
+
+    // Get the context of a scanner channel, building it on first use.
+    ChannelCtx& channelCtx(int sc)
+    {
+        std::unique_ptr<ChannelCtx>& c = chan_ctxs_[sc];
+        if (!c)
+            c.reset(new ChannelCtx(count_));
+        return *c;
+    }
+
     size_t count_;
     int last_channel_;
-    std::array<ChannelCtx, 4> chan_ctxs_;
+    std::array<std::unique_ptr<ChannelCtx>, 4> chan_ctxs_;
     std::vector<decoders::arithmetic<MemoryStream>> byte_dec_;
 };
 
@@ -67,6 +87,7 @@ public:
     void writeSizes();
     void writeData();
     const char *compress(const char *buf, int& sc);
+    void reset();
 
 private:
     OutCbStream& stream_;
@@ -77,17 +98,21 @@ private:
 class Byte14Decompressor : public Byte14Base
 {
 public:
-    Byte14Decompressor(InCbStream& stream, size_t count);
+    Byte14Decompressor(LayerSource& stream, size_t count, uint32_t layers = layer::All);
 
     void dumpSums();
     void readSizes();
     void readData();
     char *decompress(char *buf, int& sc);
+    void decompress(const point_columns& cols, size_t idx, int& sc);
+    void reset();
 
 private:
-    InCbStream& stream_;
+    LayerSource& stream_;
+    std::vector<bool> selected_;
+    std::vector<char> scratch_;
     std::vector<uint32_t> byte_cnt_;
-    std::vector<decoders::arithmetic<MemoryStream>> byte_dec_;
+    std::vector<decoders::arithmetic<LayerStream>> byte_dec_;
     utils::Summer sumByte;
 };
 
@@ -35,8 +35,24 @@ namespace lazperf
 namespace detail
 {
 
+void Nir14Base::reset()
+{
+    for (std::unique_ptr<ChannelCtx>& c : chan_ctxs_)
+        if (c)
+            c->reset();
+    last_channel_ = -1;
+}
+
 // COMPRESSOR
 
+// Prepare to compress a new chunk once its data has been written.
+void Nir14Compressor::reset()
+{
+    Nir14Base::reset();
+    nir_enc_.reset(false);
+    nir_enc_.getOutStream().clear();
+}
+
 void Nir14Compressor::writeSizes()
 {
     nir_enc_.done();
@@ -60,7 +76,7 @@ const char *Nir14Compressor::compress(const char *buf, int& sc)
     // have last stuff and move on
     if (last_channel_ == -1)
     {
-        ChannelCtx& c = chan_ctxs_[sc];
+        ChannelCtx& c = channelCtx(sc);
         stream_.putBytes((const unsigned char*)&nir, sizeof(las::nir14));
         c.last_ = nir;
         c.have_last_ = true;
@@ -68,8 +84,8 @@ const char *Nir14Compressor::compress(const char *buf, int& sc)
         return buf + sizeof(las::nir14);
     }
 
-    ChannelCtx& c = chan_ctxs_[sc];
-    las::nir14 *pLastNir = &chan_ctxs_[last_channel_].last_;
+    ChannelCtx& c = channelCtx(sc);
+    las::nir14 *pLastNir = &channelCtx(last_channel_).last_;
     if (!c.have_last_)
     {
         c.have_last_ = true;
@@ -110,6 +126,12 @@ void Nir14Decompressor::dumpSums()
     std::cout << "NIR      : " << sumNir.value() << "\n";
 }
 
+void Nir14Decompressor::reset()
+{
+    Nir14Base::reset();
+    nir_dec_.reset();
+}
+
 void Nir14Decompressor::readSizes()
 {
     stream_ >> nir_cnt_;
@@ -117,29 +139,44 @@ void Nir14Decompressor::readSizes()
 
 void Nir14Decompressor::readData()
 {
-    nir_dec_.initStream(stream_, nir_cnt_);
+    if (selected_)
+        nir_dec_.initStream(stream_, nir_cnt_);
+    else
+        stream_.skip(nir_cnt_);
 }
 
 char *Nir14Decompressor::decompress(char *buf, int& sc)
+{
+    decode(sc).pack(buf);
+    return buf + sizeof(las::nir14);
+}
+
+void Nir14Decompressor::decompress(const point_columns& cols, size_t idx, int& sc)
+{
+    las::nir14 nir = decode(sc);
+    if (cols.nir)
+        cols.nir.put(idx, nir.val);
+}
+
+las::nir14 Nir14Decompressor::decode(int& sc)
 {
     if (last_channel_ == -1)
     {
-        ChannelCtx& c = chan_ctxs_[sc];
+        ChannelCtx& c = channelCtx(sc);
+        char buf[sizeof(las::nir14)];
         stream_.getBytes((unsigned char*)buf, sizeof(las::nir14));
         c.last_.unpack(buf);
         c.have_last_ = true;
         last_channel_ = sc;
-        return buf + sizeof(las::nir14);
+        return selected_ ? c.last_ : las::nir14();
     }
+    if (!selected_)
+        return las::nir14();
     if (nir_cnt_ == 0)
-    {
-        las::nir14 *nir = reinterpret_cast<las::nir14 *>(buf);
-        *nir = chan_ctxs_[last_channel_].last_;
-        return buf + sizeof(las::nir14);
-    }
+        return channelCtx(last_channel_).last_;
 
-    ChannelCtx& c = chan_ctxs_[sc];
-    las::nir14 *pLastNir = &chan_ctxs_[last_channel_].last_;
+    ChannelCtx& c = channelCtx(sc);
+    las::nir14 *pLastNir = &channelCtx(last_channel_).last_;
     if (sc != last_channel_)
     {
         last_channel_ = sc;
@@ -147,7 +184,7 @@ char *Nir14Decompressor::decompress(char *buf, int& sc)
         {
             c.have_last_ = true;
             c.last_ = *pLastNir;
-            pLastNir = &chan_ctxs_[last_channel_].last_;
+            pLastNir = &channelCtx(last_channel_).last_;
         }
     }
     las::nir14& lastNir = *pLastNir;
@@ -174,8 +211,7 @@ char *Nir14Decompressor::decompress(char *buf, int& sc)
     LAZDEBUG(sumNir.add(nir));
 
     lastNir = nir;
-    nir.pack(buf);
-    return buf + sizeof(las::nir14);
+    return nir;
 }
 
 } // namespace detail
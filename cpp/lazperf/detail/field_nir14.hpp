@@ -40,15 +40,37 @@ protected:
     {
         int have_last_;
         las::nir14 last_;
+        models::slab slab_;
         models::arithmetic used_model_;
         std::array<models::arithmetic, 2> diff_model_;
 
-        ChannelCtx() : have_last_{false}, used_model_(4),
-            diff_model_{ models::arithmetic(256), models::arithmetic(256) }
+        ChannelCtx() : have_last_{false},
+            slab_(models::arithmetic::bytes(4) + 2 * models::arithmetic::bytes(256)),
+            used_model_(slab_, 4),
+            diff_model_{ models::arithmetic(slab_, 256), models::arithmetic(slab_, 256) }
         {}
+
+        void reset()
+        {
+            have_last_ = false;
+            last_ = las::nir14();
+            used_model_.reset();
+            models::reset(diff_model_);
+        }
     };
 
-    std::array<ChannelCtx, 4> chan_ctxs_;
+    void reset();
+
+    // Get the context of a scanner channel, building it on first use.
+    ChannelCtx& channelCtx(int sc)
+    {
+        std::unique_ptr<ChannelCtx>& c = chan_ctxs_[sc];
+        if (!c)
+            c.reset(new ChannelCtx());
+        return *c;
+    }
+
+    std::array<std::unique_ptr<ChannelCtx>, 4> chan_ctxs_;
     int last_channel_ = -1;
 };
 
@@ -61,6 +83,7 @@ public:
     void writeSizes();
     void writeData();
     const char *compress(const char *buf, int& sc);
+    void reset();
 
 private:
     OutCbStream& stream_;
@@ -70,18 +93,24 @@ private:
 class Nir14Decompressor : public Nir14Base
 {
 public:
-    Nir14Decompressor(InCbStream& stream) : stream_(stream)
+    Nir14Decompressor(LayerSource& stream, bool selected = true) : stream_(stream),
+        selected_(selected)
     {}
 
     void dumpSums();
     void readSizes();
     void readData();
     char *decompress(char *buf, int& sc);
+    void decompress(const point_columns& cols, size_t idx, int& sc);
+    void reset();
 
 private:
-    InCbStream& stream_;
+    las::nir14 decode(int& sc);
+
+    LayerSource& stream_;
+    bool selected_;
     uint32_t nir_cnt_;
-    decoders::arithmetic<MemoryStream> nir_dec_;
+    decoders::arithmetic<LayerStream> nir_dec_;
     utils::Summer sumNir;
 };
 
@@ -5,7 +5,6 @@
 
   CONTENTS:
 
-
   PROGRAMMERS:
 
     martin.isenburg@rapidlasso.com  -  http://rapidlasso.com
@@ -38,9 +37,14 @@ namespace detail
 
 class Point10Base
 {
+public:
+    // Write the fields of a point to the columns at index 'idx'.
+    static void store(const las::point10& p, const point_columns& cols, size_t idx);
+
 protected:
     Point10Base();
-    ~Point10Base();
+
+    void reset();
 
     las::point10 last_;
     std::array<unsigned short, 16> last_intensity;
@@ -49,27 +53,31 @@ protected:
     std::array<utils::streaming_median<int>, 16> last_y_diff_median5;
 
     std::array<int, 8> last_height;
+    // Holds the tables of the models below.
+    models::slab m_slab;
     models::arithmetic m_changed_values;
 
-    // Arithmetic model has no default constructor, so we store they here as raw pointers
-    std::array<models::arithmetic*, 2> m_scan_angle_rank;
-    std::array<models::arithmetic*, 256> m_bit_byte;
-    std::array<models::arithmetic*, 256> m_classification;
-    std::array<models::arithmetic*, 256> m_user_data;
+    std::array<models::arithmetic, 2> m_scan_angle_rank;
+    // Indexed by the previous value of the field.
+    std::vector<models::arithmetic> m_bit_byte;
+    std::vector<models::arithmetic> m_classification;
+    std::vector<models::arithmetic> m_user_data;
     bool have_last_;
 };
 
+template <typename TStream>
 class Point10Compressor : public Point10Base
 {
 public:
-    Point10Compressor(encoders::arithmetic<OutCbStream>&);
+    Point10Compressor(encoders::arithmetic<TStream>&);
 
     const char *compress(const char *buf);
+    void reset();
 
 private:
     void init();
 
-    encoders::arithmetic<OutCbStream>& enc_;
+    encoders::arithmetic<TStream>& enc_;
     compressors::integer ic_intensity;
     compressors::integer ic_point_source_ID;
     compressors::integer ic_dx;
@@ -78,24 +86,453 @@ private:
     bool compressors_inited_;
 };
 
+template <typename TStream>
 class Point10Decompressor : public Point10Base
 {
 public:
-    Point10Decompressor(decoders::arithmetic<InCbStream>&);
+    Point10Decompressor(decoders::arithmetic<TStream>&);
 
     char *decompress(char *buf);
+    void decompress(const point_columns& cols, size_t idx);
+    void reset();
 
 private:
     void init();
+    void readFirst(char *buf);
+    void decode();
 
-    decoders::arithmetic<InCbStream>& dec_;
+    decoders::arithmetic<TStream>& dec_;
     decompressors::integer ic_intensity;
     decompressors::integer ic_point_source_ID;
     decompressors::integer ic_dx;
     decompressors::integer ic_dy;
     decompressors::integer ic_z;
-    bool decompressors_inited_;
 };
 
+// for LAS files with the return (r) and the number (n) of
+// returns field correctly populated the mapping should really
+// be only the following.
+//  { 15, 15, 15, 15, 15, 15, 15, 15 },
+//  { 15,  0, 15, 15, 15, 15, 15, 15 },
+//  { 15,  1,  2, 15, 15, 15, 15, 15 },
+//  { 15,  3,  4,  5, 15, 15, 15, 15 },
+//  { 15,  6,  7,  8,  9, 15, 15, 15 },
+//  { 15, 10, 11, 12, 13, 14, 15, 15 },
+//  { 15, 15, 15, 15, 15, 15, 15, 15 },
+//  { 15, 15, 15, 15, 15, 15, 15, 15 }
+// however, some files start the numbering of r and n with 0,
+// only have return counts r, or only have number of return
+// counts n, or mix up the position of r and n. we therefore
+// "complete" the table to also map those "undesired" r & n
+// combinations to different contexts
+const unsigned char number_return_map[8][8] =
+{
+    { 15, 14, 13, 12, 11, 10,  9,  8 },
+    { 14,  0,  1,  3,  6, 10, 10,  9 },
+    { 13,  1,  2,  4,  7, 11, 11, 10 },
+    { 12,  3,  4,  5,  8, 12, 12, 11 },
+    { 11,  6,  7,  8,  9, 13, 13, 12 },
+    { 10, 10, 11, 12, 13, 14, 14, 13 },
+    {  9, 10, 11, 12, 13, 14, 15, 14 },
+    {  8,  9, 10, 11, 12, 13, 14, 15 }
+};
+
+// for LAS files with the return (r) and the number (n) of
+// returns field correctly populated the mapping should really
+// be only the following.
+//  {  0,  7,  7,  7,  7,  7,  7,  7 },
+//  {  7,  0,  7,  7,  7,  7,  7,  7 },
+//  {  7,  1,  0,  7,  7,  7,  7,  7 },
+//  {  7,  2,  1,  0,  7,  7,  7,  7 },
+//  {  7,  3,  2,  1,  0,  7,  7,  7 },
+//  {  7,  4,  3,  2,  1,  0,  7,  7 },
+//  {  7,  5,  4,  3,  2,  1,  0,  7 },
+//  {  7,  6,  5,  4,  3,  2,  1,  0 }
+// however, some files start the numbering of r and n with 0,
+// only have return counts r, or only have number of return
+// counts n, or mix up the position of r and n. we therefore
+// "complete" the table to also map those "undesired" r & n
+// combinations to different contexts
+const unsigned char number_return_level[8][8] =
+{
+    {  0,  1,  2,  3,  4,  5,  6,  7 },
+    {  1,  0,  1,  2,  3,  4,  5,  6 },
+    {  2,  1,  0,  1,  2,  3,  4,  5 },
+    {  3,  2,  1,  0,  1,  2,  3,  4 },
+    {  4,  3,  2,  1,  0,  1,  2,  3 },
+    {  5,  4,  3,  2,  1,  0,  1,  2 },
+    {  6,  5,  4,  3,  2,  1,  0,  1 },
+    {  7,  6,  5,  4,  3,  2,  1,  0 }
+};
+
+inline int changed_values(const las::point10& this_val, const las::point10& last,
+    unsigned short last_intensity)
+{
+    // This logic here constructs a 5-bit changed value which is basically a bit map of
+    // what has changed since the last point, not considering the x, y and z values
+    int bitfields_changed = (
+        (last.return_number ^ this_val.return_number) |
+        (last.number_of_returns_of_given_pulse ^ this_val.number_of_returns_of_given_pulse) |
+        (last.scan_direction_flag ^ this_val.scan_direction_flag) |
+        (last.edge_of_flight_line ^ this_val.edge_of_flight_line)) != 0;
+
+    // last intensity is not checked with last point, but the passed in last intensity value
+    int intensity_changed = (last_intensity ^ this_val.intensity) != 0;
+    int classification_changed = (last.classification ^ this_val.classification) != 0;
+    int scan_angle_rank_changed = (last.scan_angle_rank ^ this_val.scan_angle_rank) != 0;
+    int user_data_changed = (last.user_data ^ this_val.user_data) != 0;
+    int point_source_changed = (last.point_source_ID ^ this_val.point_source_ID) != 0;
+
+    return (bitfields_changed << 5) |
+           (intensity_changed << 4) |
+           (classification_changed << 3) |
+           (scan_angle_rank_changed << 2) |
+           (user_data_changed << 1) |
+           (point_source_changed);
+}
+
+inline Point10Base::Point10Base() :
+    m_slab(models::arithmetic::bytes(64) + (2 + 3 * 256) * models::arithmetic::bytes(256)),
+    m_changed_values(m_slab, 64),
+    m_scan_angle_rank{ models::arithmetic(m_slab, 256), models::arithmetic(m_slab, 256) },
+    m_bit_byte(models::build(m_slab, 256, 256)),
+    m_classification(models::build(m_slab, 256, 256)),
+    m_user_data(models::build(m_slab, 256, 256)), have_last_(false)
+{
+    last_intensity.fill(0);
+    last_height.fill(0);
+}
+
+// Restore the state at construction without reallocating the models.
+inline void Point10Base::reset()
+{
+    last_intensity.fill(0);
+    for (auto& m : last_x_diff_median5)
+        m.init();
+    for (auto& m : last_y_diff_median5)
+        m.init();
+    last_height.fill(0);
+    m_changed_values.reset();
+    models::reset(m_scan_angle_rank);
+    models::reset(m_bit_byte);
+    models::reset(m_classification);
+    models::reset(m_user_data);
+    have_last_ = false;
+}
+
+// COMPRESSOR
+
+template <typename TStream>
+Point10Compressor<TStream>::Point10Compressor(encoders::arithmetic<TStream>& enc) : enc_(enc),
+    ic_intensity(16, 4), ic_point_source_ID(16), ic_dx(32, 2), ic_dy(32, 22), ic_z(32, 20),
+    compressors_inited_(false)
+{}
+
+template <typename TStream>
+void Point10Compressor<TStream>::init()
+{
+    ic_intensity.init();
+    ic_point_source_ID.init();
+    ic_dx.init();
+    ic_dy.init();
+    ic_z.init();
+}
+
+template <typename TStream>
+void Point10Compressor<TStream>::reset()
+{
+    Point10Base::reset();
+    ic_intensity.reset();
+    ic_point_source_ID.reset();
+    ic_dx.reset();
+    ic_dy.reset();
+    ic_z.reset();
+}
+
+template <typename TStream>
+const char *Point10Compressor<TStream>::compress(const char *buf)
+{
+    las::point10 this_val(buf);
+
+    if (!compressors_inited_)
+    {
+        init();
+        compressors_inited_ = true;
+    }
+
+    // don't have the first data yet, just push it to our have last stuff and move on
+    if (!have_last_)
+    {
+        have_last_ = true;
+        last_ = this_val;
+
+        // write this out to the encoder as it is
+        enc_.getOutStream().putBytes((const unsigned char*)buf, sizeof(las::point10));
+        return buf + sizeof(las::point10);
+    }
+
+    // this is not the first point we're trying to compress, do crazy things
+    unsigned int r = this_val.return_number,
+                 n = this_val.number_of_returns_of_given_pulse,
+                 m = number_return_map[n][r],
+                 l = number_return_level[n][r];
+
+    unsigned int k_bits;
+    int median, diff;
+
+    // compress which other values have changed
+    int changed_values = detail::changed_values(this_val, last_, last_intensity[m]);
+    enc_.encodeSymbol(m_changed_values, changed_values);
+
+    // if any of the bit fields changed, compress them
+    if (changed_values & (1 << 5))
+    {
+        unsigned char b = this_val.from_bitfields();
+        unsigned char last_b = last_.from_bitfields();
+        enc_.encodeSymbol(m_bit_byte[last_b], b);
+    }
+
+    // if the intensity changed, compress it
+    if (changed_values & (1 << 4))
+    {
+        ic_intensity.compress(enc_, last_intensity[m], this_val.intensity, (m < 3 ? m : 3));
+        last_intensity[m] = this_val.intensity;
+    }
+
+    // if the classification has changed, compress it
+    if (changed_values & (1 << 3))
+    {
+        enc_.encodeSymbol(m_classification[last_.classification],
+            this_val.classification);
+    }
+
+    // if the scan angle rank has changed, compress it
+    if (changed_values & (1 << 2))
+    {
+        enc_.encodeSymbol(m_scan_angle_rank[this_val.scan_direction_flag],
+            uint8_t(this_val.scan_angle_rank - last_.scan_angle_rank));
+    }
+
+    // encode user data if changed
+    if (changed_values & (1 << 1))
+    {
+        enc_.encodeSymbol(m_user_data[last_.user_data], this_val.user_data);
+    }
+
+    // if the point source id was changed, compress it
+    if (changed_values & 1)
+    {
+        ic_point_source_ID.compress(enc_, last_.point_source_ID, this_val.point_source_ID, 0);
+    }
+
+    // compress x coordinate
+    median = last_x_diff_median5[m].get();
+    diff = this_val.x - last_.x;
+    ic_dx.compress(enc_, median, diff, n == 1);
+    last_x_diff_median5[m].add(diff);
+
+    // compress y coordinate
+    k_bits = ic_dx.getK();
+    median = last_y_diff_median5[m].get();
+    diff = this_val.y - last_.y;
+    ic_dy.compress(enc_, median, diff, (n==1) + ( k_bits < 20 ? utils::clearBit<0>(k_bits) : 20));
+    last_y_diff_median5[m].add(diff);
+
+    // compress z coordinate
+    k_bits = (ic_dx.getK() + ic_dy.getK()) / 2;
+    ic_z.compress(enc_, last_height[l], this_val.z,
+        (n==1) + (k_bits < 18 ? utils::clearBit<0>(k_bits) : 18));
+    last_height[l] = this_val.z;
+    last_ = this_val;
+    return buf + sizeof(las::point10);
+}
+
+// DECOMPRESSOR
+
+template <typename TStream>
+Point10Decompressor<TStream>::Point10Decompressor(decoders::arithmetic<TStream>& decoder) :
+    dec_(decoder), ic_intensity(16, 4), ic_point_source_ID(16), ic_dx(32, 2), ic_dy(32, 22),
+    ic_z(32, 20)
+{}
+
+template <typename TStream>
+void Point10Decompressor<TStream>::init()
+{
+    ic_intensity.init();
+    ic_point_source_ID.init();
+    ic_dx.init();
+    ic_dy.init();
+    ic_z.init();
+}
+
+template <typename TStream>
+void Point10Decompressor<TStream>::reset()
+{
+    Point10Base::reset();
+    ic_intensity.reset();
+    ic_point_source_ID.reset();
+    ic_dx.reset();
+    ic_dy.reset();
+    ic_z.reset();
+}
+
+template <typename TStream>
+char *Point10Decompressor<TStream>::decompress(char *buf)
+{
+    // don't have the first data yet, read the whole point out of the stream
+    if (!have_last_)
+        readFirst(buf);
+    else
+    {
+        decode();
+        last_.pack(buf);
+    }
+    return buf + sizeof(las::point10);
+}
+
+template <typename TStream>
+void Point10Decompressor<TStream>::decompress(const point_columns& cols, size_t idx)
+{
+    if (!have_last_)
+    {
+        char buf[sizeof(las::point10)];
+        readFirst(buf);
+        store(las::point10(buf), cols, idx);
+    }
+    else
+    {
+        decode();
+        store(last_, cols, idx);
+    }
+}
+
+inline void Point10Base::store(const las::point10& p, const point_columns& cols, size_t idx)
+{
+    if (cols.x)
+        cols.x.put(idx, p.x);
+    if (cols.y)
+        cols.y.put(idx, p.y);
+    if (cols.z)
+        cols.z.put(idx, p.z);
+    if (cols.intensity)
+        cols.intensity.put(idx, p.intensity);
+    if (cols.return_number)
+        cols.return_number.put(idx, p.return_number);
+    if (cols.number_of_returns)
+        cols.number_of_returns.put(idx, p.number_of_returns_of_given_pulse);
+    if (cols.scan_direction_flag)
+        cols.scan_direction_flag.put(idx, p.scan_direction_flag);
+    if (cols.edge_of_flight_line)
+        cols.edge_of_flight_line.put(idx, p.edge_of_flight_line);
+    if (cols.classification)
+        cols.classification.put(idx, p.classification);
+    if (cols.user_data)
+        cols.user_data.put(idx, p.user_data);
+    if (cols.scan_angle)
+        cols.scan_angle.put(idx, (int16_t)p.scan_angle_rank);
+    if (cols.point_source_id)
+        cols.point_source_id.put(idx, p.point_source_ID);
+}
+
+template <typename TStream>
+void Point10Decompressor<TStream>::readFirst(char *buf)
+{
+    init();
+    have_last_ = true;
+    dec_.getInStream().getBytes((unsigned char*)buf, sizeof(las::point10));
+    // decode this value
+    last_.unpack(buf);
+    last_.intensity = 0;
+}
+
+template <typename TStream>
+void Point10Decompressor<TStream>::decode()
+{
+    unsigned int r, n, m, l, k_bits;
+    int median, diff;
+
+    // decompress which other values have changed
+    int changed_values = dec_.decodeSymbol(m_changed_values);
+    if (changed_values)
+    {
+        // there was some change in one of the fields (other than x, y and z)
+
+        // decode bit fields if they have changed
+        if (changed_values & (1 << 5))
+        {
+            unsigned char b = last_.from_bitfields();
+            b = (unsigned char)dec_.decodeSymbol(m_bit_byte[b]);
+            last_.to_bitfields(b);
+        }
+
+        r = last_.return_number;
+        n = last_.number_of_returns_of_given_pulse;
+        m = number_return_map[n][r];
+        l = number_return_level[n][r];
+
+        // decompress the intensity if it has changed
+        if (changed_values & (1 << 4))
+        {
+            last_.intensity = static_cast<unsigned short>(
+                ic_intensity.decompress(dec_, last_intensity[m], (m < 3 ? m : 3)));
+            last_intensity[m] = last_.intensity;
+        }
+        else
+            last_.intensity = last_intensity[m];
+
+        // decompress the classification ... if it has changed
+        if (changed_values & (1 << 3)) {
+            last_.classification =
+                (unsigned char)dec_.decodeSymbol(m_classification[last_.classification]);
+        }
+
+        // decompress the scan angle rank if needed
+        if (changed_values & (1 << 2))
+        {
+            int val = dec_.decodeSymbol(m_scan_angle_rank[last_.scan_direction_flag]);
+            last_.scan_angle_rank = uint8_t(val + last_.scan_angle_rank);
+        }
+
+        // decompress the user data
+        if (changed_values & (1 << 1))
+        {
+            last_.user_data = (unsigned char)dec_.decodeSymbol(m_user_data[last_.user_data]);
+        }
+
+        // decompress the point source ID
+        if (changed_values & 1)
+        {
+            last_.point_source_ID = (unsigned short)ic_point_source_ID.decompress(dec_,
+                last_.point_source_ID, 0);
+        }
+    }
+    else
+    {
+        r = last_.return_number;
+        n = last_.number_of_returns_of_given_pulse;
+        m = number_return_map[n][r];
+        l = number_return_level[n][r];
+    }
+
+    // decompress x coordinate
+    median = last_x_diff_median5[m].get();
+    diff = ic_dx.decompress(dec_, median, n==1);
+    last_.x += diff;
+    last_x_diff_median5[m].add(diff);
+
+    // decompress y coordinate
+    median = last_y_diff_median5[m].get();
+    k_bits = ic_dx.getK();
+    diff = ic_dy.decompress(dec_, median, (n==1) + (k_bits < 20 ? utils::clearBit<0>(k_bits) : 20));
+    last_.y += diff;
+    last_y_diff_median5[m].add(diff);
+
+    // decompress z coordinate
+    k_bits = (ic_dx.getK() + ic_dy.getK()) / 2;
+    last_.z = ic_z.decompress(dec_, last_height[l],
+        (n==1) + (k_bits < 18 ? utils::clearBit<0>(k_bits) : 18));
+    last_height[l] = last_.z;
+}
+
 } // namespace detail
 } // namespace lazperf
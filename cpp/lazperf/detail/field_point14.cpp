@@ -78,17 +78,35 @@ namespace {
     const int GpstimeMultiCodeFull = 511;
 } // unnamed namespace
 
-Point14Base::Point14Base() : last_channel_(-1)
+Point14Base::Point14Base(bool compressor) : last_channel_(-1), compressor_(compressor)
+{}
+
+void Point14Base::reset()
 {
-    //ABELL - For debug.
-    chan_ctxs_[0].ctx_num_ = 0;
-    chan_ctxs_[1].ctx_num_ = 1;
-    chan_ctxs_[2].ctx_num_ = 2;
-    chan_ctxs_[3].ctx_num_ = 3;
+    for (std::unique_ptr<ChannelCtx>& c : chan_ctxs_)
+        if (c)
+            c->reset();
+    last_channel_ = -1;
 }
 
 // COMPRESSOR
 
+// Prepare to compress a new chunk once its data has been written.
+void Point14Compressor::reset()
+{
+    Point14Base::reset();
+
+    encoders::arithmetic<MemoryStream> *encs[] = { &xy_enc_, &z_enc_, &class_enc_,
+        &flags_enc_, &intensity_enc_, &scan_angle_enc_, &user_data_enc_,
+        &point_source_id_enc_, &gpstime_enc_ };
+    for (auto enc : encs)
+    {
+        // Only the XY and Z layers are always written.
+        enc->reset(enc == &xy_enc_ || enc == &z_enc_);
+        enc->getOutStream().clear();
+    }
+}
+
 void Point14Compressor::writeSizes()
 {
     xy_enc_.done();
@@ -167,7 +185,7 @@ const char *Point14Compressor::compress(const char *buf, int& scArg)
     // last stuff and move on
     if (last_channel_ == -1)
     {
-        ChannelCtx& c = chan_ctxs_[sc];
+        ChannelCtx& c = channelCtx(sc);
         stream_.putBytes((const unsigned char*)buf, sizeof(las::point14));
         c.last_ = point;
         c.have_last_ = true;
@@ -185,7 +203,7 @@ const char *Point14Compressor::compress(const char *buf, int& scArg)
     }
 
     // prev is the context for the previous point.
-    ChannelCtx& prev = chan_ctxs_[last_channel_];
+    ChannelCtx& prev = channelCtx(last_channel_);
 
     // There are 8 contexts for the change bits based on the return number,
     // number of returns and a GPS time change. Calculate that context number.
@@ -196,7 +214,7 @@ const char *Point14Compressor::compress(const char *buf, int& scArg)
         (prev.gps_time_change_ << 2);                                   // bit 2
 
     // c is the context for this point.
-    ChannelCtx& c = chan_ctxs_[sc];
+    ChannelCtx& c = channelCtx(sc);
     // old is the same as c unless we've switched channels and don't have a previous
     // for this channel, in which case we use the last channel's context.
     // In other words, we prefer the last point in the same channel as this point
@@ -549,6 +567,22 @@ void Point14Decompressor::dumpSums()
     std::cout << "GPS time : " << sumGpsTime.value() << "\n";
 }
 
+void Point14Decompressor::reset()
+{
+    Point14Base::reset();
+
+    xy_dec_.reset();
+    z_dec_.reset();
+    class_dec_.reset();
+    flags_dec_.reset();
+    intensity_dec_.reset();
+    scan_angle_dec_.reset();
+    user_data_dec_.reset();
+    point_source_id_dec_.reset();
+    gpstime_dec_.reset();
+    sizes_.clear();
+}
+
 void Point14Decompressor::readSizes()
 {
     uint32_t xy_cnt;
@@ -586,44 +620,142 @@ void Point14Decompressor::readData()
 {
     auto cnt = sizes_.begin();
 
-    // Copy data and read the init bytes.
+    // Set up the layers and read the init bytes.
     xy_dec_.initStream(stream_, *cnt++);
-    z_dec_.initStream(stream_, *cnt++);
-    class_dec_.initStream(stream_, *cnt++);
-    flags_dec_.initStream(stream_, *cnt++);
-    intensity_dec_.initStream(stream_, *cnt++);
-    scan_angle_dec_.initStream(stream_, *cnt++);
-    user_data_dec_.initStream(stream_, *cnt++);
-    point_source_id_dec_.initStream(stream_, *cnt++);
-    gpstime_dec_.initStream(stream_, *cnt++);
+    initLayer(z_dec_, *cnt++, layer::Z);
+    initLayer(class_dec_, *cnt++, layer::Classification);
+    initLayer(flags_dec_, *cnt++, layer::Flags);
+    initLayer(intensity_dec_, *cnt++, layer::Intensity);
+    initLayer(scan_angle_dec_, *cnt++, layer::ScanAngle);
+    initLayer(user_data_dec_, *cnt++, layer::UserData);
+    initLayer(point_source_id_dec_, *cnt++, layer::PointSourceId);
+    initLayer(gpstime_dec_, *cnt++, layer::GpsTime);
     sizes_.clear();
 }
 
-char *Point14Decompressor::decompress(char *buf, int& scArg)
+// Layers that weren't selected are skipped. Their decoders remain invalid, so nothing is
+// ever decoded from them.
+void Point14Decompressor::initLayer(decoders::arithmetic<LayerStream>& dec, uint32_t cnt,
+    uint32_t layer)
+{
+    if (layers_ & layer)
+        dec.initStream(stream_, cnt);
+    else
+        stream_.skip(cnt);
+}
+
+void Point14Decompressor::clearUnselected(las::point14& p)
+{
+    if (!(layers_ & layer::Z))
+        p.setZ(0);
+    if (!(layers_ & layer::Classification))
+        p.setClassification(0);
+    if (!(layers_ & layer::Flags))
+    {
+        p.setClassFlags(0);
+        p.setScanDirFlag(0);
+        p.setEofFlag(0);
+    }
+    if (!(layers_ & layer::Intensity))
+        p.setIntensity(0);
+    if (!(layers_ & layer::ScanAngle))
+        p.setScanAngle(0);
+    if (!(layers_ & layer::UserData))
+        p.setUserData(0);
+    if (!(layers_ & layer::PointSourceId))
+        p.setPointSourceID(0);
+    if (!(layers_ & layer::GpsTime))
+        p.setGpsTime(0);
+}
+
+char *Point14Decompressor::decompress(char *buf, int& sc)
 {
     // This is weird, but the first point, stored raw, is written *before* the point
     // count.
     // First point.
+    if (last_channel_ == -1)
+        readFirst(buf, sc);
+    else
+    {
+        las::point14 *point = reinterpret_cast<las::point14 *>(buf);
+        *point = decode(sc);
+    }
+    if (layers_ != layer::All)
+        clearUnselected(*reinterpret_cast<las::point14 *>(buf));
+    return buf + sizeof(las::point14);
+}
+
+void Point14Decompressor::decompress(const point_columns& cols, size_t idx, int& sc)
+{
+    las::point14 point;
     if (last_channel_ == -1)
     {
-        stream_.getBytes((unsigned char *)buf, sizeof(las::point14));
-        las::point14 point(buf);
+        char buf[sizeof(las::point14)];
+        readFirst(buf, sc);
+        point.unpack(buf);
+    }
+    else
+        point = decode(sc);
+    if (layers_ != layer::All)
+        clearUnselected(point);
+    store(point, cols, idx);
+}
 
-        scArg = point.scannerChannel();
-        ChannelCtx& c = chan_ctxs_[scArg];
-        c.last_ = point;
-        c.have_last_ = true;
-        c.last_gpstime_[0] = point.gpsTime();
-        last_channel_ = scArg;
+void Point14Decompressor::store(const las::point14& p, const point_columns& cols, size_t idx)
+{
+    if (cols.x)
+        cols.x.put(idx, p.x());
+    if (cols.y)
+        cols.y.put(idx, p.y());
+    if (cols.z)
+        cols.z.put(idx, p.z());
+    if (cols.intensity)
+        cols.intensity.put(idx, p.intensity());
+    if (cols.return_number)
+        cols.return_number.put(idx, (uint8_t)p.returnNum());
+    if (cols.number_of_returns)
+        cols.number_of_returns.put(idx, (uint8_t)p.numReturns());
+    if (cols.classification_flags)
+        cols.classification_flags.put(idx, (uint8_t)p.classFlags());
+    if (cols.scanner_channel)
+        cols.scanner_channel.put(idx, (uint8_t)p.scannerChannel());
+    if (cols.scan_direction_flag)
+        cols.scan_direction_flag.put(idx, (uint8_t)p.scanDirFlag());
+    if (cols.edge_of_flight_line)
+        cols.edge_of_flight_line.put(idx, (uint8_t)p.eofFlag());
+    if (cols.classification)
+        cols.classification.put(idx, p.classification());
+    if (cols.user_data)
+        cols.user_data.put(idx, p.userData());
+    if (cols.scan_angle)
+        cols.scan_angle.put(idx, p.scanAngle());
+    if (cols.point_source_id)
+        cols.point_source_id.put(idx, p.pointSourceID());
+    if (cols.gps_time)
+        cols.gps_time.put(idx, p.gpsTime());
+}
 
-        for (auto& z : c.last_z_)
-            z = point.z();
-        for (auto& last_intensity : c.last_intensity_)
-            last_intensity = point.intensity();
+void Point14Decompressor::readFirst(char *buf, int& scArg)
+{
+    stream_.getBytes((unsigned char *)buf, sizeof(las::point14));
+    las::point14 point(buf);
 
-        return buf + sizeof(las::point14);
-    }
-    ChannelCtx& prev = chan_ctxs_[last_channel_];
+    scArg = point.scannerChannel();
+    ChannelCtx& c = channelCtx(scArg);
+    c.last_ = point;
+    c.have_last_ = true;
+    c.last_gpstime_[0] = point.gpsTime();
+    last_channel_ = scArg;
+
+    for (auto& z : c.last_z_)
+        z = point.z();
+    for (auto& last_intensity : c.last_intensity_)
+        last_intensity = point.intensity();
+}
+
+const las::point14& Point14Decompressor::decode(int& scArg)
+{
+    ChannelCtx& prev = channelCtx(last_channel_);
 
     // There are 8 streams for the change bits based on the return number,
     // number of returns and a GPS time change. Calculate that stream number.
@@ -656,7 +788,7 @@ char *Point14Decompressor::decompress(char *buf, int& scArg)
         scArg = sc;
     }
 
-    ChannelCtx& c = chan_ctxs_[sc];
+    ChannelCtx& c = channelCtx(sc);
     if (!c.have_last_)
     {
         c.have_last_ = true;
@@ -761,7 +893,7 @@ char *Point14Decompressor::decompress(char *buf, int& scArg)
     LAZDEBUG(sumIntensity.add(c.last_.intensity()));
 
     // Scan angle
-    if (scan_angle_changed)
+    if (scan_angle_changed && scan_angle_dec_.valid())
     {
         c.last_.setScanAngle(c.scan_angle_decomp_.decompress(scan_angle_dec_,
             c.last_.scanAngle(), gps_time_changed));
@@ -777,20 +909,18 @@ char *Point14Decompressor::decompress(char *buf, int& scArg)
     LAZDEBUG(sumUserData.add(c.last_.userData()));
 
     // Point source ID
-    if (point_source_changed)
+    if (point_source_changed && point_source_id_dec_.valid())
     {
         c.last_.setPointSourceID(c.point_source_id_decomp_.decompress(
             point_source_id_dec_, c.last_.pointSourceID(), 0));
     }
     LAZDEBUG(sumPointSourceId.add(c.last_.pointSourceID()));
 
-    if (gps_time_changed)
+    if (gps_time_changed && gpstime_dec_.valid())
         decodeGpsTime(c);
     LAZDEBUG(sumGpsTime.add(c.last_.gpsTime()));
     c.gps_time_change_ = gps_time_changed;
-    las::point14 *point = reinterpret_cast<las::point14 *>(buf);
-    *point = c.last_;
-    return buf + sizeof(las::point14);
+    return c.last_;
 }
 
 void Point14Decompressor::decodeGpsTime(ChannelCtx& c)
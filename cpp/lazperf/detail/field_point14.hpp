@@ -36,19 +36,20 @@ namespace detail
 class Point14Base
 {
 protected:
-    Point14Base();
+    Point14Base(bool compressor);
 
     struct ChannelCtx
     {
         int ctx_num_;  //ABELL - For debug.
+        models::slab slab_;
         std::vector<models::arithmetic> changed_values_model_;
         models::arithmetic scanner_channel_model_;
         models::arithmetic rn_gps_same_model_;
         std::vector<models::arithmetic> nr_model_;
         std::vector<models::arithmetic> rn_model_;
-        std::vector<models::arithmetic> class_model_;
-        std::vector<models::arithmetic> flag_model_;
-        std::vector<models::arithmetic> user_data_model_;
+        models::lazy_arithmetic class_model_;
+        models::lazy_arithmetic flag_model_;
+        models::lazy_arithmetic user_data_model_;
 
         models::arithmetic gpstime_multi_model_;
         models::arithmetic gpstime_0diff_model_;
@@ -82,12 +83,15 @@ protected:
         std::array<int32_t, 4> multi_extreme_counter_;
         bool gps_time_change_;
 
-        ChannelCtx() : changed_values_model_(8, models::arithmetic(128)),
-            scanner_channel_model_(3), rn_gps_same_model_(13),
-            nr_model_(16, models::arithmetic(16)), rn_model_(16, models::arithmetic(16)),
-            class_model_(64, models::arithmetic(256)), flag_model_(64, models::arithmetic(64)),
-            user_data_model_(64, models::arithmetic(256)), gpstime_multi_model_(515),
-            gpstime_0diff_model_(5),
+        // Only the integer coders for the direction of coding are initialized.
+        ChannelCtx(int ctx_num, bool compressor) : ctx_num_(ctx_num), slab_(slabBytes()),
+            changed_values_model_(models::build(slab_, 8, 128)),
+            scanner_channel_model_(slab_, 3), rn_gps_same_model_(slab_, 13),
+            nr_model_(models::build(slab_, 16, 16)), rn_model_(models::build(slab_, 16, 16)),
+            class_model_(slab_, 64, 256), flag_model_(slab_, 64, 64),
+            user_data_model_(slab_, 64, 256),
+            gpstime_multi_model_(slab_, 515),
+            gpstime_0diff_model_(slab_, 5),
             dx_compr_(32, 2), dy_compr_(32, 22), z_compr_(32, 20), intensity_compr_(16, 4),
             scan_angle_compr_(16, 2), point_source_id_compr_(16), gpstime_compr_(32, 9),
             dx_decomp_(32, 2), dy_decomp_(32, 22), z_decomp_(32, 20), intensity_decomp_(16, 4),
@@ -98,42 +102,114 @@ protected:
         {
             //ABELL - Move the init into the ctor, I think.
             // Also, the encoder should be passed to the ctor.
-            dx_compr_.init();
-            dy_compr_.init();
-            z_compr_.init();
-            intensity_compr_.init();
-            scan_angle_compr_.init();
-            point_source_id_compr_.init();
-            gpstime_compr_.init();
-
-            dx_decomp_.init();
-            dy_decomp_.init();
-            z_decomp_.init();
-            intensity_decomp_.init();
-            scan_angle_decomp_.init();
-            point_source_id_decomp_.init();
-            gpstime_decomp_.init();
+            if (compressor)
+            {
+                dx_compr_.init();
+                dy_compr_.init();
+                z_compr_.init();
+                intensity_compr_.init();
+                scan_angle_compr_.init();
+                point_source_id_compr_.init();
+                gpstime_compr_.init();
+            }
+            else
+            {
+                dx_decomp_.init();
+                dy_decomp_.init();
+                z_decomp_.init();
+                intensity_decomp_.init();
+                scan_angle_decomp_.init();
+                point_source_id_decomp_.init();
+                gpstime_decomp_.init();
+            }
 
             for (auto& xd : last_x_diff_median5_)
                 xd.init();
             for (auto& yd : last_y_diff_median5_)
                 yd.init();
         }
+
+        // The size of the slab that holds the tables of all the models above.
+        static size_t slabBytes()
+        {
+            using models::arithmetic;
+
+            return 8 * arithmetic::bytes(128) + arithmetic::bytes(3) + arithmetic::bytes(13) +
+                32 * arithmetic::bytes(16) + 128 * arithmetic::bytes(256) +
+                64 * arithmetic::bytes(64) + arithmetic::bytes(515) + arithmetic::bytes(5);
+        }
+
+        // Restore the state at construction without reallocating the models.
+        void reset()
+        {
+            models::reset(changed_values_model_);
+            scanner_channel_model_.reset();
+            rn_gps_same_model_.reset();
+            models::reset(nr_model_);
+            models::reset(rn_model_);
+            class_model_.reset();
+            flag_model_.reset();
+            user_data_model_.reset();
+            gpstime_multi_model_.reset();
+            gpstime_0diff_model_.reset();
+
+            dx_compr_.reset();
+            dy_compr_.reset();
+            z_compr_.reset();
+            intensity_compr_.reset();
+            scan_angle_compr_.reset();
+            point_source_id_compr_.reset();
+            gpstime_compr_.reset();
+
+            dx_decomp_.reset();
+            dy_decomp_.reset();
+            z_decomp_.reset();
+            intensity_decomp_.reset();
+            scan_angle_decomp_.reset();
+            point_source_id_decomp_.reset();
+            gpstime_decomp_.reset();
+
+            have_last_ = false;
+            for (auto& xd : last_x_diff_median5_)
+                xd.init();
+            for (auto& yd : last_y_diff_median5_)
+                yd.init();
+            last_gps_seq_ = 0;
+            next_gps_seq_ = 0;
+            last_gpstime_.fill(0);
+            last_gpstime_diff_.fill(0);
+            multi_extreme_counter_.fill(0);
+            gps_time_change_ = false;
+        }
     };  // ChannelCtx
 
-    std::array<ChannelCtx, 4> chan_ctxs_;
+    void reset();
+
+    // Get the context of a scanner channel, building it on first use. Most data only
+    // uses channel 0.
+    ChannelCtx& channelCtx(int sc)
+    {
+        std::unique_ptr<ChannelCtx>& c = chan_ctxs_[sc];
+        if (!c)
+            c.reset(new ChannelCtx(sc, compressor_));
+        return *c;
+    }
+
+    std::array<std::unique_ptr<ChannelCtx>, 4> chan_ctxs_;
     int last_channel_;
+    bool compressor_;
 };
 
 class Point14Compressor : public Point14Base
 {
 public:
-    Point14Compressor(OutCbStream& stream) : stream_(stream)
+    Point14Compressor(OutCbStream& stream) : Point14Base(true), stream_(stream)
     {}
 
     void writeSizes();
     void writeData();
     const char *compress(const char *buf, int& sc);
+    void reset();
 
 private:
     void encodeGpsTime(const las::point14& point, ChannelCtx& c);
@@ -153,27 +229,37 @@ private:
 class Point14Decompressor : public Point14Base
 {
 public:
-    Point14Decompressor(InCbStream& stream) : stream_(stream)
+    Point14Decompressor(LayerSource& stream, uint32_t layers = layer::All) :
+        Point14Base(false), stream_(stream), layers_(layers)
     {}
 
     void dumpSums();
     void readSizes();
     void readData();
     char *decompress(char *buf, int& sc);
+    void decompress(const point_columns& cols, size_t idx, int& sc);
+    void reset();
+    // Write the fields of a point to the columns at index 'idx'.
+    static void store(const las::point14& p, const point_columns& cols, size_t idx);
 
 private:
+    void readFirst(char *buf, int& sc);
+    const las::point14& decode(int& sc);
     void decodeGpsTime(ChannelCtx& c);
+    void initLayer(decoders::arithmetic<LayerStream>& dec, uint32_t cnt, uint32_t layer);
+    void clearUnselected(las::point14& p);
 
-    InCbStream stream_;
-    decoders::arithmetic<MemoryStream> xy_dec_;
-    decoders::arithmetic<MemoryStream> z_dec_;
-    decoders::arithmetic<MemoryStream> class_dec_;
-    decoders::arithmetic<MemoryStream> flags_dec_;
-    decoders::arithmetic<MemoryStream> intensity_dec_;
-    decoders::arithmetic<MemoryStream> scan_angle_dec_;
-    decoders::arithmetic<MemoryStream> user_data_dec_;
-    decoders::arithmetic<MemoryStream> point_source_id_dec_;
-    decoders::arithmetic<MemoryStream> gpstime_dec_;
+    LayerSource stream_;
+    uint32_t layers_;
+    decoders::arithmetic<LayerStream> xy_dec_;
+    decoders::arithmetic<LayerStream> z_dec_;
+    decoders::arithmetic<LayerStream> class_dec_;
+    decoders::arithmetic<LayerStream> flags_dec_;
+    decoders::arithmetic<LayerStream> intensity_dec_;
+    decoders::arithmetic<LayerStream> scan_angle_dec_;
+    decoders::arithmetic<LayerStream> user_data_dec_;
+    decoders::arithmetic<LayerStream> point_source_id_dec_;
+    decoders::arithmetic<LayerStream> gpstime_dec_;
     std::vector<uint32_t> sizes_;
     utils::Summer sumChange;
     utils::Summer sumReturn;
@@ -30,12 +30,16 @@ namespace detail
 
 class Rgb10Base
 {
+public:
+    void reset();
+
 protected:
     Rgb10Base();
 
     bool have_last_;
     las::rgb last;
 
+    models::slab m_slab;
     models::arithmetic m_byte_used;
     models::arithmetic m_rgb_diff_0;
     models::arithmetic m_rgb_diff_1;
@@ -45,27 +49,290 @@ protected:
     models::arithmetic m_rgb_diff_5;
 };
 
+template <typename TStream>
 class Rgb10Compressor : public Rgb10Base
 {
 public:
-    Rgb10Compressor(encoders::arithmetic<OutCbStream>&);
+    Rgb10Compressor(encoders::arithmetic<TStream>&);
 
     const char *compress(const char *buf);
 
 private:
-    encoders::arithmetic<OutCbStream>& enc_;
+    encoders::arithmetic<TStream>& enc_;
 };
 
+template <typename TStream>
 class Rgb10Decompressor : public Rgb10Base
 {
 public:
-    Rgb10Decompressor(decoders::arithmetic<InCbStream>&);
+    Rgb10Decompressor(decoders::arithmetic<TStream>&);
 
     char *decompress(char *buf);
+    void decompress(const point_columns& cols, size_t idx);
 
 private:
-    decoders::arithmetic<InCbStream>& dec_;
+    void readFirst(char *buf);
+    void decode();
+
+    decoders::arithmetic<TStream>& dec_;
 };
 
+inline unsigned int color_diff_bits(const las::rgb& this_val, const las::rgb& last)
+{
+    const las::rgb& a = last;
+    const las::rgb& b = this_val;
+
+#define __flag_diff(x,y,f) ((((x) ^ (y)) & (f)) != 0)
+                unsigned int r =
+                    (__flag_diff(a.r, b.r, 0x00FF) << 0) |
+                    (__flag_diff(a.r, b.r, 0xFF00) << 1) |
+                    (__flag_diff(a.g, b.g, 0x00FF) << 2) |
+                    (__flag_diff(a.g, b.g, 0xFF00) << 3) |
+                    (__flag_diff(a.b, b.b, 0x00FF) << 4) |
+                    (__flag_diff(a.b, b.b, 0xFF00) << 5) |
+                    (__flag_diff(b.r, b.g, 0x00FF) ||
+                     __flag_diff(b.r, b.b, 0x00FF) ||
+                     __flag_diff(b.r, b.g, 0xFF00) ||
+                     __flag_diff(b.r, b.b, 0xFF00)) << 6;
+#undef __flag_diff
+
+    return r;
+}
+
+inline Rgb10Base::Rgb10Base() : have_last_(false), last(),
+    m_slab(models::arithmetic::bytes(128) + 6 * models::arithmetic::bytes(256)),
+    m_byte_used(m_slab, 128), m_rgb_diff_0(m_slab, 256), m_rgb_diff_1(m_slab, 256),
+    m_rgb_diff_2(m_slab, 256), m_rgb_diff_3(m_slab, 256), m_rgb_diff_4(m_slab, 256),
+    m_rgb_diff_5(m_slab, 256)
+{}
+
+// Restore the state at construction without reallocating the models.
+inline void Rgb10Base::reset()
+{
+    have_last_ = false;
+    last = las::rgb();
+    m_byte_used.reset();
+    m_rgb_diff_0.reset();
+    m_rgb_diff_1.assign(m_rgb_diff_0);
+    m_rgb_diff_2.assign(m_rgb_diff_0);
+    m_rgb_diff_3.assign(m_rgb_diff_0);
+    m_rgb_diff_4.assign(m_rgb_diff_0);
+    m_rgb_diff_5.assign(m_rgb_diff_0);
+}
+
+// COMPRESSOR
+
+template <typename TStream>
+Rgb10Compressor<TStream>::Rgb10Compressor(encoders::arithmetic<TStream>& encoder) : enc_(encoder)
+{}
+
+template <typename TStream>
+const char *Rgb10Compressor<TStream>::compress(const char *buf)
+{
+    las::rgb this_val(buf);
+
+    if (!have_last_) {
+        // don't have the first data yet, just push it to our
+        // have last stuff and move on
+        have_last_ = true;
+        last = this_val;
+
+        enc_.getOutStream().putBytes((const unsigned char*)buf, sizeof(las::rgb));
+        return buf + sizeof(las::rgb);
+    }
+
+    // compress color
+    int diff_l = 0;
+    int diff_h = 0;
+    int corr;
+
+    unsigned int sym = detail::color_diff_bits(this_val, last);
+
+    enc_.encodeSymbol(m_byte_used, sym);
+
+    // high and low R
+    if (sym & (1 << 0))
+    {
+        diff_l = (this_val.r & 0xFF) - (last.r & 0xFF);
+        enc_.encodeSymbol(m_rgb_diff_0, uint8_t(diff_l));
+    }
+    if (sym & (1 << 1))
+    {
+        diff_h = static_cast<int>(this_val.r >> 8) - (last.r >> 8);
+        enc_.encodeSymbol(m_rgb_diff_1, uint8_t(diff_h));
+    }
+
+    if (sym & (1 << 6))
+    {
+        if (sym & (1 << 2))
+        {
+            corr = static_cast<int>(this_val.g & 0xFF) -
+                utils::clamp<uint8_t>(diff_l + (last.g & 0xFF));
+            enc_.encodeSymbol(m_rgb_diff_2, uint8_t(corr));
+        }
+
+        if (sym & (1 << 4))
+        {
+            diff_l = (diff_l + (this_val.g & 0xFF) - (last.g & 0xFF)) / 2;
+            corr = static_cast<int>(this_val.b & 0xFF) -
+                utils::clamp<uint8_t>(diff_l + (last.b & 0xFF));
+            enc_.encodeSymbol(m_rgb_diff_4, uint8_t(corr));
+        }
+
+        if (sym & (1 << 3))
+        {
+            corr = static_cast<int>(this_val.g >> 8) -
+                utils::clamp<uint8_t>(diff_h + (last.g >> 8));
+            enc_.encodeSymbol(m_rgb_diff_3, uint8_t(corr));
+        }
+
+        if (sym & (1 << 5))
+        {
+            diff_h = (diff_h + ((this_val.g >> 8)) - (last.g >> 8)) / 2;
+            corr = static_cast<int>(this_val.b >> 8) -
+                utils::clamp<uint8_t>(diff_h + (last.b >> 8));
+            enc_.encodeSymbol(m_rgb_diff_5, uint8_t(corr));
+        }
+    }
+
+    last = this_val;
+    return buf + sizeof(las::rgb);
+}
+
+// DECOMPRESSOR
+
+template <typename TStream>
+Rgb10Decompressor<TStream>::Rgb10Decompressor(decoders::arithmetic<TStream>& decoder) :
+    dec_(decoder)
+{}
+
+template <typename TStream>
+char *Rgb10Decompressor<TStream>::decompress(char *buf)
+{
+    // don't have the first data yet, read the whole point out of the stream
+    if (!have_last_)
+        readFirst(buf);
+    else
+    {
+        decode();
+        last.pack(buf);
+    }
+    return buf + sizeof(las::rgb);
+}
+
+template <typename TStream>
+void Rgb10Decompressor<TStream>::decompress(const point_columns& cols, size_t idx)
+{
+    if (!have_last_)
+    {
+        char buf[sizeof(las::rgb)];
+        readFirst(buf);
+    }
+    else
+        decode();
+    if (cols.red)
+        cols.red.put(idx, last.r);
+    if (cols.green)
+        cols.green.put(idx, last.g);
+    if (cols.blue)
+        cols.blue.put(idx, last.b);
+}
+
+template <typename TStream>
+void Rgb10Decompressor<TStream>::readFirst(char *buf)
+{
+    have_last_ = true;
+    dec_.getInStream().getBytes((unsigned char*)buf, sizeof(las::rgb));
+    last.unpack(buf);
+}
+
+template <typename TStream>
+void Rgb10Decompressor<TStream>::decode()
+{
+    unsigned char corr;
+    int diff = 0;
+    unsigned int sym = dec_.decodeSymbol(m_byte_used);
+
+    las::rgb this_val;
+
+    if (sym & (1 << 0))
+    {
+        corr = static_cast<unsigned char>(dec_.decodeSymbol(m_rgb_diff_0));
+        this_val.r = static_cast<unsigned short>(uint8_t(corr + (last.r & 0xFF)));
+    }
+    else
+    {
+        this_val.r = last.r & 0xFF;
+    }
+
+    if (sym & (1 << 1))
+    {
+        corr = static_cast<unsigned char>(dec_.decodeSymbol(m_rgb_diff_1));
+        this_val.r |= (static_cast<unsigned short>(uint8_t(corr + (last.r >> 8))) << 8);
+    }
+    else
+    {
+        this_val.r |= last.r & 0xFF00;
+    }
+
+    if (sym & (1 << 6))
+    {
+        diff = (this_val.r & 0xFF) - (last.r & 0xFF);
+
+        if (sym & (1 << 2))
+        {
+            corr = static_cast<unsigned char>(dec_.decodeSymbol(m_rgb_diff_2));
+            this_val.g = static_cast<unsigned short>(uint8_t(corr +
+                utils::clamp<uint8_t>(diff + (last.g & 0xFF))));
+        }
+        else
+        {
+            this_val.g = last.g & 0xFF;
+        }
+
+        if (sym & (1 << 4))
+        {
+            corr = static_cast<unsigned char>(dec_.decodeSymbol(m_rgb_diff_4));
+            diff = (diff + (this_val.g & 0xFF) - (last.g & 0xFF)) / 2;
+            this_val.b = static_cast<unsigned short>(uint8_t(corr +
+                utils::clamp<uint8_t>(diff + (last.b & 0xFF))));
+        }
+        else
+        {
+            this_val.b = last.b & 0xFF;
+        }
+
+        diff = (this_val.r >> 8) - (last.r >> 8);
+        if (sym & (1 << 3))
+        {
+            corr = static_cast<unsigned char>(dec_.decodeSymbol(m_rgb_diff_3));
+            this_val.g |= static_cast<unsigned short>(uint8_t(corr +
+                utils::clamp<uint8_t>(diff + (last.g >> 8)))) << 8;
+        }
+        else {
+            this_val.g |= last.g & 0xFF00;
+        }
+
+        if (sym & (1 << 5))
+        {
+            corr = static_cast<unsigned char>(dec_.decodeSymbol(m_rgb_diff_5));
+            diff = (diff + (this_val.g >> 8) - (last.g >> 8)) / 2;
+
+            this_val.b |= static_cast<unsigned short>(uint8_t(corr +
+                utils::clamp<uint8_t>(diff + (last.b >> 8)))) << 8;
+        }
+        else {
+            this_val.b |= (last.b & 0xFF00);
+        }
+    }
+    else
+    {
+        this_val.g = this_val.r;
+        this_val.b = this_val.r;
+    }
+
+    last = this_val;
+}
+
 } // namespace detail
 } // namespace lazperf
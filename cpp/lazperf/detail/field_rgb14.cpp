@@ -64,6 +64,23 @@ unsigned int color_diff_bits_1_4(const las::rgb14& color, const las::rgb14& last
 
 } // unnamed namespace
 
+void Rgb14Base::reset()
+{
+    for (std::unique_ptr<ChannelCtx>& c : chan_ctxs_)
+        if (c)
+            c->reset();
+    last_channel_ = -1;
+}
+
+// COMPRESSOR
+
+// Prepare to compress a new chunk once its data has been written.
+void Rgb14Compressor::reset()
+{
+    Rgb14Base::reset();
+    rgb_enc_.reset(false);
+    rgb_enc_.getOutStream().clear();
+}
 
 void Rgb14Compressor::writeSizes()
 {
@@ -88,7 +105,7 @@ const char *Rgb14Compressor::compress(const char *buf, int& sc)
     // have last stuff and move on
     if (last_channel_ == -1)
     {
-        ChannelCtx& c = chan_ctxs_[sc];
+        ChannelCtx& c = channelCtx(sc);
         stream_.putBytes((const unsigned char*)&color, sizeof(las::rgb));
         c.last_ = color;
         c.have_last_ = true;
@@ -96,8 +113,8 @@ const char *Rgb14Compressor::compress(const char *buf, int& sc)
         return buf + sizeof(las::rgb);
     }
 
-    ChannelCtx& c = chan_ctxs_[sc];
-    las::rgb14 *pLastColor = &chan_ctxs_[last_channel_].last_;
+    ChannelCtx& c = channelCtx(sc);
+    las::rgb14 *pLastColor = &channelCtx(last_channel_).last_;
     if (!c.have_last_)
     {
         c.have_last_ = true;
@@ -175,6 +192,12 @@ void Rgb14Decompressor::dumpSums()
     std::cout << "RGB      : " << sumRgb.value() << "\n";
 }
 
+void Rgb14Decompressor::reset()
+{
+    Rgb14Base::reset();
+    rgb_dec_.reset();
+}
+
 void Rgb14Decompressor::readSizes()
 {
     stream_ >> rgb_cnt_;
@@ -182,29 +205,48 @@ void Rgb14Decompressor::readSizes()
 
 void Rgb14Decompressor::readData()
 {
-    rgb_dec_.initStream(stream_, rgb_cnt_);
+    if (selected_)
+        rgb_dec_.initStream(stream_, rgb_cnt_);
+    else
+        stream_.skip(rgb_cnt_);
 }
 
 char *Rgb14Decompressor::decompress(char *buf, int& sc)
+{
+    decode(sc).pack(buf);
+    return buf + sizeof(las::rgb14);
+}
+
+void Rgb14Decompressor::decompress(const point_columns& cols, size_t idx, int& sc)
+{
+    las::rgb14 color = decode(sc);
+    if (cols.red)
+        cols.red.put(idx, color.r);
+    if (cols.green)
+        cols.green.put(idx, color.g);
+    if (cols.blue)
+        cols.blue.put(idx, color.b);
+}
+
+las::rgb14 Rgb14Decompressor::decode(int& sc)
 {
     if (last_channel_ == -1)
     {
-        ChannelCtx& c = chan_ctxs_[sc];
+        ChannelCtx& c = channelCtx(sc);
+        char buf[sizeof(las::rgb14)];
         stream_.getBytes((unsigned char*)buf, sizeof(las::rgb));
         c.last_.unpack(buf);
         c.have_last_ = true;
         last_channel_ = sc;
-        return buf + sizeof(las::rgb14);
+        return selected_ ? c.last_ : las::rgb14();
     }
+    if (!selected_)
+        return las::rgb14();
     if (rgb_cnt_ == 0)
-    {
-        las::rgb14 *color = reinterpret_cast<las::rgb14 *>(buf);
-        *color = chan_ctxs_[last_channel_].last_;
-        return buf + sizeof(las::rgb14);
-    }
+        return channelCtx(last_channel_).last_;
 
-    ChannelCtx& c = chan_ctxs_[sc];
-    las::rgb14 *pLastColor = &chan_ctxs_[last_channel_].last_;
+    ChannelCtx& c = channelCtx(sc);
+    las::rgb14 *pLastColor = &channelCtx(last_channel_).last_;
     if (sc != last_channel_)
     {
         last_channel_ = sc;
@@ -212,7 +254,7 @@ char *Rgb14Decompressor::decompress(char *buf, int& sc)
         {
             c.have_last_ = true;
             c.last_ = *pLastColor;
-            pLastColor = &chan_ctxs_[last_channel_].last_;
+            pLastColor = &channelCtx(last_channel_).last_;
         }
     }
     las::rgb14& lastColor = *pLastColor;
@@ -288,8 +330,7 @@ char *Rgb14Decompressor::decompress(char *buf, int& sc)
 
     LAZDEBUG(sumRgb.add(color));
     lastColor = color;
-    color.pack(buf);
-    return buf + sizeof(las::rgb14);
+    return color;
 }
 
 } // namespace detail
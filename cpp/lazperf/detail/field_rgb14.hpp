@@ -40,17 +40,39 @@ protected:
     {
         int have_last_;
         las::rgb14 last_;
+        models::slab slab_;
         models::arithmetic used_model_;
         std::array<models::arithmetic, 6> diff_model_;
 
-        ChannelCtx() : have_last_{false}, used_model_(128),
-            diff_model_{ models::arithmetic(256), models::arithmetic(256),
-                models::arithmetic(256), models::arithmetic(256),
-                models::arithmetic(256), models::arithmetic(256) }
+        ChannelCtx() : have_last_{false},
+            slab_(models::arithmetic::bytes(128) + 6 * models::arithmetic::bytes(256)),
+            used_model_(slab_, 128),
+            diff_model_{ models::arithmetic(slab_, 256), models::arithmetic(slab_, 256),
+                models::arithmetic(slab_, 256), models::arithmetic(slab_, 256),
+                models::arithmetic(slab_, 256), models::arithmetic(slab_, 256) }
         {}
+
+        void reset()
+        {
+            have_last_ = false;
+            last_ = las::rgb14();
+            used_model_.reset();
+            models::reset(diff_model_);
+        }
     };
 
-    std::array<ChannelCtx, 4> chan_ctxs_;
+    void reset();
+
+    // Get the context of a scanner channel, building it on first use.
+    ChannelCtx& channelCtx(int sc)
+    {
+        std::unique_ptr<ChannelCtx>& c = chan_ctxs_[sc];
+        if (!c)
+            c.reset(new ChannelCtx());
+        return *c;
+    }
+
+    std::array<std::unique_ptr<ChannelCtx>, 4> chan_ctxs_;
     int last_channel_ = -1;
 };
 
@@ -63,6 +85,7 @@ public:
     void writeSizes();
     void writeData();
     const char *compress(const char *buf, int& sc);
+    void reset();
 
 private:
     OutCbStream& stream_;
@@ -72,18 +95,24 @@ private:
 class Rgb14Decompressor : public Rgb14Base
 {
 public:
-    Rgb14Decompressor(InCbStream& stream) : stream_(stream)
+    Rgb14Decompressor(LayerSource& stream, bool selected = true) : stream_(stream),
+        selected_(selected)
     {}
 
     void dumpSums();
     void readSizes();
     void readData();
     char *decompress(char *buf, int& sc);
+    void decompress(const point_columns& cols, size_t idx, int& sc);
+    void reset();
 
 private:
-    InCbStream& stream_;
+    las::rgb14 decode(int& sc);
+
+    LayerSource& stream_;
+    bool selected_;
     uint32_t rgb_cnt_;
-    decoders::arithmetic<MemoryStream> rgb_dec_;
+    decoders::arithmetic<LayerStream> rgb_dec_;
     utils::Summer sumRgb;
 };
 
@@ -131,6 +131,17 @@ public:
     void makeValid()
     { valid = true; }
 
+    // Prepare to encode a new sequence once done() has been called. Output goes to the
+    // same stream.
+    void reset(bool v = true)
+    {
+        valid = v;
+        base   = 0;
+        length = AC__MaxLength;
+        outbyte = outbuffer;
+        endbyte = endbuffer;
+    }
+
     void done()
     {
         uint32_t init_base = base;                 // done encoding: set final data bytes
@@ -27,6 +27,11 @@
 */
 
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "filestream.hpp"
 #include "excepts.hpp"
@@ -56,20 +61,36 @@ OutputCb OutFileStream::cb()
 struct InFileStream::Private
 {
     // Setting the offset_ to the buffer size will force a fill on the first read.
-    Private(std::istream& in) : f_(in)
+    Private(std::istream& in) : f_(in), buf_size_(1 << 20), depth_(0), pos_(-1),
+        stop_(false), eof_(false)
     { reset(); }
 
+    ~Private()
+    { stop(); }
+
     void getBytes(unsigned char *buf, size_t request);
     size_t fillit();
-    void reset()
-    {
-        buf_.resize(1 << 20);
-        offset_ = buf_.size();
-    }
+    void reset();
+    void stop();
+    void readAhead();
 
     std::istream& f_;
     std::vector<unsigned char> buf_;
     size_t offset_;
+    size_t buf_size_;
+    size_t depth_;
+
+    // Read-ahead state. Buffers that have been read ahead are queued in 'full_'. 'pos_' is
+    // the stream position following the last buffer read, or -1 if the stream hasn't been
+    // read since it was last positioned.
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::vector<unsigned char>> full_;
+    std::vector<std::vector<unsigned char>> free_;
+    int64_t pos_;
+    bool stop_;
+    bool eof_;
 };
 
 InFileStream::InFileStream(std::istream& in) : p_(new Private(in))
@@ -84,6 +105,19 @@ void InFileStream::reset()
     p_->reset();
 }
 
+void InFileStream::stop()
+{
+    p_->stop();
+}
+
+void InFileStream::setReadAhead(size_t bufferSize, size_t depth)
+{
+    p_->stop();
+    p_->buf_size_ = bufferSize ? bufferSize : (1 << 20);
+    p_->depth_ = depth;
+    p_->free_.clear();
+}
+
 InputCb InFileStream::cb()
 {
     using namespace std::placeholders;
@@ -91,6 +125,31 @@ InputCb InFileStream::cb()
     return std::bind(&InFileStream::Private::getBytes, p_.get(), _1, _2);
 }
 
+void InFileStream::Private::reset()
+{
+    stop();
+    for (auto& b : full_)
+        free_.push_back(std::move(b));
+    full_.clear();
+    pos_ = -1;
+    eof_ = false;
+    buf_.resize(buf_size_);
+    offset_ = buf_.size();
+}
+
+void InFileStream::Private::stop()
+{
+    if (!thread_.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+    stop_ = false;
+}
+
 void InFileStream::Private::getBytes(unsigned char *buf, size_t request)
 {
     // Almost all requests are size 1.
@@ -131,6 +190,35 @@ void InFileStream::Private::getBytes(unsigned char *buf, size_t request)
 size_t InFileStream::Private::fillit()
 {
     offset_ = 0;
+    if (depth_ && !eof_ && !thread_.joinable())
+    {
+        if (pos_ < 0)
+            pos_ = (int64_t)f_.tellg();
+        thread_ = std::thread(&InFileStream::Private::readAhead, this);
+    }
+
+    if (depth_ || full_.size())
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this](){ return full_.size() || eof_ || !thread_.joinable(); });
+        if (full_.size())
+        {
+            free_.push_back(std::move(buf_));
+            buf_ = std::move(full_.front());
+            full_.pop_front();
+            lock.unlock();
+            cv_.notify_all();
+            return buf_.size();
+        }
+    }
+
+    // The stream may have been moved since the last buffer was read ahead.
+    if (pos_ >= 0)
+    {
+        f_.seekg(pos_);
+        pos_ = -1;
+    }
+    buf_.resize(buf_size_);
     f_.read(reinterpret_cast<char *>(buf_.data()), buf_.size());
     size_t filled = f_.gcount();
 
@@ -140,4 +228,46 @@ size_t InFileStream::Private::fillit()
     return filled;
 }
 
+// Runs on the read-ahead thread. The stream is repositioned before each read so that
+// it can be used by others while the thread is stopped.
+void InFileStream::Private::readAhead()
+{
+    std::vector<unsigned char> buf;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this](){ return stop_ || full_.size() < depth_; });
+            if (stop_)
+                return;
+            if (free_.size())
+            {
+                buf = std::move(free_.back());
+                free_.pop_back();
+            }
+        }
+
+        buf.resize(buf_size_);
+        if (pos_ >= 0)
+            f_.seekg(pos_);
+        f_.read(reinterpret_cast<char *>(buf.data()), buf.size());
+        size_t filled = (size_t)f_.gcount();
+        buf.resize(filled);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (filled == 0)
+            eof_ = true;
+        else
+        {
+            if (pos_ >= 0)
+                pos_ += filled;
+            full_.push_back(std::move(buf));
+            buf.clear();
+        }
+        cv_.notify_all();
+        if (eof_)
+            return;
+    }
+}
+
 } // namespace lazperf
@@ -59,8 +59,15 @@ public:
     LAZPERF_EXPORT InFileStream(std::istream& in);
     LAZPERF_EXPORT ~InFileStream();
 
-    // This will force a fill on the next fetch.
+    // This will force a fill on the next fetch. Any read-ahead is stopped, so the stream
+    // can be repositioned after calling this.
     LAZPERF_EXPORT void reset();
+    // Stop any read-ahead so that the stream can be used by others. Reading resumes where
+    // it left off on the next fetch.
+    LAZPERF_EXPORT void stop();
+    // Read up to 'depth' buffers of 'bufferSize' bytes ahead of the caller on a background
+    // thread. A depth of zero (the default) reads on the calling thread.
+    LAZPERF_EXPORT void setReadAhead(size_t bufferSize, size_t depth);
     LAZPERF_EXPORT InputCb cb();
 
 private:
@@ -25,6 +25,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 #include <fstream>
 #include <limits>
@@ -42,6 +43,33 @@ class LeExtractor;
 const uint32_t DefaultChunkSize = 50000;
 const uint32_t VariableChunkSize = (std::numeric_limits<uint32_t>::max)();
 
+// Layers of point formats 6, 7 and 8 that can be selected for decompression. The values
+// match those used by LASzip. X, Y, the return numbers and the scanner channel are always
+// decompressed. Fields in layers that aren't selected are set to zero.
+namespace layer
+{
+const uint32_t Z = 0x1;
+const uint32_t Classification = 0x2;
+const uint32_t Flags = 0x4;
+const uint32_t Intensity = 0x8;
+const uint32_t ScanAngle = 0x10;
+const uint32_t UserData = 0x20;
+const uint32_t PointSourceId = 0x40;
+const uint32_t GpsTime = 0x80;
+const uint32_t Rgb = 0x100;
+const uint32_t Nir = 0x200;
+// Extra byte N is selected with (Byte0 << N). Extra bytes past the 16th are selected
+// along with the 16th.
+const uint32_t Byte0 = 0x10000;
+const uint32_t ExtraBytes = 0xFFFF0000;
+const uint32_t All = 0xFFFFFFFF;
+
+inline bool byteSelected(uint32_t layers, size_t byte)
+{
+    return layers & (Byte0 << (byte < 15 ? byte : 15));
+}
+} // namespace layer
+
 LAZPERF_EXPORT int baseCount(int format);
 
 struct LAZPERF_EXPORT vector3
@@ -52,11 +80,57 @@ struct LAZPERF_EXPORT vector3
     vector3(double x, double y, double z) : x(x), y(y), z(z)
     {}
 
+    bool operator==(const vector3& other) const
+    { return x == other.x && y == other.y && z == other.z; }
+    bool operator!=(const vector3& other) const
+    { return !(*this == other); }
+
     double x;
     double y;
     double z;
 };
 
+// An axis-aligned box. Bounds are inclusive. A default box is empty and contains nothing.
+struct box
+{
+    box() : min((std::numeric_limits<double>::max)(), (std::numeric_limits<double>::max)(),
+            (std::numeric_limits<double>::max)()),
+        max((std::numeric_limits<double>::lowest)(), (std::numeric_limits<double>::lowest)(),
+            (std::numeric_limits<double>::lowest)())
+    {}
+
+    box(const vector3& min, const vector3& max) : min(min), max(max)
+    {}
+
+    bool empty() const
+    { return min.x > max.x || min.y > max.y || min.z > max.z; }
+
+    bool contains(double x, double y, double z) const
+    {
+        return x >= min.x && x <= max.x && y >= min.y && y <= max.y &&
+            z >= min.z && z <= max.z;
+    }
+
+    bool intersects(const box& b) const
+    {
+        return !empty() && !b.empty() && b.min.x <= max.x && b.max.x >= min.x &&
+            b.min.y <= max.y && b.max.y >= min.y && b.min.z <= max.z && b.max.z >= min.z;
+    }
+
+    void grow(double x, double y, double z)
+    {
+        min.x = (std::min)(min.x, x);
+        min.y = (std::min)(min.y, y);
+        min.z = (std::min)(min.z, z);
+        max.x = (std::max)(max.x, x);
+        max.y = (std::max)(max.y, y);
+        max.z = (std::max)(max.z, z);
+    }
+
+    vector3 min;
+    vector3 max;
+};
+
 // We currently export the whole struct because we have virtual functions and the vtable
 // doesn't get exported unless you export the struct/class. :(
 struct LAZPERF_EXPORT base_header
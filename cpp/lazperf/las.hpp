@@ -337,6 +337,21 @@ struct point14
         setPointSourceID(utils::unpack<uint16_t>(in));  in += sizeof(uint16_t);
         setGpsTime(utils::unpack<double>(in));
     }
+
+    void pack(char *out) const
+    {
+        utils::pack(x(), out);                          out += sizeof(int32_t);
+        utils::pack(y(), out);                          out += sizeof(int32_t);
+        utils::pack(z(), out);                          out += sizeof(int32_t);
+        utils::pack(intensity(), out);                  out += sizeof(uint16_t);
+        *out++ = (char)returns();
+        *out++ = (char)flags();
+        *out++ = (char)classification();
+        *out++ = (char)userData();
+        utils::pack(scanAngle(), out);                  out += sizeof(int16_t);
+        utils::pack(pointSourceID(), out);              out += sizeof(uint16_t);
+        utils::pack(gpsTime(), out);
+    }
 };
 #pragma pack(pop)
 } // namespace las
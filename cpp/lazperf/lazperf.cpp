@@ -36,6 +36,7 @@
 
 #include "las.hpp"
 #include "lazperf.hpp"
+#include "point_codec.hpp"
 #include "portable_endian.hpp"
 
 namespace lazperf
@@ -46,6 +47,18 @@ namespace lazperf
 las_compressor::~las_compressor()
 {}
 
+const char *las_compressor::compressPoints(const char *in, size_t count)
+{
+    while (count--)
+        in = compress(in);
+    return in;
+}
+
+void las_compressor::reset()
+{
+    throw error("This compressor can't be reset.");
+}
+
 // 1.2 COMPRESSOR BASE
 
 struct point_compressor_base_1_2::Private
@@ -56,10 +69,10 @@ struct point_compressor_base_1_2::Private
 
     OutCbStream stream_;
     encoders::arithmetic<OutCbStream> encoder_;
-    detail::Point10Compressor point_;
-    detail::Gpstime10Compressor gpstime_;
-    detail::Rgb10Compressor rgb_;
-    detail::Byte10Compressor byte_;
+    detail::Point10Compressor<OutCbStream> point_;
+    detail::Gpstime10Compressor<OutCbStream> gpstime_;
+    detail::Rgb10Compressor<OutCbStream> rgb_;
+    detail::Byte10Compressor<OutCbStream> byte_;
 };
 
 point_compressor_base_1_2::point_compressor_base_1_2(OutputCb cb, size_t ebCount) :
@@ -74,6 +87,15 @@ void point_compressor_base_1_2::done()
     p_->encoder_.done();
 }
 
+void point_compressor_base_1_2::reset()
+{
+    p_->encoder_.reset();
+    p_->point_.reset();
+    p_->gpstime_.reset();
+    p_->rgb_.reset();
+    p_->byte_.reset();
+}
+
 // COMPRESSOR 0
 
 point_compressor_0::~point_compressor_0()
@@ -90,6 +112,13 @@ const char *point_compressor_0::compress(const char *in)
     return in;
 }
 
+const char *point_compressor_0::compressPoints(const char *in, size_t count)
+{
+    while (count--)
+        in = point_compressor_0::compress(in);
+    return in;
+}
+
 // COMPRESSOR 1
 
 point_compressor_1::~point_compressor_1()
@@ -107,6 +136,13 @@ const char *point_compressor_1::compress(const char *in)
     return in;
 }
 
+const char *point_compressor_1::compressPoints(const char *in, size_t count)
+{
+    while (count--)
+        in = point_compressor_1::compress(in);
+    return in;
+}
+
 // COMPRESSOR 2
 
 point_compressor_2::~point_compressor_2()
@@ -124,6 +160,13 @@ const char *point_compressor_2::compress(const char *in)
     return in;
 }
 
+const char *point_compressor_2::compressPoints(const char *in, size_t count)
+{
+    while (count--)
+        in = point_compressor_2::compress(in);
+    return in;
+}
+
 // COMPRESSOR 3
 
 point_compressor_3::~point_compressor_3()
@@ -142,6 +185,13 @@ const char *point_compressor_3::compress(const char *in)
     return in;
 }
 
+const char *point_compressor_3::compressPoints(const char *in, size_t count)
+{
+    while (count--)
+        in = point_compressor_3::compress(in);
+    return in;
+}
+
 // 1.4 COMPRESSOR BASE
 
 struct point_compressor_base_1_4::Private
@@ -162,6 +212,15 @@ point_compressor_base_1_4::point_compressor_base_1_4(OutputCb cb, size_t ebCount
     p_(new Private(cb, ebCount))
 {}
 
+void point_compressor_base_1_4::reset()
+{
+    p_->chunk_count_ = 0;
+    p_->point_.reset();
+    p_->rgb_.reset();
+    p_->nir_.reset();
+    p_->byte_.reset();
+}
+
 // COMPRESOR 6
 
 point_compressor_6::~point_compressor_6()
@@ -181,6 +240,13 @@ const char *point_compressor_6::compress(const char *in)
     return in;
 }
 
+const char *point_compressor_6::compressPoints(const char *in, size_t count)
+{
+    while (count--)
+        in = point_compressor_6::compress(in);
+    return in;
+}
+
 void point_compressor_6::done()
 {
     p_->stream_ << p_->chunk_count_;
@@ -214,6 +280,13 @@ const char *point_compressor_7::compress(const char *in)
     return in;
 }
 
+const char *point_compressor_7::compressPoints(const char *in, size_t count)
+{
+    while (count--)
+        in = point_compressor_7::compress(in);
+    return in;
+}
+
 void point_compressor_7::done()
 {
     p_->stream_ << p_->chunk_count_;
@@ -250,6 +323,13 @@ const char *point_compressor_8::compress(const char *in)
     return in;
 }
 
+const char *point_compressor_8::compressPoints(const char *in, size_t count)
+{
+    while (count--)
+        in = point_compressor_8::compress(in);
+    return in;
+}
+
 void point_compressor_8::done()
 {
     p_->stream_ << p_->chunk_count_;
@@ -272,6 +352,23 @@ void point_compressor_8::done()
 las_decompressor::~las_decompressor()
 {}
 
+char *las_decompressor::decompressPoints(char *out, size_t count)
+{
+    while (count--)
+        out = decompress(out);
+    return out;
+}
+
+void las_decompressor::decompressColumns(const point_columns&, size_t)
+{
+    throw error("Columnar decompression isn't supported by this decompressor.");
+}
+
+void las_decompressor::reset()
+{
+    throw error("This decompressor can't be reset.");
+}
+
 // 1.2 DECOMPRESSOR BASE
 
 struct point_decompressor_base_1_2::Private
@@ -282,10 +379,10 @@ struct point_decompressor_base_1_2::Private
 
     InCbStream stream_;
     decoders::arithmetic<InCbStream> decoder_;
-    detail::Point10Decompressor point_;
-    detail::Gpstime10Decompressor gpstime_;
-    detail::Rgb10Decompressor rgb_;
-    detail::Byte10Decompressor byte_;
+    detail::Point10Decompressor<InCbStream> point_;
+    detail::Gpstime10Decompressor<InCbStream> gpstime_;
+    detail::Rgb10Decompressor<InCbStream> rgb_;
+    detail::Byte10Decompressor<InCbStream> byte_;
     bool first_;
 };
 
@@ -296,6 +393,16 @@ point_decompressor_base_1_2::point_decompressor_base_1_2(InputCb cb, size_t ebCo
 point_decompressor_base_1_2::~point_decompressor_base_1_2()
 {}
 
+void point_decompressor_base_1_2::reset()
+{
+    p_->decoder_.reset();
+    p_->point_.reset();
+    p_->gpstime_.reset();
+    p_->rgb_.reset();
+    p_->byte_.reset();
+    p_->first_ = true;
+}
+
 void point_decompressor_base_1_2::handleFirst()
 {
     if (p_->first_)
@@ -322,6 +429,23 @@ char *point_decompressor_0::decompress(char *in)
     return in;
 }
 
+char *point_decompressor_0::decompressPoints(char *out, size_t count)
+{
+    while (count--)
+        out = point_decompressor_0::decompress(out);
+    return out;
+}
+
+void point_decompressor_0::decompressColumns(const point_columns& cols, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        p_->point_.decompress(cols, i);
+        p_->byte_.decompress(cols, i);
+        handleFirst();
+    }
+}
+
 // DECOMPRESSOR 1
 
 point_decompressor_1::~point_decompressor_1()
@@ -340,6 +464,24 @@ char *point_decompressor_1::decompress(char *in)
     return in;
 }
 
+char *point_decompressor_1::decompressPoints(char *out, size_t count)
+{
+    while (count--)
+        out = point_decompressor_1::decompress(out);
+    return out;
+}
+
+void point_decompressor_1::decompressColumns(const point_columns& cols, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        p_->point_.decompress(cols, i);
+        p_->gpstime_.decompress(cols, i);
+        p_->byte_.decompress(cols, i);
+        handleFirst();
+    }
+}
+
 // DECOMPRESSOR 2
 
 point_decompressor_2::~point_decompressor_2()
@@ -358,6 +500,24 @@ char *point_decompressor_2::decompress(char *in)
     return in;
 }
 
+char *point_decompressor_2::decompressPoints(char *out, size_t count)
+{
+    while (count--)
+        out = point_decompressor_2::decompress(out);
+    return out;
+}
+
+void point_decompressor_2::decompressColumns(const point_columns& cols, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        p_->point_.decompress(cols, i);
+        p_->rgb_.decompress(cols, i);
+        p_->byte_.decompress(cols, i);
+        handleFirst();
+    }
+}
+
 // DECOMPRESSOR 3
 
 point_decompressor_3::~point_decompressor_3()
@@ -377,32 +537,96 @@ char *point_decompressor_3::decompress(char *in)
     return in;
 }
 
+char *point_decompressor_3::decompressPoints(char *out, size_t count)
+{
+    while (count--)
+        out = point_decompressor_3::decompress(out);
+    return out;
+}
+
+void point_decompressor_3::decompressColumns(const point_columns& cols, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        p_->point_.decompress(cols, i);
+        p_->gpstime_.decompress(cols, i);
+        p_->rgb_.decompress(cols, i);
+        p_->byte_.decompress(cols, i);
+        handleFirst();
+    }
+}
+
 // 1.4 BASE DECOMPRESSOR
 
 struct point_decompressor_base_1_4::Private
 {
 public:
-    Private(InputCb cb, size_t ebCount) : cbStream_(cb), point_(cbStream_), rgb_(cbStream_),
-        nir_(cbStream_), byte_(cbStream_, ebCount), chunk_count_(0), first_(true)
+    Private(LayerSource source, size_t ebCount, uint32_t layers) : cbStream_(source),
+        point_(cbStream_, layers), rgb_(cbStream_, layers & layer::Rgb),
+        nir_(cbStream_, layers & layer::Nir), byte_(cbStream_, ebCount, layers),
+        chunk_count_(0), first_(true)
     {}
 
-    InCbStream cbStream_;
+    LayerSource cbStream_;
     detail::Point14Decompressor point_;
     detail::Rgb14Decompressor rgb_;
     detail::Nir14Decompressor nir_;
     detail::Byte14Decompressor byte_;
+
+    // Read the point count and the stream sizes and data for each data member.
+    void handleFirst(bool rgb, bool nir)
+    {
+        if (!first_)
+            return;
+        cbStream_ >> chunk_count_;
+        point_.readSizes();
+        if (rgb)
+            rgb_.readSizes();
+        if (nir)
+            nir_.readSizes();
+        if (byte_.count())
+            byte_.readSizes();
+
+        point_.readData();
+        if (rgb)
+            rgb_.readData();
+        if (nir)
+            nir_.readData();
+        if (byte_.count())
+            byte_.readData();
+        first_ = false;
+    }
+
     uint32_t chunk_count_;
     bool first_;
 };
 
-point_decompressor_base_1_4::point_decompressor_base_1_4(InputCb cb, size_t ebCount) :
-    p_(new Private(cb, ebCount))
+point_decompressor_base_1_4::point_decompressor_base_1_4(InputCb cb, size_t ebCount,
+        uint32_t layers) : p_(new Private(LayerSource(cb), ebCount, layers))
+{}
+
+point_decompressor_base_1_4::point_decompressor_base_1_4(SpanStream& span, size_t ebCount,
+        uint32_t layers) : p_(new Private(LayerSource(span), ebCount, layers))
 {}
+
+void point_decompressor_base_1_4::reset()
+{
+    p_->point_.reset();
+    p_->rgb_.reset();
+    p_->nir_.reset();
+    p_->byte_.reset();
+    p_->chunk_count_ = 0;
+    p_->first_ = true;
+}
     
 // DECOMPRESSOR 6
 
-point_decompressor_6::point_decompressor_6(InputCb cb, size_t ebCount) :
-    point_decompressor_base_1_4(cb, ebCount)
+point_decompressor_6::point_decompressor_6(InputCb cb, size_t ebCount, uint32_t layers) :
+    point_decompressor_base_1_4(cb, ebCount, layers)
+{}
+
+point_decompressor_6::point_decompressor_6(SpanStream& span, size_t ebCount,
+        uint32_t layers) : point_decompressor_base_1_4(span, ebCount, layers)
 {}
 
 point_decompressor_6::~point_decompressor_6()
@@ -423,26 +647,38 @@ char *point_decompressor_6::decompress(char *out)
     if (p_->byte_.count())
         out = p_->byte_.decompress(out, channel);
 
-    if (p_->first_)
+    p_->handleFirst(false, false);
+    return out;
+}
+
+char *point_decompressor_6::decompressPoints(char *out, size_t count)
+{
+    while (count--)
+        out = point_decompressor_6::decompress(out);
+    return out;
+}
+
+void point_decompressor_6::decompressColumns(const point_columns& cols, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
     {
-        // Read the point count and the stream sizes for each data member.
-        p_->cbStream_ >> p_->chunk_count_;
-        p_->point_.readSizes();
-        if (p_->byte_.count())
-            p_->byte_.readSizes();
+        int channel = 0;
 
-        p_->point_.readData();
+        p_->point_.decompress(cols, i, channel);
         if (p_->byte_.count())
-            p_->byte_.readData();
-        p_->first_ = false;
+            p_->byte_.decompress(cols, i, channel);
+        p_->handleFirst(false, false);
     }
-    return out;
 }
 
 // DECOMPRESSOR 7
 
-point_decompressor_7::point_decompressor_7(InputCb cb, size_t ebCount) :
-    point_decompressor_base_1_4(cb, ebCount)
+point_decompressor_7::point_decompressor_7(InputCb cb, size_t ebCount, uint32_t layers) :
+    point_decompressor_base_1_4(cb, ebCount, layers)
+{}
+
+point_decompressor_7::point_decompressor_7(SpanStream& span, size_t ebCount,
+        uint32_t layers) : point_decompressor_base_1_4(span, ebCount, layers)
 {}
 
 point_decompressor_7::~point_decompressor_7()
@@ -465,28 +701,39 @@ char *point_decompressor_7::decompress(char *out)
     if (p_->byte_.count())
         out = p_->byte_.decompress(out, channel);
 
-    if (p_->first_)
+    p_->handleFirst(true, false);
+    return out;
+}
+
+char *point_decompressor_7::decompressPoints(char *out, size_t count)
+{
+    while (count--)
+        out = point_decompressor_7::decompress(out);
+    return out;
+}
+
+void point_decompressor_7::decompressColumns(const point_columns& cols, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
     {
-        // Read the point count the streams for each data member.
-        p_->cbStream_ >> p_->chunk_count_;
-        p_->point_.readSizes();
-        p_->rgb_.readSizes();
-        if (p_->byte_.count())
-            p_->byte_.readSizes();
+        int channel = 0;
 
-        p_->point_.readData();
-        p_->rgb_.readData();
+        p_->point_.decompress(cols, i, channel);
+        p_->rgb_.decompress(cols, i, channel);
         if (p_->byte_.count())
-            p_->byte_.readData();
-        p_->first_ = false;
+            p_->byte_.decompress(cols, i, channel);
+        p_->handleFirst(true, false);
     }
-    return out;
 }
 
 // DECOMPRESSOR 8
 
-point_decompressor_8::point_decompressor_8(InputCb cb, size_t ebCount) :
-    point_decompressor_base_1_4(cb, ebCount)
+point_decompressor_8::point_decompressor_8(InputCb cb, size_t ebCount, uint32_t layers) :
+    point_decompressor_base_1_4(cb, ebCount, layers)
+{}
+
+point_decompressor_8::point_decompressor_8(SpanStream& span, size_t ebCount,
+        uint32_t layers) : point_decompressor_base_1_4(span, ebCount, layers)
 {}
 
 point_decompressor_8::~point_decompressor_8()
@@ -511,28 +758,36 @@ char *point_decompressor_8::decompress(char *out)
     if (p_->byte_.count())
         out = p_->byte_.decompress(out, channel);
 
-    if (p_->first_)
+    p_->handleFirst(true, true);
+    return out;
+}
+
+char *point_decompressor_8::decompressPoints(char *out, size_t count)
+{
+    while (count--)
+        out = point_decompressor_8::decompress(out);
+    return out;
+}
+
+void point_decompressor_8::decompressColumns(const point_columns& cols, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
     {
-        // Read the point count the streams for each data member.
-        p_->cbStream_ >> p_->chunk_count_;
-        p_->point_.readSizes();
-        p_->rgb_.readSizes();
-        p_->nir_.readSizes();
-        if (p_->byte_.count())
-            p_->byte_.readSizes();
+        int channel = 0;
 
-        p_->point_.readData();
-        p_->rgb_.readData();
-        p_->nir_.readData();
+        p_->point_.decompress(cols, i, channel);
+        p_->rgb_.decompress(cols, i, channel);
+        p_->nir_.decompress(cols, i, channel);
         if (p_->byte_.count())
-            p_->byte_.readData();
-        p_->first_ = false;
+            p_->byte_.decompress(cols, i, channel);
+        p_->handleFirst(true, true);
     }
-    return out;
 }
 
 // FACTORY
 
+// Formats 0 through 3 are coded with point_codec.
+
 las_compressor::ptr build_las_compressor(OutputCb cb, int format, size_t ebCount)
 {
     las_compressor::ptr compressor;
@@ -540,16 +795,10 @@ las_compressor::ptr build_las_compressor(OutputCb cb, int format, size_t ebCount
     switch (format)
     {
     case 0:
-        compressor.reset(new point_compressor_0(cb, ebCount));
-        break;
     case 1:
-        compressor.reset(new point_compressor_1(cb, ebCount));
-        break;
     case 2:
-        compressor.reset(new point_compressor_2(cb, ebCount));
-        break;
     case 3:
-        compressor.reset(new point_compressor_3(cb, ebCount));
+        compressor = build_codec_compressor(OutCbStream(cb), format, ebCount);
         break;
     case 6:
         compressor.reset(new point_compressor_6(cb, ebCount));
@@ -564,37 +813,107 @@ las_compressor::ptr build_las_compressor(OutputCb cb, int format, size_t ebCount
     return compressor;
 }
 
-las_decompressor::ptr build_las_decompressor(InputCb cb, int format, size_t ebCount)
+las_decompressor::ptr build_las_decompressor(InputCb cb, int format, size_t ebCount,
+    uint32_t layers)
 {
     las_decompressor::ptr decompressor;
 
     switch (format)
     {
     case 0:
-        decompressor.reset(new point_decompressor_0(cb, ebCount));
-        break;
     case 1:
-        decompressor.reset(new point_decompressor_1(cb, ebCount));
-        break;
     case 2:
-        decompressor.reset(new point_decompressor_2(cb, ebCount));
+    case 3:
+        decompressor = build_codec_decompressor(InCbStream(cb), format, ebCount);
+        break;
+    case 6:
+        decompressor.reset(new point_decompressor_6(cb, ebCount, layers));
+        break;
+    case 7:
+        decompressor.reset(new point_decompressor_7(cb, ebCount, layers));
         break;
+    case 8:
+        decompressor.reset(new point_decompressor_8(cb, ebCount, layers));
+        break;
+    }
+    return decompressor;
+}
+
+las_decompressor::ptr build_las_decompressor(SpanStream& span, int format, size_t ebCount,
+    uint32_t layers)
+{
+    las_decompressor::ptr decompressor;
+
+    switch (format)
+    {
+    case 0:
+    case 1:
+    case 2:
     case 3:
-        decompressor.reset(new point_decompressor_3(cb, ebCount));
+        decompressor = build_codec_decompressor<SpanStream&>(span, format, ebCount);
         break;
     case 6:
-        decompressor.reset(new point_decompressor_6(cb, ebCount));
+        decompressor.reset(new point_decompressor_6(span, ebCount, layers));
         break;
     case 7:
-        decompressor.reset(new point_decompressor_7(cb, ebCount));
+        decompressor.reset(new point_decompressor_7(span, ebCount, layers));
         break;
     case 8:
-        decompressor.reset(new point_decompressor_8(cb, ebCount));
+        decompressor.reset(new point_decompressor_8(span, ebCount, layers));
         break;
     }
     return decompressor;
 }
 
+namespace
+{
+
+// A 1.4 decompressor that reads from a span of its own.
+class span_decompressor final : public las_decompressor
+{
+public:
+    span_decompressor(const unsigned char *data, size_t len, int format, size_t ebCount,
+            uint32_t layers) : span_(data, len),
+        decompressor_(build_las_decompressor(span_, format, ebCount, layers))
+    {}
+
+    bool valid() const
+    { return (bool)decompressor_; }
+
+    virtual char *decompress(char *out)
+    { return decompressor_->decompress(out); }
+
+    virtual char *decompressPoints(char *out, size_t count)
+    { return decompressor_->decompressPoints(out, count); }
+
+    virtual void decompressColumns(const point_columns& cols, size_t count)
+    { decompressor_->decompressColumns(cols, count); }
+
+    virtual void reset()
+    { decompressor_->reset(); }
+
+private:
+    SpanStream span_;
+    las_decompressor::ptr decompressor_;
+};
+
+} // unnamed namespace
+
+las_decompressor::ptr build_las_decompressor(const unsigned char *data, size_t len,
+    int format, size_t ebCount, uint32_t layers)
+{
+    las_decompressor::ptr decompressor =
+        build_codec_decompressor(SpanStream(data, len), format, ebCount);
+    if (!decompressor)
+    {
+        std::shared_ptr<span_decompressor> d(
+            new span_decompressor(data, len, format, ebCount, layers));
+        if (d->valid())
+            decompressor = d;
+    }
+    return decompressor;
+}
+
 // CHUNK TABLE
 
 // NOTE: Only works with fixed-sized chunks.
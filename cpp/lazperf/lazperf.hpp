@@ -32,6 +32,7 @@
 #include <memory>
 #include <vector>
 
+#include "columns.hpp"
 #include "header.hpp"
 #include "lazperf_base.hpp"
 
@@ -44,13 +45,20 @@ using OutputCb = std::function<void(const unsigned char *, size_t)>;
 // Called when compressed input is to be read.
 using InputCb = std::function<void(unsigned char *, size_t)>;
 
+struct SpanStream;
+
 class LAZPERF_EXPORT las_compressor
 {
 public:
     typedef std::shared_ptr<las_compressor> ptr;
 
     virtual const char *compress(const char *in) = 0;
+    // Compress 'count' consecutive points. Returns a pointer past the last point read.
+    virtual const char *compressPoints(const char *in, size_t count);
     virtual void done() = 0;
+    // Prepare to compress a new chunk once done() has been called. Output continues to
+    // the same destination. This is much cheaper than building a new compressor.
+    virtual void reset();
     virtual ~las_compressor();
 };
 
@@ -60,6 +68,14 @@ public:
     typedef std::shared_ptr<las_decompressor> ptr;
 
     virtual char *decompress(char *in) = 0;
+    // Decompress 'count' consecutive points. Returns a pointer past the last point written.
+    virtual char *decompressPoints(char *out, size_t count);
+    // Decompress 'count' consecutive points into columns, starting at index 0 of each.
+    virtual void decompressColumns(const point_columns& cols, size_t count);
+    // Prepare to decompress a new chunk. Input continues from the same source, which must
+    // be positioned at the start of the chunk. This is much cheaper than building a new
+    // decompressor.
+    virtual void reset();
     virtual ~las_decompressor();
 };
 
@@ -69,6 +85,7 @@ class point_compressor_base_1_2 : public las_compressor
 
 public:
     LAZPERF_EXPORT void done();
+    LAZPERF_EXPORT void reset();
 
 protected:
     point_compressor_base_1_2(OutputCb cb, size_t ebCount);
@@ -84,6 +101,7 @@ public:
     LAZPERF_EXPORT ~point_compressor_0();
 
     LAZPERF_EXPORT virtual const char *compress(const char *in);
+    LAZPERF_EXPORT virtual const char *compressPoints(const char *in, size_t count);
 };
 
 class point_compressor_1 final : public point_compressor_base_1_2
@@ -93,6 +111,7 @@ public:
     LAZPERF_EXPORT ~point_compressor_1();
 
     LAZPERF_EXPORT virtual const char *compress(const char *in);
+    LAZPERF_EXPORT virtual const char *compressPoints(const char *in, size_t count);
 };
 
 class point_compressor_2 final : public point_compressor_base_1_2
@@ -102,6 +121,7 @@ public:
     LAZPERF_EXPORT ~point_compressor_2();
 
     LAZPERF_EXPORT virtual const char *compress(const char *in);
+    LAZPERF_EXPORT virtual const char *compressPoints(const char *in, size_t count);
 };
 
 class point_compressor_3 final : public point_compressor_base_1_2
@@ -111,6 +131,7 @@ public:
     LAZPERF_EXPORT ~point_compressor_3();
 
     LAZPERF_EXPORT virtual const char *compress(const char *in);
+    LAZPERF_EXPORT virtual const char *compressPoints(const char *in, size_t count);
 };
 
 class point_compressor_base_1_4 : public las_compressor
@@ -119,6 +140,7 @@ class point_compressor_base_1_4 : public las_compressor
 
 public:
     virtual const char *compress(const char *in) = 0;
+    LAZPERF_EXPORT void reset();
 
 protected:
     point_compressor_base_1_4(OutputCb cb, size_t ebCount);
@@ -134,6 +156,7 @@ public:
     LAZPERF_EXPORT ~point_compressor_6();
 
     LAZPERF_EXPORT virtual const char *compress(const char *in);
+    LAZPERF_EXPORT virtual const char *compressPoints(const char *in, size_t count);
     LAZPERF_EXPORT virtual void done();
 };
 
@@ -144,6 +167,7 @@ public:
     LAZPERF_EXPORT ~point_compressor_7();
 
     LAZPERF_EXPORT virtual const char *compress(const char *in);
+    LAZPERF_EXPORT virtual const char *compressPoints(const char *in, size_t count);
     LAZPERF_EXPORT virtual void done();
 };
 
@@ -154,6 +178,7 @@ public:
     LAZPERF_EXPORT ~point_compressor_8();
 
     LAZPERF_EXPORT virtual const char *compress(const char *in);
+    LAZPERF_EXPORT virtual const char *compressPoints(const char *in, size_t count);
     LAZPERF_EXPORT virtual void done();
 };
 
@@ -166,6 +191,7 @@ class point_decompressor_base_1_2 : public las_decompressor
 
 public:
     virtual char *decompress(char *in) = 0;
+    LAZPERF_EXPORT void reset();
     virtual ~point_decompressor_base_1_2();
 
 protected:
@@ -182,6 +208,8 @@ public:
     LAZPERF_EXPORT ~point_decompressor_0();
 
     LAZPERF_EXPORT virtual char *decompress(char *in);
+    LAZPERF_EXPORT virtual char *decompressPoints(char *out, size_t count);
+    LAZPERF_EXPORT virtual void decompressColumns(const point_columns& cols, size_t count);
 };
 
 class point_decompressor_1 final : public point_decompressor_base_1_2
@@ -191,6 +219,8 @@ public:
     LAZPERF_EXPORT ~point_decompressor_1();
 
     LAZPERF_EXPORT virtual char *decompress(char *out);
+    LAZPERF_EXPORT virtual char *decompressPoints(char *out, size_t count);
+    LAZPERF_EXPORT virtual void decompressColumns(const point_columns& cols, size_t count);
 };
 
 class point_decompressor_2 final : public point_decompressor_base_1_2
@@ -200,6 +230,8 @@ public:
     LAZPERF_EXPORT ~point_decompressor_2();
 
     LAZPERF_EXPORT virtual char *decompress(char *out);
+    LAZPERF_EXPORT virtual char *decompressPoints(char *out, size_t count);
+    LAZPERF_EXPORT virtual void decompressColumns(const point_columns& cols, size_t count);
 };
 
 class point_decompressor_3 final : public point_decompressor_base_1_2
@@ -209,6 +241,8 @@ public:
     LAZPERF_EXPORT ~point_decompressor_3();
 
     LAZPERF_EXPORT virtual char *decompress(char *out);
+    LAZPERF_EXPORT virtual char *decompressPoints(char *out, size_t count);
+    LAZPERF_EXPORT virtual void decompressColumns(const point_columns& cols, size_t count);
 };
 
 class point_decompressor_base_1_4 : public las_decompressor
@@ -217,9 +251,11 @@ class point_decompressor_base_1_4 : public las_decompressor
 
 public:
     virtual char *decompress(char *out) = 0;
+    LAZPERF_EXPORT void reset();
 
 protected:
-    point_decompressor_base_1_4(InputCb cb, size_t ebCount);
+    point_decompressor_base_1_4(InputCb cb, size_t ebCount, uint32_t layers);
+    point_decompressor_base_1_4(SpanStream& span, size_t ebCount, uint32_t layers);
 
     std::unique_ptr<Private> p_;
 };
@@ -227,36 +263,68 @@ protected:
 class point_decompressor_6 final : public point_decompressor_base_1_4
 {
 public:
-    LAZPERF_EXPORT point_decompressor_6(InputCb cb, size_t ebCount = 0);
+    LAZPERF_EXPORT point_decompressor_6(InputCb cb, size_t ebCount = 0,
+        uint32_t layers = layer::All);
+    // Read from 'span', which must outlive the decompressor. The layers of each chunk are
+    // decoded in place.
+    LAZPERF_EXPORT point_decompressor_6(SpanStream& span, size_t ebCount = 0,
+        uint32_t layers = layer::All);
     LAZPERF_EXPORT ~point_decompressor_6();
 
     LAZPERF_EXPORT virtual char *decompress(char *out);
+    LAZPERF_EXPORT virtual char *decompressPoints(char *out, size_t count);
+    LAZPERF_EXPORT virtual void decompressColumns(const point_columns& cols, size_t count);
 };
 
 class point_decompressor_7 final : public point_decompressor_base_1_4
 {
 public:
-    LAZPERF_EXPORT point_decompressor_7(InputCb cb, size_t ebCount = 0);
+    LAZPERF_EXPORT point_decompressor_7(InputCb cb, size_t ebCount = 0,
+        uint32_t layers = layer::All);
+    // Read from 'span', which must outlive the decompressor. The layers of each chunk are
+    // decoded in place.
+    LAZPERF_EXPORT point_decompressor_7(SpanStream& span, size_t ebCount = 0,
+        uint32_t layers = layer::All);
     LAZPERF_EXPORT ~point_decompressor_7();
 
     LAZPERF_EXPORT virtual char *decompress(char *out);
+    LAZPERF_EXPORT virtual char *decompressPoints(char *out, size_t count);
+    LAZPERF_EXPORT virtual void decompressColumns(const point_columns& cols, size_t count);
 };
 
 struct point_decompressor_8 final : public point_decompressor_base_1_4
 {
 public:
     LAZPERF_EXPORT ~point_decompressor_8();
-    LAZPERF_EXPORT point_decompressor_8(InputCb cb, size_t ebCount = 0);
+    LAZPERF_EXPORT point_decompressor_8(InputCb cb, size_t ebCount = 0,
+        uint32_t layers = layer::All);
+    // Read from 'span', which must outlive the decompressor. The layers of each chunk are
+    // decoded in place.
+    LAZPERF_EXPORT point_decompressor_8(SpanStream& span, size_t ebCount = 0,
+        uint32_t layers = layer::All);
 
     LAZPERF_EXPORT virtual char *decompress(char *out);
+    LAZPERF_EXPORT virtual char *decompressPoints(char *out, size_t count);
+    LAZPERF_EXPORT virtual void decompressColumns(const point_columns& cols, size_t count);
 };
 
 // FACTORY
 
 LAZPERF_EXPORT las_compressor::ptr build_las_compressor(OutputCb, int format,
     size_t ebCount = 0);
+// 'layers' selects the data to decompress for point formats 6, 7 and 8. It's ignored for
+// other formats.
 LAZPERF_EXPORT las_decompressor::ptr build_las_decompressor(InputCb, int format,
-    size_t ebCount = 0);
+    size_t ebCount = 0, uint32_t layers = layer::All);
+// Build a decompressor that reads from 'span' (see streams.hpp), which must outlive it.
+// The span can be set to the data of the next chunk before reset() is called. Nothing is
+// copied from the span, including the layers of point formats 6, 7 and 8.
+LAZPERF_EXPORT las_decompressor::ptr build_las_decompressor(SpanStream& span, int format,
+    size_t ebCount = 0, uint32_t layers = layer::All);
+// Build a decompressor that reads the 'len' bytes of compressed data at 'data' directly.
+// Reading never goes past the end of the data.
+LAZPERF_EXPORT las_decompressor::ptr build_las_decompressor(const unsigned char *data,
+    size_t len, int format, size_t ebCount = 0, uint32_t layers = layer::All);
 
 // CHUNK TABLE
 
@@ -0,0 +1,257 @@
+/******************************************************************************
+* Copyright (c) 2026, Hobu Inc., info@hobu.co
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following
+* conditions are met:
+*
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in
+*       the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of Hobu, Inc. or Flaxen Geo Consulting nor the
+*       names of its contributors may be used to endorse or promote
+*       products derived from this software without specific prior
+*       written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+* COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+* OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+* AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+* OF SUCH DAMAGE.
+****************************************************************************/
+
+
+
+#include "model.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+#define LAZPERF_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define LAZPERF_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+namespace lazperf
+{
+namespace models
+{
+namespace kernels
+{
+
+namespace
+{
+
+const uint32_t DistributionShift = 31 - DM__LengthShift;
+
+// Below this many symbols the vector setup costs more than it saves.
+const uint32_t MinVectorSymbols = 32;
+
+#ifdef LAZPERF_SSE2
+
+// Returns the number of counts halved. The rest are left to the scalar code.
+size_t halveSse2(uint32_t *counts, size_t symbols, uint32_t& total)
+{
+    const __m128i one = _mm_set1_epi32(1);
+    __m128i sum = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 4 <= symbols; i += 4)
+    {
+        __m128i *p = reinterpret_cast<__m128i *>(counts + i);
+        __m128i v = _mm_srli_epi32(_mm_add_epi32(_mm_loadu_si128(p), one), 1);
+        _mm_storeu_si128(p, v);
+        sum = _mm_add_epi32(sum, v);
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    total = (uint32_t)_mm_cvtsi128_si32(sum);
+    return i;
+}
+
+// SSE2 has no 32-bit multiply-low, so the even and odd lanes are multiplied separately
+// and the low halves of the products are interleaved.
+inline __m128i mulloSse2(__m128i a, __m128i b)
+{
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+        _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+// Returns the number of distribution values computed. 'sum' is set to the sum of the
+// counts used.
+size_t distributeSse2(const uint32_t *counts, uint32_t *dist, size_t symbols,
+    uint32_t scale, uint32_t& sum)
+{
+    const __m128i s = _mm_set1_epi32((int)scale);
+    __m128i carry = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 4 <= symbols; i += 4)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(counts + i));
+        // Inclusive prefix sum of the four counts, plus the sum of the earlier counts.
+        __m128i incl = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+        incl = _mm_add_epi32(incl, _mm_slli_si128(incl, 8));
+        incl = _mm_add_epi32(incl, carry);
+        __m128i excl = _mm_sub_epi32(incl, v);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dist + i),
+            _mm_srli_epi32(mulloSse2(excl, s), DistributionShift));
+        carry = _mm_shuffle_epi32(incl, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+    sum = (uint32_t)_mm_cvtsi128_si32(carry);
+    return i;
+}
+
+#endif // LAZPERF_SSE2
+
+#ifdef LAZPERF_AVX2
+
+__attribute__((target("avx2")))
+size_t halveAvx2(uint32_t *counts, size_t symbols, uint32_t& total)
+{
+    const __m256i one = _mm256_set1_epi32(1);
+    __m256i sum = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= symbols; i += 8)
+    {
+        __m256i *p = reinterpret_cast<__m256i *>(counts + i);
+        __m256i v = _mm256_srli_epi32(_mm256_add_epi32(_mm256_loadu_si256(p), one), 1);
+        _mm256_storeu_si256(p, v);
+        sum = _mm256_add_epi32(sum, v);
+    }
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    total = (uint32_t)_mm_cvtsi128_si32(s);
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t distributeAvx2(const uint32_t *counts, uint32_t *dist, size_t symbols,
+    uint32_t scale, uint32_t& sum)
+{
+    const __m256i s = _mm256_set1_epi32((int)scale);
+    const __m256i last = _mm256_set1_epi32(7);
+    __m256i carry = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= symbols; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(counts + i));
+        // Prefix sums within each 128-bit half, then the low half's total is added
+        // to the high half.
+        __m256i incl = _mm256_add_epi32(v, _mm256_slli_si256(v, 4));
+        incl = _mm256_add_epi32(incl, _mm256_slli_si256(incl, 8));
+        __m256i low = _mm256_shuffle_epi32(incl, _MM_SHUFFLE(3, 3, 3, 3));
+        incl = _mm256_add_epi32(incl, _mm256_permute2x128_si256(low, low, 0x08));
+        incl = _mm256_add_epi32(incl, carry);
+        __m256i excl = _mm256_sub_epi32(incl, v);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dist + i),
+            _mm256_srli_epi32(_mm256_mullo_epi32(excl, s), DistributionShift));
+        carry = _mm256_permutevar8x32_epi32(incl, last);
+    }
+    sum = (uint32_t)_mm_cvtsi128_si32(_mm256_castsi256_si128(carry));
+    return i;
+}
+
+#endif // LAZPERF_AVX2
+
+} // unnamed namespace
+
+uint32_t halveScalar(uint32_t *counts, uint32_t symbols)
+{
+    uint32_t total = 0;
+    for (uint32_t n = 0; n < symbols; n++)
+        total += (counts[n] = (counts[n] + 1) >> 1);
+    return total;
+}
+
+void distributeScalar(const uint32_t *counts, uint32_t *dist, uint32_t symbols,
+    uint32_t scale)
+{
+    uint32_t sum = 0;
+    for (uint32_t k = 0; k < symbols; k++)
+    {
+        dist[k] = (scale * sum) >> DistributionShift;
+        sum += counts[k];
+    }
+}
+
+uint32_t halve(uint32_t *counts, uint32_t symbols)
+{
+    if (symbols < MinVectorSymbols)
+        return halveScalar(counts, symbols);
+    return halve(counts, symbols, simd::best());
+}
+
+uint32_t halve(uint32_t *counts, uint32_t symbols, simd::Isa isa)
+{
+    size_t done = 0;
+    uint32_t total = 0;
+    switch (isa)
+    {
+#ifdef LAZPERF_AVX2
+    case simd::Isa::Avx2:
+        done = halveAvx2(counts, symbols, total);
+        break;
+#endif
+#ifdef LAZPERF_SSE2
+    case simd::Isa::Sse2:
+        done = halveSse2(counts, symbols, total);
+        break;
+#endif
+    default:
+        break;
+    }
+    return total + halveScalar(counts + done, symbols - (uint32_t)done);
+}
+
+void distribute(const uint32_t *counts, uint32_t *dist, uint32_t symbols, uint32_t scale)
+{
+    if (symbols < MinVectorSymbols)
+        return distributeScalar(counts, dist, symbols, scale);
+    distribute(counts, dist, symbols, scale, simd::best());
+}
+
+void distribute(const uint32_t *counts, uint32_t *dist, uint32_t symbols, uint32_t scale,
+    simd::Isa isa)
+{
+    size_t done = 0;
+    uint32_t sum = 0;
+    switch (isa)
+    {
+#ifdef LAZPERF_AVX2
+    case simd::Isa::Avx2:
+        done = distributeAvx2(counts, dist, symbols, scale, sum);
+        break;
+#endif
+#ifdef LAZPERF_SSE2
+    case simd::Isa::Sse2:
+        done = distributeSse2(counts, dist, symbols, scale, sum);
+        break;
+#endif
+    default:
+        break;
+    }
+    for (uint32_t k = (uint32_t)done; k < symbols; k++)
+    {
+        dist[k] = (scale * sum) >> DistributionShift;
+        sum += counts[k];
+    }
+}
+
+} // namespace kernels
+} // namespace models
+} // namespace lazperf
@@ -32,37 +32,113 @@
 #define __model_hpp__
 
 #include "coderbase.hpp"
+#include "lazperf_base.hpp"
+#include "simd.hpp"
 #include "utils.hpp"
 
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <memory>
+#include <new>
 #include <stdexcept>
+#include <type_traits>
+#include <vector>
 
 namespace lazperf
 {
 namespace models
 {
+namespace kernels
+{
+		// Halve each count, rounding up, and return the new total. Runs with SSE2 or AVX2
+		// when the CPU supports it.
+		LAZPERF_EXPORT uint32_t halve(uint32_t *counts, uint32_t symbols);
+		// Set dist[k] to the scaled sum of the counts before k. Runs with SSE2 or AVX2
+		// when the CPU supports it.
+		LAZPERF_EXPORT void distribute(const uint32_t *counts, uint32_t *dist, uint32_t symbols,
+			uint32_t scale);
+		// As above, but run with 'isa' whatever the number of symbols, so each vector
+		// version can be tested. 'isa' must be supported.
+		LAZPERF_EXPORT uint32_t halve(uint32_t *counts, uint32_t symbols, simd::Isa isa);
+		LAZPERF_EXPORT void distribute(const uint32_t *counts, uint32_t *dist, uint32_t symbols,
+			uint32_t scale, simd::Isa isa);
+		// Scalar versions of the above, which the vector code must match exactly.
+		LAZPERF_EXPORT uint32_t halveScalar(uint32_t *counts, uint32_t symbols);
+		LAZPERF_EXPORT void distributeScalar(const uint32_t *counts, uint32_t *dist,
+			uint32_t symbols, uint32_t scale);
+} // namespace kernels
+
+		// A cache-line-aligned block that holds the tables of the models of a coder, so
+		// that they lie together in memory and cost one allocation. Its size is the sum of
+		// arithmetic::bytes() for the models placed in it, which must be destroyed before
+		// the slab.
+		class slab {
+		public:
+			explicit slab(size_t bytes = 0) : base(nullptr), size(0), used(0) {
+				allocate(bytes);
+			}
+
+			~slab() {
+				if (base) utils::aligned_free(base);
+			}
+
+			slab(slab&& other) : base(other.base), size(other.size), used(other.used) {
+				other.base = nullptr;
+				other.size = other.used = 0;
+			}
+
+			slab(const slab&) = delete;
+			slab& operator = (const slab&) = delete;
+
+			// Replace the block with one of 'bytes' bytes. No model may be in the old block.
+			void allocate(size_t bytes) {
+				if (base) utils::aligned_free(base);
+				base = bytes ? reinterpret_cast<char *>(utils::aligned_malloc((int)bytes)) : nullptr;
+				size = bytes;
+				used = 0;
+			}
+
+			// Take 'bytes' bytes of the block for the tables of a model.
+			uint32_t *take(size_t bytes) {
+				if (used + bytes > size)
+					throw std::runtime_error("Model slab is too small");
+				uint32_t *p = reinterpret_cast<uint32_t *>(base + used);
+				used += bytes;
+				return p;
+			}
+
+		private:
+			char *base;
+			size_t size;
+			size_t used;
+		};
+
 		struct arithmetic {
 			arithmetic(uint32_t syms, bool com = false, uint32_t *initTable = nullptr) :
-				symbols(syms), compress(com),
+				arithmetic(nullptr, syms, com, initTable)
+			{}
+
+			// Place the tables of the model in 's'.
+			arithmetic(slab& s, uint32_t syms, bool com = false) :
+				arithmetic(s.take(bytes(syms, com)), syms, com, nullptr)
+			{}
+
+			// The tables are placed at 'tables', which must hold bytes(syms, com) bytes and
+			// outlive the model. If 'tables' is null, the model allocates them.
+			arithmetic(uint32_t *tables, uint32_t syms, bool com, uint32_t *initTable) :
+				symbols(syms), compress(com), block(nullptr),
 				distribution(nullptr), symbol_count(nullptr), decoder_table(nullptr) {
 				if ( (symbols < 2) || (symbols > (1 << 11)) ) {
 					throw std::runtime_error("Invalid number of symbols");
 				}
 
 				last_symbol = symbols - 1;
-				if ((!compress) && (symbols > 16)) {
-					uint32_t table_bits = 3;
-					while (symbols > (1U << (table_bits + 2))) ++table_bits;
-					table_size  = 1 << table_bits;
-					table_shift = DM__LengthShift - table_bits;
-					decoder_table = reinterpret_cast<uint32_t*>(utils::aligned_malloc(sizeof(uint32_t) * (table_size + 2)));
-				}
-				else { // small alphabet: no table needed
-					decoder_table = 0;
-					table_size = table_shift = 0;
-				}
-
-				distribution = reinterpret_cast<uint32_t*>(utils::aligned_malloc(symbols * sizeof(uint32_t)));
-				symbol_count = reinterpret_cast<uint32_t*>(utils::aligned_malloc(symbols * sizeof(uint32_t)));
+				tableSize(symbols, compress, table_size, table_shift);
+				if (tables)
+					place(tables);
+				else
+					allocate();
 
 				total_count = 0;
 				update_cycle = symbols;
@@ -77,54 +153,39 @@ namespace models
 			}
 
 			~arithmetic() {
-				if (distribution) utils::aligned_free(distribution);
-				if (symbol_count) utils::aligned_free(symbol_count);
-				if (decoder_table) utils::aligned_free(decoder_table);
+				if (block) utils::aligned_free(block);
 			}
 
+			// The copy allocates its own tables.
 			arithmetic(const arithmetic& other)
-				: symbols(other.symbols), compress(other.compress),
+				: symbols(other.symbols), compress(other.compress), block(nullptr),
 				  total_count(other.total_count), update_cycle(other.update_cycle),
 				  symbols_until_update(other.symbols_until_update), last_symbol(other.last_symbol),
 				  table_size(other.table_size), table_shift(other.table_shift)
             {
-                size_t size(symbols * sizeof(uint32_t));
-                distribution = reinterpret_cast<uint32_t*>(utils::aligned_malloc(size));
-                std::copy(other.distribution, other.distribution + symbols, distribution);
-
-                symbol_count = reinterpret_cast<uint32_t*>(utils::aligned_malloc(size));
-                std::copy(other.symbol_count, other.symbol_count + symbols, symbol_count);
-
-                if (table_size)
-                {
-                    size = (table_size + 2) * sizeof(uint32_t);
-                    decoder_table = reinterpret_cast<uint32_t*>(utils::aligned_malloc(size));
-                    std::copy(other.decoder_table, other.decoder_table + (table_size + 2), decoder_table);
-                }
-                else
-                    decoder_table = nullptr;
+                allocate();
+                std::copy(other.distribution, other.distribution + words(), distribution);
 			}
 
 			arithmetic(arithmetic&& other) : symbols(other.symbols), compress(other.compress),
+				block(other.block),
                 distribution(other.distribution), symbol_count(other.symbol_count),
 				decoder_table(other.decoder_table),
 				total_count(other.total_count), update_cycle(other.update_cycle),
 				symbols_until_update(other.symbols_until_update), last_symbol(other.last_symbol),
 				table_size(other.table_size), table_shift(other.table_shift)
             {
-                other.distribution = other.decoder_table = other.symbol_count = NULL;
-                other.symbol_count = 0;
+                other.block = other.distribution = other.decoder_table = other.symbol_count = NULL;
 			}
 
 			arithmetic& operator = (arithmetic&& other) {
 				if (this != &other) {
-					if (distribution) utils::aligned_free(distribution);
-					if (symbol_count) utils::aligned_free(symbol_count);
-					if (decoder_table) utils::aligned_free(decoder_table);
+					if (block) utils::aligned_free(block);
 
 					symbols = other.symbols;
 					compress = other.compress;
 
+					block = other.block;
 					distribution = other.distribution;
 					symbol_count = other.symbol_count;
 					decoder_table = other.decoder_table;
@@ -136,7 +197,8 @@ namespace models
 					table_size = other.table_size;
 					table_shift = other.table_shift;
 
-					other.distribution = other.symbol_count = other.decoder_table = nullptr;
+					other.block = other.distribution = other.symbol_count = other.decoder_table =
+						nullptr;
 					other.total_count = other.update_cycle = other.symbols_until_update =
 						other.last_symbol = other.table_size = other.table_shift = 0;
 				}
@@ -144,32 +206,38 @@ namespace models
 				return *this;
 			}
 
+			// Restore the state the model had when it was constructed without an initial
+			// table. No memory is allocated.
+			void reset() {
+				std::fill(symbol_count, symbol_count + symbols, 1);
+				total_count = 0;
+				update_cycle = symbols;
+				update();
+				symbols_until_update = update_cycle = (symbols + 6) >> 1;
+			}
+
+			// Copy the state of a model with the same number of symbols in place.
+			void assign(const arithmetic& src) {
+				assert(symbols == src.symbols && compress == src.compress);
+				std::copy(src.distribution, src.distribution + words(), distribution);
+				total_count = src.total_count;
+				update_cycle = src.update_cycle;
+				symbols_until_update = src.symbols_until_update;
+			}
+
 			inline void update() {
 				// halve counts when a threshold is reached
-				if ((total_count += update_cycle) > DM__MaxCount) {
-					total_count = 0;
-					for (uint32_t n = 0; n < symbols; n++)
-					{
-						total_count += (symbol_count[n] = (symbol_count[n] + 1) >> 1);
-					}
-				}
+				if ((total_count += update_cycle) > DM__MaxCount)
+					total_count = kernels::halve(symbol_count, symbols);
 
 				// compute cumulative distribution, decoder table
-				uint32_t k, sum = 0, s = 0;
 				uint32_t scale = 0x80000000U / total_count;
+				kernels::distribute(symbol_count, distribution, symbols, scale);
 
-				if (compress || (table_size == 0)) {
-					for (k = 0; k < symbols; k++)
+				if (!compress && table_size) {
+					uint32_t s = 0;
+					for (uint32_t k = 0; k < symbols; k++)
 					{
-						distribution[k] = (scale * sum) >> (31 - DM__LengthShift);
-						sum += symbol_count[k];
-					}
-				}
-				else {
-					for (k = 0; k < symbols; k++)
-					{
-						distribution[k] = (scale * sum) >> (31 - DM__LengthShift);
-						sum += symbol_count[k];
 						uint32_t w = distribution[k] >> table_shift;
 						while (s < w) decoder_table[++s] = k - 1;
 					}
@@ -185,9 +253,53 @@ namespace models
 				symbols_until_update = update_cycle;
 			}
 
+			// The size of the tables of a model in a slab: a whole number of cache lines.
+			static size_t bytes(uint32_t symbols, bool compress = false) {
+				uint32_t size, shift;
+				tableSize(symbols, compress, size, shift);
+				size_t b = words(symbols, size) * sizeof(uint32_t);
+				return (b + ALIGN - 1) & ~(size_t)(ALIGN - 1);
+			}
+
+			static void tableSize(uint32_t symbols, bool compress, uint32_t& size,
+					uint32_t& shift) {
+				if ((!compress) && (symbols > 16)) {
+					uint32_t table_bits = 3;
+					while (symbols > (1U << (table_bits + 2))) ++table_bits;
+					size = 1 << table_bits;
+					shift = DM__LengthShift - table_bits;
+				}
+				else { // small alphabet: no table needed
+					size = shift = 0;
+				}
+			}
+
+			static size_t words(uint32_t symbols, uint32_t table_size) {
+				return 2 * symbols + (table_size ? table_size + 2 : 0);
+			}
+
+			// The distribution, the symbol counts and the decoder table are kept in a single
+			// aligned block, so coding a symbol touches adjacent memory.
+			void allocate() {
+				block = reinterpret_cast<uint32_t*>(
+					utils::aligned_malloc(words() * sizeof(uint32_t)));
+				place(block);
+			}
+
+			void place(uint32_t *tables) {
+				distribution = tables;
+				symbol_count = distribution + symbols;
+				decoder_table = table_size ? symbol_count + symbols : nullptr;
+			}
+
+			size_t words() const {
+				return words(symbols, table_size);
+			}
+
 			uint32_t symbols;
 			bool compress;
 
+			uint32_t *block;  // The tables, if they aren't in a slab.
 			uint32_t * distribution, * symbol_count, * decoder_table;
 
 			uint32_t total_count, update_cycle, symbols_until_update;
@@ -196,6 +308,10 @@ namespace models
 
 		struct arithmetic_bit {
 			arithmetic_bit() {
+				reset();
+			}
+
+			void reset() {
 				// initialization to equiprobable model
 				bit_0_count = 1;
 				bit_count   = 2;
@@ -246,6 +362,81 @@ namespace models
 			uint32_t update_cycle, bits_until_update;
 			uint32_t bit_0_prob, bit_0_count, bit_count;
 		};
+		// Restore models that were all constructed with the same number of symbols. The
+		// first is reset and its state is copied to the rest, which is cheaper than
+		// recomputing each.
+		template <typename TModels>
+		void reset(TModels& models) {
+			auto first = models.begin();
+			if (first == models.end())
+				return;
+			first->reset();
+			for (auto it = std::next(first); it != models.end(); ++it)
+				it->assign(*first);
+		}
+
+		// Models with the same number of symbols, each of which is built the first time
+		// it's used. Many contexts are never seen, so this saves building them. Space for
+		// the tables of all the models is taken from a slab up front, in index order.
+		struct lazy_arithmetic {
+			lazy_arithmetic(slab& s, size_t count, uint32_t symbols) : symbols(symbols),
+				stride(arithmetic::bytes(symbols) / sizeof(uint32_t)),
+				tables(s.take(count * arithmetic::bytes(symbols))), models(count), built(count)
+			{}
+
+			~lazy_arithmetic() {
+				for (size_t i = 0; i < models.size(); ++i)
+					if (built[i])
+						model(i).~arithmetic();
+			}
+
+			lazy_arithmetic(const lazy_arithmetic&) = delete;
+			lazy_arithmetic& operator = (const lazy_arithmetic&) = delete;
+
+			arithmetic& operator[](size_t i) {
+				if (!built[i]) {
+					new (&models[i]) arithmetic(tables + i * stride, symbols, false, nullptr);
+					built[i] = true;
+				}
+				return model(i);
+			}
+
+			// Restore the models that have been built to their initial state.
+			void reset() {
+				arithmetic *first = nullptr;
+				for (size_t i = 0; i < models.size(); ++i) {
+					if (!built[i])
+						continue;
+					if (first)
+						model(i).assign(*first);
+					else {
+						first = &model(i);
+						first->reset();
+					}
+				}
+			}
+
+			arithmetic& model(size_t i) {
+				return *reinterpret_cast<arithmetic *>(&models[i]);
+			}
+
+			uint32_t symbols;
+			size_t stride;
+			uint32_t *tables;
+			std::vector<std::aligned_storage<sizeof(arithmetic),
+				alignof(arithmetic)>::type> models;
+			std::vector<char> built;
+		};
+
+		// Build 'count' models of 'symbols' symbols with their tables in 's'.
+		inline std::vector<arithmetic> build(slab& s, size_t count, uint32_t symbols,
+			bool compress = false) {
+			std::vector<arithmetic> models;
+			models.reserve(count);
+			for (size_t i = 0; i < count; ++i)
+				models.emplace_back(s, symbols, compress);
+			return models;
+		}
 } // namespace models
 } // namespace lazperf
 
@@ -0,0 +1,314 @@
+/******************************************************************************
+* Copyright (c) 2026, Hobu Inc., info@hobu.co
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following
+* conditions are met:
+*
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in
+*       the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of Hobu, Inc. or Flaxen Geo Consulting nor the
+*       names of its contributors may be used to endorse or promote
+*       products derived from this software without specific prior
+*       written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+* COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+* OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+* AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+* OF SUCH DAMAGE.
+****************************************************************************/
+
+
+#pragma once
+
+#include <type_traits>
+
+#include "las.hpp"
+#include "lazperf.hpp"
+
+namespace lazperf
+{
+
+// The extra byte count of a point_codec whose number of extra bytes is set at run time.
+const int VariableEbCount = -1;
+
+// The field coders of point format PDRF (0 through 3) followed by EbCount extra bytes,
+// composed at compile time. The streams are template parameters and the field coders are
+// defined in their headers, so coding a point involves no virtual calls or callbacks and
+// can be inlined into the caller's loop with any stream type. A fixed EbCount is a
+// compile-time trip count for the extra byte loops.
+template <int PDRF, int EbCount = 0>
+struct point_codec
+{
+    static_assert(PDRF >= 0 && PDRF <= 3, "point_codec supports point formats 0 through 3.");
+    static_assert(EbCount >= VariableEbCount, "Invalid extra byte count.");
+
+    static const bool HasTime = (PDRF == 1 || PDRF == 3);
+    static const bool HasRgb = (PDRF == 2 || PDRF == 3);
+
+    static size_t ebCount(size_t count)
+    { return EbCount == VariableEbCount ? count : (size_t)EbCount; }
+
+    template <typename TStream>
+    class compressor
+    {
+    public:
+        // 'count' is the number of extra bytes. It's only used when EbCount is
+        // VariableEbCount.
+        compressor(TStream& stream, size_t count = 0) : encoder_(stream), point_(encoder_),
+            gpstime_(encoder_), rgb_(encoder_), byte_(encoder_, ebCount(count))
+        {}
+
+        const char *compress(const char *in)
+        {
+            in = point_.compress(in);
+            if (HasTime)
+                in = gpstime_.compress(in);
+            if (HasRgb)
+                in = rgb_.compress(in);
+            if (EbCount)
+                in = byte_.compress(in);
+            return in;
+        }
+
+        const char *compressPoints(const char *in, size_t count)
+        {
+            while (count--)
+                in = compress(in);
+            return in;
+        }
+
+        void done()
+        { encoder_.done(); }
+
+        // Prepare to compress a new chunk once done() has been called.
+        void reset()
+        {
+            encoder_.reset();
+            point_.reset();
+            if (HasTime)
+                gpstime_.reset();
+            if (HasRgb)
+                rgb_.reset();
+            if (EbCount)
+                byte_.reset();
+        }
+
+    private:
+        encoders::arithmetic<TStream> encoder_;
+        detail::Point10Compressor<TStream> point_;
+        detail::Gpstime10Compressor<TStream> gpstime_;
+        detail::Rgb10Compressor<TStream> rgb_;
+        detail::Byte10Compressor<TStream, EbCount> byte_;
+    };
+
+    template <typename TStream>
+    class decompressor
+    {
+    public:
+        // 'count' is the number of extra bytes. It's only used when EbCount is
+        // VariableEbCount.
+        decompressor(TStream& stream, size_t count = 0) : decoder_(stream), point_(decoder_),
+            gpstime_(decoder_), rgb_(decoder_), byte_(decoder_, ebCount(count)), first_(true)
+        {}
+
+        char *decompress(char *out)
+        {
+            out = point_.decompress(out);
+            if (HasTime)
+                out = gpstime_.decompress(out);
+            if (HasRgb)
+                out = rgb_.decompress(out);
+            if (EbCount)
+                out = byte_.decompress(out);
+            handleFirst();
+            return out;
+        }
+
+        char *decompressPoints(char *out, size_t count)
+        {
+            while (count--)
+                out = decompress(out);
+            return out;
+        }
+
+        void decompressColumns(const point_columns& cols, size_t count)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                point_.decompress(cols, i);
+                if (HasTime)
+                    gpstime_.decompress(cols, i);
+                if (HasRgb)
+                    rgb_.decompress(cols, i);
+                if (EbCount)
+                    byte_.decompress(cols, i);
+                handleFirst();
+            }
+        }
+
+        // Prepare to decompress a new chunk.
+        void reset()
+        {
+            decoder_.reset();
+            point_.reset();
+            if (HasTime)
+                gpstime_.reset();
+            if (HasRgb)
+                rgb_.reset();
+            if (EbCount)
+                byte_.reset();
+            first_ = true;
+        }
+
+    private:
+        // The decoder is initialized once the first point, which is stored raw, is read.
+        void handleFirst()
+        {
+            if (first_)
+            {
+                decoder_.readInitBytes();
+                first_ = false;
+            }
+        }
+
+        decoders::arithmetic<TStream> decoder_;
+        detail::Point10Decompressor<TStream> point_;
+        detail::Gpstime10Decompressor<TStream> gpstime_;
+        detail::Rgb10Decompressor<TStream> rgb_;
+        detail::Byte10Decompressor<TStream, EbCount> byte_;
+        bool first_;
+    };
+};
+
+namespace detail
+{
+
+// A las_compressor that codes through a point_codec. TStream may be a reference type, in
+// which case the stream is owned by the caller.
+template <typename TStream, int PDRF, int EbCount>
+class codec_compressor final : public las_compressor
+{
+    using Stream = typename std::remove_reference<TStream>::type;
+
+public:
+    codec_compressor(TStream stream, size_t ebCount) : stream_(stream), codec_(stream_, ebCount)
+    {}
+
+    virtual const char *compress(const char *in)
+    { return codec_.compress(in); }
+
+    virtual const char *compressPoints(const char *in, size_t count)
+    { return codec_.compressPoints(in, count); }
+
+    virtual void done()
+    { codec_.done(); }
+
+    virtual void reset()
+    { codec_.reset(); }
+
+private:
+    TStream stream_;
+    typename point_codec<PDRF, EbCount>::template compressor<Stream> codec_;
+};
+
+template <typename TStream, int PDRF, int EbCount>
+class codec_decompressor final : public las_decompressor
+{
+    using Stream = typename std::remove_reference<TStream>::type;
+
+public:
+    codec_decompressor(TStream stream, size_t ebCount) : stream_(stream),
+        codec_(stream_, ebCount)
+    {}
+
+    virtual char *decompress(char *out)
+    { return codec_.decompress(out); }
+
+    virtual char *decompressPoints(char *out, size_t count)
+    { return codec_.decompressPoints(out, count); }
+
+    virtual void decompressColumns(const point_columns& cols, size_t count)
+    { codec_.decompressColumns(cols, count); }
+
+    virtual void reset()
+    { codec_.reset(); }
+
+private:
+    TStream stream_;
+    typename point_codec<PDRF, EbCount>::template decompressor<Stream> codec_;
+};
+
+template <typename TStream, int PDRF>
+las_compressor::ptr codecCompressor(TStream stream, size_t ebCount)
+{
+    if (ebCount == 0)
+        return las_compressor::ptr(new codec_compressor<TStream, PDRF, 0>(stream, 0));
+    return las_compressor::ptr(
+        new codec_compressor<TStream, PDRF, VariableEbCount>(stream, ebCount));
+}
+
+template <typename TStream, int PDRF>
+las_decompressor::ptr codecDecompressor(TStream stream, size_t ebCount)
+{
+    if (ebCount == 0)
+        return las_decompressor::ptr(new codec_decompressor<TStream, PDRF, 0>(stream, 0));
+    return las_decompressor::ptr(
+        new codec_decompressor<TStream, PDRF, VariableEbCount>(stream, ebCount));
+}
+
+} // namespace detail
+
+// Build a compressor for point formats 0 through 3 that writes to 'stream' through a
+// point_codec. Returns null for other formats.
+template <typename TStream>
+las_compressor::ptr build_codec_compressor(TStream stream, int format, size_t ebCount)
+{
+    switch (format)
+    {
+    case 0:
+        return detail::codecCompressor<TStream, 0>(stream, ebCount);
+    case 1:
+        return detail::codecCompressor<TStream, 1>(stream, ebCount);
+    case 2:
+        return detail::codecCompressor<TStream, 2>(stream, ebCount);
+    case 3:
+        return detail::codecCompressor<TStream, 3>(stream, ebCount);
+    }
+    return las_compressor::ptr();
+}
+
+// Build a decompressor for point formats 0 through 3 that reads from 'stream' through a
+// point_codec. Returns null for other formats.
+template <typename TStream>
+las_decompressor::ptr build_codec_decompressor(TStream stream, int format, size_t ebCount)
+{
+    switch (format)
+    {
+    case 0:
+        return detail::codecDecompressor<TStream, 0>(stream, ebCount);
+    case 1:
+        return detail::codecDecompressor<TStream, 1>(stream, ebCount);
+    case 2:
+        return detail::codecDecompressor<TStream, 2>(stream, ebCount);
+    case 3:
+        return detail::codecDecompressor<TStream, 3>(stream, ebCount);
+    }
+    return las_decompressor::ptr();
+}
+
+} // namespace lazperf
@@ -0,0 +1,308 @@
+/******************************************************************************
+* Copyright (c) 2026, Hobu Inc., info@hobu.co
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following
+* conditions are met:
+*
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in
+*       the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of Hobu, Inc. or Flaxen Geo Consulting nor the
+*       names of its contributors may be used to endorse or promote
+*       products derived from this software without specific prior
+*       written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+* COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+* OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+* AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+* OF SUCH DAMAGE.
+****************************************************************************/
+
+
+#include <algorithm>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "range_source.hpp"
+#include "excepts.hpp"
+
+namespace lazperf
+{
+
+range_source::~range_source()
+{}
+
+// file_source
+
+#ifdef _WIN32
+
+struct file_source::Private
+{
+    HANDLE file;
+    uint64_t size;
+};
+
+file_source::file_source(const std::string& filename) : p_(new Private)
+{
+    p_->file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (p_->file == INVALID_HANDLE_VALUE)
+        throw error("Couldn't open '" + filename + "'.");
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(p_->file, &fileSize))
+    {
+        CloseHandle(p_->file);
+        throw error("Couldn't get the size of '" + filename + "'.");
+    }
+    p_->size = (uint64_t)fileSize.QuadPart;
+}
+
+file_source::~file_source()
+{
+    CloseHandle(p_->file);
+}
+
+void file_source::read(uint64_t offset, size_t len, char *dst)
+{
+    while (len)
+    {
+        // Reads through an OVERLAPPED structure don't use or change the file position.
+        OVERLAPPED ov {};
+        ov.Offset = (DWORD)offset;
+        ov.OffsetHigh = (DWORD)(offset >> 32);
+        DWORD count = (DWORD)(std::min)(len, (size_t)(1 << 30));
+        DWORD actual;
+        if (!ReadFile(p_->file, dst, count, &actual, &ov) || actual == 0)
+            throw error("Couldn't read " + std::to_string(len) + " bytes at offset " +
+                std::to_string(offset) + ".");
+        offset += actual;
+        dst += actual;
+        len -= actual;
+    }
+}
+
+#else
+
+struct file_source::Private
+{
+    int fd;
+    uint64_t size;
+};
+
+file_source::file_source(const std::string& filename) : p_(new Private)
+{
+    p_->fd = ::open(filename.c_str(), O_RDONLY);
+    if (p_->fd < 0)
+        throw error("Couldn't open '" + filename + "'.");
+    struct stat st;
+    if (fstat(p_->fd, &st) != 0)
+    {
+        ::close(p_->fd);
+        throw error("Couldn't get the size of '" + filename + "'.");
+    }
+    p_->size = (uint64_t)st.st_size;
+}
+
+file_source::~file_source()
+{
+    ::close(p_->fd);
+}
+
+void file_source::read(uint64_t offset, size_t len, char *dst)
+{
+    while (len)
+    {
+        ssize_t actual = ::pread(p_->fd, dst, len, (off_t)offset);
+        if (actual < 0 && errno == EINTR)
+            continue;
+        if (actual <= 0)
+            throw error("Couldn't read " + std::to_string(len) + " bytes at offset " +
+                std::to_string(offset) + ".");
+        offset += actual;
+        dst += actual;
+        len -= actual;
+    }
+}
+
+#endif
+
+uint64_t file_source::size() const
+{
+    return p_->size;
+}
+
+// mem_source
+
+mem_source::mem_source(const char *data, size_t size) : data_(data), size_(size)
+{}
+
+uint64_t mem_source::size() const
+{
+    return size_;
+}
+
+void mem_source::read(uint64_t offset, size_t len, char *dst)
+{
+    if (offset > size_ || len > size_ - offset)
+        throw error("Couldn't read " + std::to_string(len) + " bytes at offset " +
+            std::to_string(offset) + ".");
+    memcpy(dst, data_ + offset, len);
+}
+
+// cached_source
+
+struct cached_source::Private
+{
+    using Block = std::shared_ptr<std::vector<char>>;
+    // Most recently used first.
+    using Lru = std::list<std::pair<uint64_t, Block>>;
+
+    Private(std::shared_ptr<range_source> source, size_t blockSize, size_t blockCount) :
+        source(source), block_size(blockSize), block_count(blockCount)
+    {}
+
+    Block find(uint64_t block);
+    void insert(uint64_t block, Block data);
+    void fetch(uint64_t first, uint64_t last, std::vector<Block>& blocks);
+
+    std::shared_ptr<range_source> source;
+    size_t block_size;
+    size_t block_count;
+    std::mutex mutex;
+    Lru lru;
+    std::unordered_map<uint64_t, Lru::iterator> blocks;
+};
+
+cached_source::Private::Block cached_source::Private::find(uint64_t block)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = blocks.find(block);
+    if (it == blocks.end())
+        return Block();
+    lru.splice(lru.begin(), lru, it->second);
+    return it->second->second;
+}
+
+void cached_source::Private::insert(uint64_t block, Block data)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    // Another thread may have fetched the block at the same time.
+    if (blocks.count(block))
+        return;
+    lru.emplace_front(block, data);
+    blocks[block] = lru.begin();
+    if (lru.size() > block_count)
+    {
+        blocks.erase(lru.back().first);
+        lru.pop_back();
+    }
+}
+
+// Fetch blocks [first, last] from the source with a single read.
+void cached_source::Private::fetch(uint64_t first, uint64_t last, std::vector<Block>& out)
+{
+    const uint64_t offset = first * block_size;
+    const size_t len = (size_t)((std::min)((last + 1) * block_size, source->size()) - offset);
+    std::vector<char> buf(len);
+    source->read(offset, len, buf.data());
+    for (uint64_t b = first; b <= last; ++b)
+    {
+        const size_t pos = (size_t)((b - first) * block_size);
+        Block data(new std::vector<char>(buf.begin() + pos,
+            buf.begin() + (std::min)(pos + block_size, len)));
+        insert(b, data);
+        out.push_back(data);
+    }
+}
+
+cached_source::cached_source(std::shared_ptr<range_source> source, size_t blockSize,
+        size_t blockCount) :
+    p_(new Private(source, (std::max)(blockSize, (size_t)1), (std::max)(blockCount, (size_t)1)))
+{}
+
+cached_source::~cached_source()
+{}
+
+uint64_t cached_source::size() const
+{
+    return p_->source->size();
+}
+
+void cached_source::read(uint64_t offset, size_t len, char *dst)
+{
+    if (len == 0)
+        return;
+    if (offset > size() || len > size() - offset)
+        throw error("Couldn't read " + std::to_string(len) + " bytes at offset " +
+            std::to_string(offset) + ".");
+    if (len > p_->block_size * p_->block_count / 2)
+    {
+        p_->source->read(offset, len, dst);
+        return;
+    }
+
+    const uint64_t first = offset / p_->block_size;
+    const uint64_t last = (offset + len - 1) / p_->block_size;
+
+    // Gather the blocks, reading runs of missing blocks together.
+    std::vector<Private::Block> blocks;
+    uint64_t missing = last + 1;
+    for (uint64_t b = first; b <= last; ++b)
+    {
+        Private::Block block = p_->find(b);
+        if (!block)
+        {
+            if (missing > last)
+                missing = b;
+            continue;
+        }
+        if (missing <= last)
+        {
+            p_->fetch(missing, b - 1, blocks);
+            missing = last + 1;
+        }
+        blocks.push_back(block);
+    }
+    if (missing <= last)
+        p_->fetch(missing, last, blocks);
+
+    size_t pos = (size_t)(offset - first * p_->block_size);
+    for (const Private::Block& block : blocks)
+    {
+        size_t count = (std::min)(len, block->size() - pos);
+        memcpy(dst, block->data() + pos, count);
+        dst += count;
+        len -= count;
+        pos = 0;
+    }
+}
+
+} // namespace lazperf
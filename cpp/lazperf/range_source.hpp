@@ -0,0 +1,111 @@
+/******************************************************************************
+* Copyright (c) 2026, Hobu Inc., info@hobu.co
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following
+* conditions are met:
+*
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in
+*       the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of Hobu, Inc. or Flaxen Geo Consulting nor the
+*       names of its contributors may be used to endorse or promote
+*       products derived from this software without specific prior
+*       written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+* COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+* OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+* AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+* OF SUCH DAMAGE.
+****************************************************************************/
+
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "lazperf_base.hpp"
+
+namespace lazperf
+{
+
+#pragma warning (push)
+#pragma warning (disable: 4251)
+// A source of bytes that can be read at any offset, such as a file or an object in an
+// object store. read() may be called from several threads at once.
+class LAZPERF_EXPORT range_source
+{
+public:
+    virtual ~range_source();
+
+    virtual uint64_t size() const = 0;
+    // Read 'len' bytes at 'offset' into 'dst'. Throws if the bytes can't all be read.
+    virtual void read(uint64_t offset, size_t len, char *dst) = 0;
+};
+
+// A file read with positional reads, so readers don't share a file position.
+class LAZPERF_EXPORT file_source : public range_source
+{
+    struct Private;
+
+public:
+    file_source(const std::string& filename);
+    virtual ~file_source();
+
+    virtual uint64_t size() const;
+    virtual void read(uint64_t offset, size_t len, char *dst);
+
+private:
+    std::unique_ptr<Private> p_;
+};
+
+// Bytes in memory. The memory must remain valid for the life of the source.
+class LAZPERF_EXPORT mem_source : public range_source
+{
+public:
+    mem_source(const char *data, size_t size);
+
+    virtual uint64_t size() const;
+    virtual void read(uint64_t offset, size_t len, char *dst);
+
+private:
+    const char *data_;
+    size_t size_;
+};
+
+// Caches the most recently used blocks of another source. The blocks of a read that
+// aren't cached are fetched with one read of the other source for each run of adjacent
+// blocks. Reads larger than half the cache bypass it.
+class LAZPERF_EXPORT cached_source : public range_source
+{
+    struct Private;
+
+public:
+    cached_source(std::shared_ptr<range_source> source, size_t blockSize = 1 << 16,
+        size_t blockCount = 64);
+    virtual ~cached_source();
+
+    virtual uint64_t size() const;
+    virtual void read(uint64_t offset, size_t len, char *dst);
+
+private:
+    std::unique_ptr<Private> p_;
+};
+#pragma warning (pop)
+
+} // namespace lazperf
@@ -28,15 +28,38 @@
 ===============================================================================
 */
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <deque>
+#include <future>
+#include <map>
+#include <mutex>
+#include <set>
 #include <string>
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "readers.hpp"
 #include "charbuf.hpp"
+#include "chunk_index.hpp"
 #include "decoder.hpp"
 #include "decompressor.hpp"
 #include "excepts.hpp"
 #include "filestream.hpp"
+#include "las.hpp"
+#include "scale.hpp"
 #include "streams.hpp"
+#include "threadpool.hpp"
 #include "vlr.hpp"
 
 namespace lazperf
@@ -44,14 +67,201 @@ namespace lazperf
 namespace reader
 {
 
+namespace
+{
+
+// A streambuf that reads a range_source in blocks.
+class sourcebuf : public std::streambuf
+{
+public:
+    sourcebuf(range_source& source) : source_(source), pos_(0), buf_(1 << 16)
+    { setg(buf_.data(), buf_.data(), buf_.data()); }
+
+protected:
+    int_type underflow() override
+    {
+        pos_ += egptr() - eback();
+        if (pos_ >= source_.size())
+            return traits_type::eof();
+        size_t count = (size_t)(std::min)((uint64_t)buf_.size(), source_.size() - pos_);
+        source_.read(pos_, count, buf_.data());
+        setg(buf_.data(), buf_.data(), buf_.data() + count);
+        return traits_type::to_int_type(*gptr());
+    }
+
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+        std::ios_base::openmode which) override
+    {
+        if (dir == std::ios_base::cur)
+            off += pos_ + (gptr() - eback());
+        else if (dir == std::ios_base::end)
+            off += source_.size();
+        return seekpos(off, which);
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode) override
+    {
+        uint64_t p = (uint64_t)(off_type)pos;
+        if ((off_type)pos < 0 || p > source_.size())
+            return pos_type(off_type(-1));
+        // Stay in the current buffer if we can.
+        if (p >= pos_ && p <= pos_ + (egptr() - eback()))
+            setg(eback(), eback() + (p - pos_), egptr());
+        else
+        {
+            pos_ = p;
+            setg(buf_.data(), buf_.data(), buf_.data());
+        }
+        return pos;
+    }
+
+private:
+    range_source& source_;
+    uint64_t pos_;  // Position of the start of the buffer.
+    std::vector<char> buf_;
+};
+
+// Position of the GPS time in a point record, or -1 if the format has no GPS time.
+int gpsTimeOffset(int format)
+{
+    if (format == 1 || format == 3)
+        return (int)sizeof(las::point10);
+    if (format >= 6)
+        return 22;
+    return -1;
+}
+
+// Copy the fields of packed point records to columns.
+void scatter(const char *in, size_t count, int format, size_t ebCount,
+    const point_columns& cols)
+{
+    const size_t pointLen = baseCount(format) + ebCount;
+    for (size_t i = 0; i < count; ++i, in += pointLen)
+    {
+        const char *pos = in;
+        las::rgb rgb;
+        uint16_t nir = 0;
+        if (format <= 5)
+        {
+            detail::Point10Base::store(las::point10(pos), cols, i);
+            pos += sizeof(las::point10);
+            if (format == 1 || format == 3)
+            {
+                if (cols.gps_time)
+                    cols.gps_time.put(i, utils::unpack<double>(pos));
+                pos += sizeof(las::gpstime);
+            }
+            if (format == 2 || format == 3)
+            {
+                rgb.unpack(pos);
+                pos += sizeof(las::rgb);
+            }
+        }
+        else
+        {
+            detail::Point14Decompressor::store(las::point14(pos), cols, i);
+            pos += sizeof(las::point14);
+            if (format == 7 || format == 8)
+            {
+                rgb.unpack(pos);
+                pos += sizeof(las::rgb);
+            }
+            if (format == 8)
+            {
+                nir = utils::unpack<uint16_t>(pos);
+                pos += sizeof(las::nir14);
+            }
+        }
+        if (format == 2 || format == 3 || format == 7 || format == 8)
+        {
+            if (cols.red)
+                cols.red.put(i, rgb.r);
+            if (cols.green)
+                cols.green.put(i, rgb.g);
+            if (cols.blue)
+                cols.blue.put(i, rgb.b);
+        }
+        if (format == 8 && cols.nir)
+            cols.nir.put(i, nir);
+        if (ebCount && cols.extra_bytes)
+            std::copy(pos, pos + ebCount, cols.extra_bytes.at(i));
+    }
+}
+
+// Decompressors for decoding chunks on worker threads. A decompressor that has finished
+// a chunk is reset for the next one rather than being rebuilt.
+class decompressor_cache
+{
+public:
+    decompressor_cache(int format, int ebCount, uint32_t layers) : format_(format),
+        ebCount_(ebCount), layers_(layers)
+    {}
+
+    std::unique_ptr<chunk_decompressor> get(const char *data, size_t size)
+    {
+        std::unique_ptr<chunk_decompressor> d;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (free_.size())
+            {
+                d = std::move(free_.back());
+                free_.pop_back();
+            }
+        }
+        if (d)
+            d->reset(data, size);
+        else
+            d.reset(new chunk_decompressor(format_, ebCount_, data, size, layers_));
+        return d;
+    }
+
+    void release(std::unique_ptr<chunk_decompressor> d)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_.push_back(std::move(d));
+    }
+
+private:
+    int format_;
+    int ebCount_;
+    uint32_t layers_;
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<chunk_decompressor>> free_;
+};
+
+} // unnamed namespace
+
 struct basic_file::Private
 {
-    Private() : head12(head14), head13(head14), compressed(false), current_chunk(nullptr)
+    Private() : mem_size(0), mem_span(nullptr, 0), head12(head14), head13(head14),
+        compressed(false), current_chunk(nullptr), chunks_end(0), query_min_time(0),
+        query_max_time(0), point_num(0), layers(layer::All), depth(0), next_chunk(0),
+        decoded_pos(0), generation(new std::atomic<uint64_t>(0))
     {}
 
     bool open(std::istream& f);
+    bool open(std::istream& f, std::shared_ptr<const char> mem, size_t memSize);
+    bool open(std::istream& f, std::shared_ptr<range_source> source);
+    InputCb chunkInput(size_t chunkIndex, bool reposition);
     uint64_t firstChunkOffset() const;
     void readPoint(char *out);
+    void setThreads(size_t threads, size_t depth);
+    void setLayers(uint32_t layers);
+    uint64_t chunkRange(size_t chunkIndex, size_t& size) const;
+    std::shared_ptr<const char> chunkData(size_t chunkIndex, size_t& size);
+    void dispatchChunks();
+    const chunk_index& chunkIndex();
+    bool loadIndex(const std::string& filename);
+    size_t queryPoints(const box& region, double minTime, double maxTime, char *out,
+        size_t count);
+    size_t readPoints(char *out, size_t count);
+    size_t readColumns(point_columns cols, size_t count);
+    void nextChunk();
+    void startChunk(size_t chunkIndex, bool reposition);
+    void readUncompressed(char *out, uint64_t pointIndex, size_t count);
+    void readPointsParallel(char *out, size_t count);
+    void seek(uint64_t pointIndex);
+    void readChunk(size_t chunkIndex, char *out);
     bool loadHeader();
     uint64_t pointCount() const;
     void parseVLRs();
@@ -62,6 +272,14 @@ struct basic_file::Private
 
     std::istream *f;
     std::unique_ptr<InFileStream> stream;
+    // When the entire file is in memory, points are decoded directly from it rather than
+    // being read through 'stream'.
+    std::shared_ptr<const char> mem;
+    size_t mem_size;
+    SpanStream mem_span;  // The data of the current chunk, when in memory.
+    // When reading from a range source, chunks are read from it directly on the decoding
+    // threads.
+    std::shared_ptr<range_source> source;
     header12& head12;
     header13& head13;
     header14 head14;
@@ -72,7 +290,30 @@ struct basic_file::Private
     chunk *current_chunk;
     uint32_t chunk_point_num;
     std::vector<chunk> chunks;
+    std::vector<uint64_t> chunk_starts;  // Index of the first point of each chunk.
+    uint64_t chunks_end;
+    chunk_index index;  // Loaded from a sidecar file or computed on first use.
+    chunk_stats_vlr stats;  // Empty unless the file has statistics matching its chunks.
+    // Chunks that may have points for the last query.
+    box query_region;
+    double query_min_time;
+    double query_max_time;
+    std::vector<size_t> query_chunks;
     std::vector<vlr_index_rec> vlr_index;
+    uint64_t point_num;
+    uint32_t layers;
+
+    // Parallel decoding state. Decoded chunks are delivered in order through 'pending'.
+    std::unique_ptr<ThreadPool> pool;
+    size_t depth;
+    size_t next_chunk;
+    std::deque<std::future<std::vector<char>>> pending;
+    std::vector<char> decoded;
+    size_t decoded_pos;
+    std::shared_ptr<decompressor_cache> decompressors;
+    // Incremented when in-flight chunks are abandoned. Tasks of an older generation
+    // return without decoding.
+    std::shared_ptr<std::atomic<uint64_t>> generation;
 };
 
 struct mem_file::Private
@@ -84,6 +325,28 @@ struct mem_file::Private
     std::istream f;
 };
 
+struct mmap_file::Private
+{
+    Private(const std::string& filename);
+    void init();
+
+    size_t size;
+    char *data;
+    std::shared_ptr<const char> mem;
+    charbuf sbuf;
+    std::istream f;
+};
+
+struct source_file::Private
+{
+    Private(std::shared_ptr<range_source> source) : source(source), sbuf(*source), f(&sbuf)
+    {}
+
+    std::shared_ptr<range_source> source;
+    sourcebuf sbuf;
+    std::istream f;
+};
+
 struct named_file::Private
 {
     Private(const std::string& filename) : f(filename, std::ios::binary)
@@ -99,9 +362,38 @@ bool basic_file::Private::open(std::istream& in)
     f = &in;
     //ABELL - move to loadHeader() in order to avoid the reset on InFileStream.
     stream.reset(new InFileStream(in));
+    pdecompressor.reset();
     return loadHeader();
 }
 
+bool basic_file::Private::open(std::istream& in, std::shared_ptr<const char> mem,
+    size_t memSize)
+{
+    this->mem = mem;
+    mem_size = memSize;
+    return open(in);
+}
+
+bool basic_file::Private::open(std::istream& in, std::shared_ptr<range_source> source)
+{
+    this->source = source;
+    return open(in);
+}
+
+// Get the stream input for decoding the chunk. We only reposition if requested, as the
+// chunks are contiguous.
+InputCb basic_file::Private::chunkInput(size_t chunkIndex, bool reposition)
+{
+    const uint64_t offset = chunks[chunkIndex].offset;
+    if (reposition)
+    {
+        stream->reset();
+        f->clear();
+        f->seekg(offset);
+    }
+    return stream->cb();
+}
+
 uint64_t basic_file::Private::firstChunkOffset() const
 {
     // There is a chunk offset where the first point is supposed to be. The first
@@ -111,30 +403,592 @@ uint64_t basic_file::Private::firstChunkOffset() const
 
 void basic_file::Private::readPoint(char *out)
 {
-    if (!compressed)
-        stream->cb()(reinterpret_cast<unsigned char *>(out), head12.point_record_length);
+    point_num++;
+    if (pool)
+        readPointsParallel(out, 1);
+    else if (!compressed)
+    {
+        if (mem)
+            readUncompressed(out, point_num - 1, 1);
+        else
+            stream->cb()(reinterpret_cast<unsigned char *>(out), head12.point_record_length);
+    }
 
     // read the next point
     else
     {
         if (!pdecompressor || chunk_point_num == current_chunk->count)
+            nextChunk();
+
+        pdecompressor->decompress(out);
+        chunk_point_num++;
+    }
+}
+
+size_t basic_file::Private::readPoints(char *out, size_t count)
+{
+    uint64_t remaining = point_num < pointCount() ? pointCount() - point_num : 0;
+    if (count > remaining)
+        count = (size_t)remaining;
+    point_num += count;
+
+    if (pool)
+        readPointsParallel(out, count);
+    else if (!compressed)
+    {
+        if (mem)
+            readUncompressed(out, point_num - count, count);
+        else
+            stream->cb()(reinterpret_cast<unsigned char *>(out),
+                count * head12.point_record_length);
+    }
+    else
+    {
+        // Decode as much of each chunk as we can with a single call.
+        size_t left = count;
+        while (left)
         {
-            pdecompressor = build_las_decompressor(stream->cb(), head12.point_format_id,
-                head12.ebCount());
+            if (!pdecompressor || chunk_point_num == current_chunk->count)
+                nextChunk();
 
-            // reset chunk state
-            if (current_chunk == nullptr)
-                current_chunk = chunks.data();
-            else
-                current_chunk++;
-            chunk_point_num = 0;
+            size_t n = (std::min)(left, (size_t)(current_chunk->count - chunk_point_num));
+            out = pdecompressor->decompressPoints(out, n);
+            chunk_point_num += (uint32_t)n;
+            left -= n;
+        }
+    }
+    return count;
+}
+
+size_t basic_file::Private::readColumns(point_columns cols, size_t count)
+{
+    uint64_t remaining = point_num < pointCount() ? pointCount() - point_num : 0;
+    if (count > remaining)
+        count = (size_t)remaining;
+
+    // Points are read a block at a time. Scaled coordinates are computed from raw
+    // values decoded to a block of scratch space, which stays in cache.
+    const size_t BlockSize = 1024;
+    const bool world = cols.world_x || cols.world_y || cols.world_z;
+    const bool local = cols.local_x || cols.local_y || cols.local_z;
+    std::vector<int32_t> xyz;
+    if (world || local)
+        xyz.resize(3 * (std::min)(count, BlockSize));
+    std::vector<char> buf;
+    if (!compressed || pool)
+        buf.resize((std::min)(count, BlockSize) * head12.point_record_length);
+
+    size_t left = count;
+    while (left)
+    {
+        size_t n = (std::min)(left, BlockSize);
+        point_columns block(cols);
+        if (xyz.size())
+        {
+            block.x = column<int32_t>(xyz.data());
+            block.y = column<int32_t>(xyz.data() + n);
+            block.z = column<int32_t>(xyz.data() + 2 * n);
         }
 
-        pdecompressor->decompress(out);
+        if (buf.size())
+        {
+            // Points that don't come from a decompressor on this thread are read as
+            // records and copied to the columns.
+            readPoints(buf.data(), n);
+            scatter(buf.data(), n, head12.point_format_id, head12.ebCount(), block);
+        }
+        else
+        {
+            point_num += n;
+            size_t done = 0;
+            while (done < n)
+            {
+                if (!pdecompressor || chunk_point_num == current_chunk->count)
+                    nextChunk();
+
+                size_t cnt = (std::min)(n - done,
+                    (size_t)(current_chunk->count - chunk_point_num));
+                pdecompressor->decompressColumns(block, cnt);
+                block.advance(cnt);
+                chunk_point_num += (uint32_t)cnt;
+                done += cnt;
+            }
+        }
+
+        if (xyz.size())
+        {
+            const column<int32_t> *raw[] = { &cols.x, &cols.y, &cols.z };
+            const column<double> *worlds[] = { &cols.world_x, &cols.world_y, &cols.world_z };
+            const column<float> *locals[] = { &cols.local_x, &cols.local_y, &cols.local_z };
+            const double scales[] = { head12.scale.x, head12.scale.y, head12.scale.z };
+            const double offsets[] = { head12.offset.x, head12.offset.y, head12.offset.z };
+            for (int d = 0; d < 3; ++d)
+            {
+                const int32_t *in = xyz.data() + d * n;
+                if (*raw[d])
+                    for (size_t i = 0; i < n; ++i)
+                        raw[d]->put(i, in[i]);
+                if (*worlds[d])
+                    scale::toDouble(in, n, scales[d], offsets[d],
+                        worlds[d]->at(0), worlds[d]->stride);
+                if (*locals[d])
+                    scale::toFloat(in, n, scales[d], offsets[d] - cols.origin[d],
+                        locals[d]->at(0), locals[d]->stride);
+            }
+        }
+        cols.advance(n);
+        left -= n;
+    }
+    return count;
+}
+
+void basic_file::Private::nextChunk()
+{
+    // reset chunk state
+    if (current_chunk == nullptr)
+        current_chunk = chunks.data();
+    else
+        current_chunk++;
+    if (current_chunk == chunks.data() + chunks.size())
+        throw error("Attempt to read past the last point.");
+    chunk_point_num = 0;
+    startChunk(current_chunk - chunks.data(), false);
+}
+
+// Prepare the decompressor for a chunk. Once built, the decompressor is reset for each
+// chunk, which is much cheaper than building a new one. The input of the decompressor
+// doesn't change from chunk to chunk.
+void basic_file::Private::startChunk(size_t chunkIndex, bool reposition)
+{
+    // A chunk in memory is decoded directly from its bytes, as on the decoding threads.
+    // Reading past the end of the chunk yields zeros.
+    if (mem)
+    {
+        size_t size;
+        std::shared_ptr<const char> data = chunkData(chunkIndex, size);
+        mem_span = SpanStream(reinterpret_cast<const unsigned char *>(data.get()), size);
+        if (pdecompressor)
+            pdecompressor->reset();
+        else
+        {
+            pdecompressor = build_las_decompressor(mem_span, head12.point_format_id,
+                head12.ebCount(), layers);
+        }
+        return;
+    }
+
+    InputCb cb = chunkInput(chunkIndex, reposition);
+    if (pdecompressor)
+        pdecompressor->reset();
+    else
+        pdecompressor = build_las_decompressor(cb, head12.point_format_id, head12.ebCount(),
+            layers);
+}
+
+void basic_file::Private::readUncompressed(char *out, uint64_t pointIndex, size_t count)
+{
+    const size_t len = count * head12.point_record_length;
+    const uint64_t offset = head12.point_offset + pointIndex * head12.point_record_length;
+    if (offset + len > mem_size)
+        throw error("Unexpected end of file.");
+    std::copy(mem.get() + offset, mem.get() + offset + len, out);
+}
+
+void basic_file::Private::setThreads(size_t threads, size_t depth)
+{
+    if (!compressed)
+        return;
+
+    pool.reset();
+    if (threads)
+    {
+        pool.reset(new ThreadPool(threads));
+        this->depth = depth ? depth : 2 * threads;
+    }
+    // Switching modes requires that the new mode pick up where the old one left off.
+    if (point_num)
+        seek(point_num);
+}
+
+void basic_file::Private::setLayers(uint32_t layers)
+{
+    this->layers = layers;
+    // Rebuild the decompressor with the new layers.
+    pdecompressor.reset();
+    decompressors.reset();
+    if (point_num || current_chunk)
+        seek(point_num);
+}
+
+void basic_file::Private::seek(uint64_t pointIndex)
+{
+    if (pointIndex > pointCount())
+        throw error("Attempt to seek past the last point.");
+
+    point_num = pointIndex;
+    stream->reset();
+    f->clear();
+    if (!compressed)
+    {
+        f->seekg(head12.point_offset + pointIndex * head12.point_record_length);
+        return;
+    }
+    if (chunks.empty())
+        return;
+
+    // Find the chunk containing the point and the number of points to skip in it.
+    size_t chunkIndex = std::upper_bound(chunk_starts.begin(), chunk_starts.end(), pointIndex) -
+        chunk_starts.begin() - 1;
+    uint64_t skip = pointIndex - chunk_starts[chunkIndex];
+    std::vector<char> scratch(head12.point_record_length);
+
+    if (pool)
+    {
+        // Abandon anything in flight. Queued tasks see the new generation and return
+        // without decoding. A task that's already decoding stops at the next block of
+        // points. Either way, the results are discarded.
+        (*generation)++;
+        pending.clear();
+        decoded.clear();
+        decoded_pos = 0;
+        next_chunk = chunkIndex;
+        if (skip)
+        {
+            readPointsParallel(scratch.data(), 1);
+            decoded_pos = skip * head12.point_record_length;
+        }
+        return;
+    }
+
+    startChunk(chunkIndex, true);
+    current_chunk = chunks.data() + chunkIndex;
+    chunk_point_num = 0;
+    while (skip--)
+    {
+        pdecompressor->decompress(scratch.data());
         chunk_point_num++;
     }
 }
 
+void basic_file::Private::readChunk(size_t chunkIndex, char *out)
+{
+    if (!compressed)
+        throw error("Can't read chunks from an uncompressed file.");
+    if (chunkIndex >= chunks.size())
+        throw error("Invalid chunk index " + std::to_string(chunkIndex) + ".");
+
+    seek(chunk_starts[chunkIndex]);
+    readPoints(out, chunks[chunkIndex].count);
+}
+
+// Get the offset and size of the compressed data of a chunk.
+uint64_t basic_file::Private::chunkRange(size_t chunkIndex, size_t& size) const
+{
+    const chunk& c = chunks[chunkIndex];
+    uint64_t end = chunkIndex + 1 < chunks.size() ? chunks[chunkIndex + 1].offset : chunks_end;
+    if (end < c.offset)
+        throw error("Invalid chunk table.");
+
+    size = (size_t)(end - c.offset);
+    return c.offset;
+}
+
+// Get the compressed data of a chunk for decoding on another thread. If the file is in
+// memory, the data is referenced directly. Otherwise we read the chunk into a buffer.
+// Holding a reference to the memory/buffer keeps it alive until the worker is done with it.
+std::shared_ptr<const char> basic_file::Private::chunkData(size_t chunkIndex, size_t& size)
+{
+    const chunk& c = chunks[chunkIndex];
+    uint64_t end = chunkRange(chunkIndex, size) + size;
+    if (mem)
+    {
+        if (end > mem_size)
+            throw error("Invalid chunk table.");
+        return std::shared_ptr<const char>(mem, mem.get() + c.offset);
+    }
+
+    std::shared_ptr<char> buf(new char[size], std::default_delete<char[]>());
+    if (source)
+    {
+        source->read(c.offset, size, buf.get());
+        return buf;
+    }
+    stream->stop();
+    f->clear();
+    f->seekg(c.offset);
+    f->read(buf.get(), size);
+    if (!f->good())
+        throw error("Couldn't read chunk " + std::to_string(chunkIndex) + ".");
+    return buf;
+}
+
+// Read the raw bytes of chunks on this thread and hand them to the pool for decoding
+// until we have 'depth' chunks in flight. Chunks from a range source are read by the
+// workers.
+void basic_file::Private::dispatchChunks()
+{
+    const int format = head12.point_format_id;
+    const int ebCount = head12.ebCount();
+    const size_t pointSize = head12.point_record_length;
+    const uint32_t layers = this->layers;
+    std::shared_ptr<range_source> source = this->source;
+    if (!decompressors)
+        decompressors.reset(new decompressor_cache(format, ebCount, layers));
+    std::shared_ptr<decompressor_cache> cache = decompressors;
+    std::shared_ptr<std::atomic<uint64_t>> generation = this->generation;
+    const uint64_t gen = *generation;
+
+    while (pending.size() < depth && next_chunk < chunks.size())
+    {
+        size_t inSize;
+        uint64_t offset = 0;
+        std::shared_ptr<const char> in;
+        if (source)
+            offset = chunkRange(next_chunk, inSize);
+        else
+            in = chunkData(next_chunk, inSize);
+        const size_t count = chunks[next_chunk].count;
+        pending.push_back(pool->async<std::vector<char>>([=]()
+        {
+            const size_t BlockSize = 4096;
+
+            std::vector<char> out;
+            if (*generation != gen)
+                return out;
+            std::shared_ptr<const char> data(in);
+            if (!data)
+            {
+                std::shared_ptr<char> buf(new char[inSize], std::default_delete<char[]>());
+                source->read(offset, inSize, buf.get());
+                data = buf;
+            }
+            out.resize(count * pointSize);
+            std::unique_ptr<chunk_decompressor> d = cache->get(data.get(), inSize);
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (i % BlockSize == 0 && *generation != gen)
+                    break;
+                d->decompress(out.data() + i * pointSize);
+            }
+            cache->release(std::move(d));
+            return out;
+        }));
+        next_chunk++;
+    }
+}
+
+// Decode the XYZ and GPS time of every chunk to find its extents. Chunks are decoded on
+// the reader's thread pool if there is one, or on a temporary pool otherwise. The index
+// is kept for reuse.
+const chunk_index& basic_file::Private::chunkIndex()
+{
+    if (!index.empty() || chunks.empty())
+        return index;
+
+    // Chunk statistics written with the file have the extents, so nothing need be decoded.
+    if (stats.chunks.size())
+    {
+        std::vector<box> bounds;
+        std::vector<double> minTime;
+        std::vector<double> maxTime;
+        for (const chunk_stats_vlr::entry& e : stats.chunks)
+        {
+            bounds.push_back(e.bounds);
+            minTime.push_back(e.min_time);
+            maxTime.push_back(e.max_time);
+        }
+        index.build(bounds, minTime, maxTime, pointCount(), chunks_end);
+        return index;
+    }
+
+    std::unique_ptr<ThreadPool> tempPool;
+    ThreadPool *p = pool.get();
+    if (!p)
+    {
+        tempPool.reset(new ThreadPool((std::max)(std::thread::hardware_concurrency(), 1u)));
+        p = tempPool.get();
+    }
+
+    struct Extent
+    {
+        box bounds;
+        double minTime;
+        double maxTime;
+    };
+
+    const int format = head12.point_format_id;
+    const int ebCount = head12.ebCount();
+    const size_t pointSize = head12.point_record_length;
+    const int timePos = gpsTimeOffset(format);
+    const vector3 scale = head12.scale;
+    const vector3 offset = head12.offset;
+    std::vector<box> bounds;
+    std::vector<double> minTime;
+    std::vector<double> maxTime;
+    std::deque<std::future<Extent>> inFlight;
+    // X and Y are always decoded, so for formats 6-8 only Z and GPS time need to be
+    // selected.
+    std::shared_ptr<decompressor_cache> cache(
+        new decompressor_cache(format, ebCount, layer::Z | layer::GpsTime));
+    auto finishOne = [&]()
+    {
+        Extent e = inFlight.front().get();
+        inFlight.pop_front();
+        bounds.push_back(e.bounds);
+        minTime.push_back(e.minTime);
+        maxTime.push_back(e.maxTime);
+    };
+
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        // Limit the number of chunks in memory at once.
+        if (inFlight.size() >= 2 * p->numThreads())
+            finishOne();
+
+        size_t inSize;
+        std::shared_ptr<const char> in = chunkData(i, inSize);
+        const size_t count = chunks[i].count;
+        inFlight.push_back(p->async<Extent>([=]()
+        {
+            std::unique_ptr<chunk_decompressor> d = cache->get(in.get(), inSize);
+            std::vector<char> buf(pointSize);
+            Extent e { box(), (std::numeric_limits<double>::max)(),
+                (std::numeric_limits<double>::lowest)() };
+            for (size_t j = 0; j < count; ++j)
+            {
+                d->decompress(buf.data());
+                e.bounds.grow(utils::unpack<int32_t>(buf.data()),
+                    utils::unpack<int32_t>(buf.data() + 4),
+                    utils::unpack<int32_t>(buf.data() + 8));
+                double t = timePos < 0 ? 0 : utils::unpack<double>(buf.data() + timePos);
+                e.minTime = (std::min)(e.minTime, t);
+                e.maxTime = (std::max)(e.maxTime, t);
+            }
+            cache->release(std::move(d));
+            box& b = e.bounds;
+            if (!b.empty())
+                b = box(vector3(b.min.x * scale.x + offset.x, b.min.y * scale.y + offset.y,
+                        b.min.z * scale.z + offset.z),
+                    vector3(b.max.x * scale.x + offset.x, b.max.y * scale.y + offset.y,
+                        b.max.z * scale.z + offset.z));
+            return e;
+        }));
+    }
+    while (inFlight.size())
+        finishOne();
+    index.build(bounds, minTime, maxTime, pointCount(), chunks_end);
+
+    // Reading the chunks moved the file position out from under sequential decoding.
+    if (!mem && !pool)
+        seek(point_num);
+    return index;
+}
+
+// Use the index in a sidecar file if it matches the points of this file.
+bool basic_file::Private::loadIndex(const std::string& filename)
+{
+    chunk_index idx;
+    if (!compressed || !idx.read(filename))
+        return false;
+    if (idx.point_count != pointCount() || idx.data_end != chunks_end ||
+            idx.bounds.size() != chunks.size())
+        return false;
+    index = idx;
+    query_chunks.clear();
+    query_region = box();
+    return true;
+}
+
+size_t basic_file::Private::queryPoints(const box& region, double minTime, double maxTime,
+    char *out, size_t count)
+{
+    const size_t pointSize = head12.point_record_length;
+    const int timePos = gpsTimeOffset(head12.point_format_id);
+    const vector3& scale = head12.scale;
+    const vector3& offset = head12.offset;
+    const size_t BlockSize = 1024;
+    std::vector<char> buf;
+
+    const bool pruning = compressed && chunks.size();
+    if (pruning && (query_region.min != region.min || query_region.max != region.max ||
+            query_min_time != minTime || query_max_time != maxTime))
+    {
+        query_chunks = chunkIndex().query(region, minTime, maxTime);
+        query_region = region;
+        query_min_time = minTime;
+        query_max_time = maxTime;
+    }
+
+    size_t found = 0;
+    while (found < count && point_num < pointCount())
+    {
+        // Find the number of points we can read before having to check for a new chunk.
+        uint64_t avail = pointCount() - point_num;
+        if (pruning)
+        {
+            size_t chunkIndex = std::upper_bound(chunk_starts.begin(), chunk_starts.end(),
+                point_num) - chunk_starts.begin() - 1;
+            auto it = std::lower_bound(query_chunks.begin(), query_chunks.end(), chunkIndex);
+            if (it == query_chunks.end())
+            {
+                seek(pointCount());
+                break;
+            }
+            if (*it != chunkIndex)
+            {
+                seek(chunk_starts[*it]);
+                continue;
+            }
+            avail = chunk_starts[chunkIndex] + chunks[chunkIndex].count - point_num;
+        }
+
+        // Each point read produces at most one point of output.
+        size_t n = (size_t)(std::min)(avail, (uint64_t)(std::min)(BlockSize, count - found));
+        buf.resize(n * pointSize);
+        readPoints(buf.data(), n);
+        for (const char *p = buf.data(); p < buf.data() + buf.size(); p += pointSize)
+        {
+            double x = utils::unpack<int32_t>(p) * scale.x + offset.x;
+            double y = utils::unpack<int32_t>(p + 4) * scale.y + offset.y;
+            double z = utils::unpack<int32_t>(p + 8) * scale.z + offset.z;
+            double t = timePos < 0 ? 0 : utils::unpack<double>(p + timePos);
+            if (region.contains(x, y, z) && t >= minTime && t <= maxTime)
+            {
+                std::copy(p, p + pointSize, out);
+                out += pointSize;
+                found++;
+            }
+        }
+    }
+    return found;
+}
+
+void basic_file::Private::readPointsParallel(char *out, size_t count)
+{
+    const size_t pointSize = head12.point_record_length;
+
+    while (count)
+    {
+        // Loop in case a chunk has no points.
+        while (decoded_pos == decoded.size())
+        {
+            dispatchChunks();
+            if (pending.empty())
+                throw error("Attempt to read past the last point.");
+            decoded = pending.front().get();
+            pending.pop_front();
+            decoded_pos = 0;
+            dispatchChunks();
+        }
+        size_t n = (std::min)(count, (decoded.size() - decoded_pos) / pointSize);
+        std::copy(decoded.data() + decoded_pos, decoded.data() + decoded_pos + n * pointSize,
+            out);
+        decoded_pos += n * pointSize;
+        out += n * pointSize;
+        count -= n;
+    }
+}
+
 bool basic_file::Private::loadHeader()
 {
     std::vector<char> buf(header14::Size);
@@ -168,7 +1022,11 @@ bool basic_file::Private::loadHeader()
     {
         validateHeader();
         parseChunkTable();
+        if (stats.chunks.size() != chunks.size())
+            stats.chunks.clear();
     }
+    else
+        stats.chunks.clear();
 
     // set the file pointer to the beginning of data to start reading
     // may have treaded past the EOL, so reset everything before we start reading
@@ -250,6 +1108,12 @@ bool basic_file::Private::extractVlr(const std::string& user_id, uint16_t record
         eb.read(*f, (uint32_t) data_length);
         return true;
     }
+    // Extract chunk statistics
+    else if (user_id == chunk_stats_vlr::UserId && record_id == chunk_stats_vlr::RecordId)
+    {
+        stats.read(*f, data_length);
+        return true;
+    }
     return false;
 }
 
@@ -262,6 +1126,7 @@ std::vector<char> basic_file::Private::vlrData(const std::string& user_id, uint1
     for (vlr_index_rec& rec : vlr_index)
         if (rec.user_id == user_id && rec.record_id == record_id)
         {
+            stream->stop();
             auto position = f->tellg();
             f->seekg(rec.byte_offset);
             data.resize(rec.data_length);
@@ -282,8 +1147,14 @@ void basic_file::Private::parseChunkTable()
     if (!f->good())
         throw error("Couldn't read chunk table.");
 
+    // A file that was written as a stream has the chunk table offset at the end.
     if (chunkoffset == -1)
-        throw error("Chunk table offset == -1 is not supported at this time");
+    {
+        f->seekg(-(std::streamoff)sizeof(chunkoffset), std::ios::end);
+        f->read((char*)&chunkoffset, sizeof(chunkoffset));
+        if (!f->good())
+            throw error("Couldn't read chunk table offset at the end of the file.");
+    }
 
     // Go to the chunk offset and read in the table
     f->seekg(chunkoffset);
@@ -363,9 +1234,17 @@ void basic_file::Private::parseChunkTable()
         chunks[i + 1].offset = offset + chunks[i].offset;
     }
 
-    // This discards the last offset, which we don't care about. The last count is
+    // This discards the last offset, which is the end of the point data. The last count is
     // never filled in.
+    chunks_end = chunks.back().offset;
     chunks.resize(chunk_table_header.chunk_count);
+
+    uint64_t start = 0;
+    for (const chunk& c : chunks)
+    {
+        chunk_starts.push_back(start);
+        start += c.count;
+    }
 }
 
 void basic_file::Private::validateHeader()
@@ -392,11 +1271,63 @@ bool basic_file::open(std::istream& f)
     return p_->open(f);
 }
 
+bool basic_file::open(std::istream& f, std::shared_ptr<const char> mem, size_t memSize)
+{
+    return p_->open(f, mem, memSize);
+}
+
+bool basic_file::open(std::istream& f, std::shared_ptr<range_source> source)
+{
+    return p_->open(f, source);
+}
+
 void basic_file::readPoint(char *out)
 {
     p_->readPoint(out);
 }
 
+size_t basic_file::readPoints(char *out, size_t count)
+{
+    return p_->readPoints(out, count);
+}
+
+size_t basic_file::queryPoints(const box& region, char *out, size_t count)
+{
+    return p_->queryPoints(region, (std::numeric_limits<double>::lowest)(),
+        (std::numeric_limits<double>::max)(), out, count);
+}
+
+size_t basic_file::queryPoints(const box& region, double minTime, double maxTime, char *out,
+    size_t count)
+{
+    return p_->queryPoints(region, minTime, maxTime, out, count);
+}
+
+const std::vector<box>& basic_file::chunkBounds()
+{
+    return p_->chunkIndex().bounds;
+}
+
+const chunk_index& basic_file::chunkIndex()
+{
+    return p_->chunkIndex();
+}
+
+const chunk_stats_vlr& basic_file::chunkStats() const
+{
+    return p_->stats;
+}
+
+bool basic_file::loadIndex(const std::string& filename)
+{
+    return p_->loadIndex(filename);
+}
+
+size_t basic_file::readColumns(const point_columns& cols, size_t count)
+{
+    return p_->readColumns(cols, count);
+}
+
 const header14& basic_file::header() const
 {
     return p_->head14;
@@ -417,11 +1348,50 @@ std::vector<char> basic_file::vlrData(const std::string& user_id, uint16_t recor
     return p_->vlrData(user_id, record_id);
 }
 
+void basic_file::setThreads(size_t threads, size_t depth)
+{
+    p_->setThreads(threads, depth);
+}
+
+void basic_file::setReadAhead(size_t bufferSize, size_t depth)
+{
+    p_->stream->setReadAhead(bufferSize, depth);
+}
+
+void basic_file::setLayers(uint32_t layers)
+{
+    p_->setLayers(layers);
+}
+
+void basic_file::seek(uint64_t pointIndex)
+{
+    p_->seek(pointIndex);
+}
+
+size_t basic_file::chunkCount() const
+{
+    return p_->chunks.size();
+}
+
+uint32_t basic_file::chunkPointCount(size_t chunkIndex) const
+{
+    if (chunkIndex >= p_->chunks.size())
+        throw error("Invalid chunk index " + std::to_string(chunkIndex) + ".");
+    return p_->chunks[chunkIndex].count;
+}
+
+void basic_file::readChunk(size_t chunkIndex, char *out)
+{
+    p_->readChunk(chunkIndex, out);
+}
+
 // reader::mem_file
 
 mem_file::mem_file(char *buf, size_t count) : p_(new Private(buf, count))
 {
-    if (!open(p_->f))
+    // The buffer belongs to the caller, so the pointer we hand over doesn't delete it.
+    std::shared_ptr<const char> mem(buf, [](const char *){});
+    if (!open(p_->f, mem, count))
         throw error("Couldn't open mem_file as LAS/LAZ");
 }
 
@@ -439,23 +1409,255 @@ generic_file::generic_file(std::istream& in)
         throw error("Couldn't open generic_file as LAS/LAZ");
 }
 
+// reader::mmap_file
+
+#ifdef _WIN32
+
+mmap_file::Private::Private(const std::string& filename) : size(0), data(nullptr), f(&sbuf)
+{
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        throw error("Couldn't open '" + filename + "'.");
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize))
+    {
+        CloseHandle(file);
+        throw error("Couldn't get the size of '" + filename + "'.");
+    }
+    size = (size_t)fileSize.QuadPart;
+    if (size)
+    {
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping)
+        {
+            data = (char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            // The view remains valid after the handles are closed.
+            CloseHandle(mapping);
+        }
+        if (!data)
+        {
+            CloseHandle(file);
+            throw error("Couldn't map '" + filename + "'.");
+        }
+    }
+    CloseHandle(file);
+    init();
+}
+
+#else
+
+mmap_file::Private::Private(const std::string& filename) : size(0), data(nullptr), f(&sbuf)
+{
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw error("Couldn't open '" + filename + "'.");
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        throw error("Couldn't get the size of '" + filename + "'.");
+    }
+    size = (size_t)st.st_size;
+    if (size)
+    {
+        void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED)
+        {
+            ::close(fd);
+            throw error("Couldn't map '" + filename + "'.");
+        }
+        data = static_cast<char *>(addr);
+    }
+    // The mapping remains valid after the descriptor is closed.
+    ::close(fd);
+    init();
+}
+
+#endif
+
+// Workers may still be decoding from the mapping when the file is destroyed, so the
+// mapping is released when the last reference to it is dropped.
+void mmap_file::Private::init()
+{
+    sbuf.initialize(data, size);
+#ifdef _WIN32
+    mem = std::shared_ptr<const char>(data, [](const char *d){ if (d) UnmapViewOfFile(d); });
+#else
+    size_t len = size;
+    mem = std::shared_ptr<const char>(data, [len](const char *d)
+        { if (d) munmap(const_cast<char *>(d), len); });
+#endif
+}
+
+mmap_file::mmap_file(const std::string& filename) : p_(new Private(filename))
+{
+    if (!open(p_->f, p_->mem, p_->size))
+        throw error("Couldn't open mmap_file as LAS/LAZ");
+    loadIndex(chunk_index::filename(filename));
+}
+
+mmap_file::~mmap_file()
+{}
+
 // reader::named_file
 
 named_file::named_file(const std::string& filename) : p_(new Private(filename))
 {
     if (!open(p_->f))
         throw error("Couldn't open named_file as LAS/LAZ");;
+    loadIndex(chunk_index::filename(filename));
 }
 
 named_file::~named_file()
 {}
 
+// reader::source_file
+
+source_file::source_file(std::shared_ptr<range_source> source) : p_(new Private(source))
+{
+    if (!open(p_->f, p_->source))
+        throw error("Couldn't open source_file as LAS/LAZ");
+}
+
+source_file::~source_file()
+{}
+
+// reader::copc_file
+
+struct copc_file::Private
+{
+    Private(const std::string& filename) : f(filename, std::ios::binary),
+        in(filename, std::ios::binary)
+    {}
+
+    const std::vector<copc_entry>& page(uint64_t offset, uint64_t size);
+    void find(const std::vector<copc_entry>& entries, const box& region, int32_t maxDepth,
+        std::vector<copc_entry>& found, std::set<uint64_t>& visited);
+    box bounds(const copc_entry& e) const;
+
+    std::ifstream f;  // Read by basic_file.
+    std::ifstream in;  // Used for the hierarchy and node data.
+    copc_info_vlr info;
+    std::map<uint64_t, std::vector<copc_entry>> pages;  // Keyed by offset.
+};
+
+const std::vector<copc_entry>& copc_file::Private::page(uint64_t offset, uint64_t size)
+{
+    auto it = pages.find(offset);
+    if (it != pages.end())
+        return it->second;
+
+    if (size % copc_entry::Size)
+        throw error("Invalid COPC hierarchy page size.");
+    std::vector<char> buf((size_t)size);
+    in.clear();
+    in.seekg(offset);
+    in.read(buf.data(), buf.size());
+    if (!in.good())
+        throw error("Couldn't read COPC hierarchy page at offset " + std::to_string(offset) +
+            ".");
+
+    std::vector<copc_entry> entries(buf.size() / copc_entry::Size);
+    for (size_t i = 0; i < entries.size(); ++i)
+        entries[i].fill(buf.data() + i * copc_entry::Size, copc_entry::Size);
+    return pages.insert(std::make_pair(offset, std::move(entries))).first->second;
+}
+
+box copc_file::Private::bounds(const copc_entry& e) const
+{
+    double size = 2 * info.halfsize / std::pow(2.0, e.depth);
+    vector3 min(info.center_x - info.halfsize + e.x * size,
+        info.center_y - info.halfsize + e.y * size,
+        info.center_z - info.halfsize + e.z * size);
+    return box(min, vector3(min.x + size, min.y + size, min.z + size));
+}
+
+void copc_file::Private::find(const std::vector<copc_entry>& entries, const box& region,
+    int32_t maxDepth, std::vector<copc_entry>& found, std::set<uint64_t>& visited)
+{
+    for (const copc_entry& e : entries)
+    {
+        if (e.depth > maxDepth || !bounds(e).intersects(region))
+            continue;
+        if (e.point_count == -1)
+        {
+            // A malformed file could have pages that refer to each other.
+            if (visited.insert(e.offset).second)
+                find(page(e.offset, (uint64_t)e.byte_size), region, maxDepth, found, visited);
+        }
+        else if (e.point_count > 0)
+            found.push_back(e);
+    }
+}
+
+copc_file::copc_file(const std::string& filename) : p_(new Private(filename))
+{
+    if (!open(p_->f))
+        throw error("Couldn't open copc_file as LAS/LAZ");
+    std::vector<char> buf = vlrData("copc", 1);
+    if (buf.size() < p_->info.size())
+        throw error("Couldn't find COPC info VLR.");
+    p_->info.fill(buf.data(), buf.size());
+}
+
+copc_file::~copc_file()
+{}
+
+const copc_info_vlr& copc_file::copcInfo() const
+{
+    return p_->info;
+}
+
+std::vector<copc_entry> copc_file::nodes(const box& region, int32_t maxDepth)
+{
+    std::vector<copc_entry> found;
+    std::set<uint64_t> visited { p_->info.root_hier_offset };
+    p_->find(p_->page(p_->info.root_hier_offset, p_->info.root_hier_size), region, maxDepth,
+        found, visited);
+    return found;
+}
+
+box copc_file::nodeBounds(const copc_entry& node) const
+{
+    return p_->bounds(node);
+}
+
+void copc_file::readNode(const copc_entry& node, char *out, uint32_t layers)
+{
+    if (node.point_count < 0 || node.byte_size < 0)
+        throw error("Can't read points from a COPC hierarchy page entry.");
+
+    std::vector<char> buf((size_t)node.byte_size);
+    p_->in.clear();
+    p_->in.seekg(node.offset);
+    p_->in.read(buf.data(), buf.size());
+    if (!p_->in.good())
+        throw error("Couldn't read COPC node data at offset " + std::to_string(node.offset) +
+            ".");
+
+    const header14& h = header();
+    chunk_decompressor d(h.point_format_id, h.ebCount(), buf.data(), buf.size(), layers);
+    for (int32_t i = 0; i < node.point_count; ++i)
+    {
+        d.decompress(out);
+        out += h.point_record_length;
+    }
+}
+
 // Chunk decompressor
 
 struct chunk_decompressor::Private
 {
+    Private(bool bounded) : bounded(bounded), buf(nullptr), span(nullptr, 0)
+    {}
+
     las_decompressor::ptr pdecompressor;
+    bool bounded;
+    // Input when the length of the data isn't known.
     const unsigned char *buf;
+    // Input when the length of the data is known.
+    SpanStream span;
 
     void getBytes(unsigned char *b, int len)
     {
@@ -465,7 +1667,7 @@ struct chunk_decompressor::Private
 };
 
 chunk_decompressor::chunk_decompressor(int format, int ebCount, const char *srcbuf) :
-    p_(new Private)
+    p_(new Private(false))
 {
     using namespace std::placeholders;
 
@@ -474,6 +1676,14 @@ chunk_decompressor::chunk_decompressor(int format, int ebCount, const char *srcb
     p_->pdecompressor = build_las_decompressor(cb, format, ebCount);
 }
 
+// The decompressor reads from the span held here so that reset() can point it at new data.
+chunk_decompressor::chunk_decompressor(int format, int ebCount, const char *srcbuf,
+        size_t srclen, uint32_t layers) : p_(new Private(true))
+{
+    p_->span = SpanStream(reinterpret_cast<const unsigned char *>(srcbuf), srclen);
+    p_->pdecompressor = build_las_decompressor(p_->span, format, ebCount, layers);
+}
+
 chunk_decompressor::~chunk_decompressor()
 {}
 
@@ -482,6 +1692,23 @@ void chunk_decompressor::decompress(char *outbuf)
     p_->pdecompressor->decompress(outbuf);
 }
 
+void chunk_decompressor::reset(const char *srcbuf)
+{
+    if (p_->bounded)
+        throw error("The size of the chunk data is required to reset this decompressor.");
+    p_->buf = reinterpret_cast<const unsigned char *>(srcbuf);
+    p_->pdecompressor->reset();
+}
+
+void chunk_decompressor::reset(const char *srcbuf, size_t srclen)
+{
+    if (!p_->bounded)
+        throw error("This decompressor was built without the size of its data and must be "
+            "reset without one.");
+    p_->span = SpanStream(reinterpret_cast<const unsigned char *>(srcbuf), srclen);
+    p_->pdecompressor->reset();
+}
+
 } // namespace reader
 } // namespace lazperf
 
@@ -23,7 +23,10 @@
 
 #pragma once
 
+#include "chunk_index.hpp"
+#include "columns.hpp"
 #include "header.hpp"
+#include "range_source.hpp"
 #include "vlr.hpp"
 
 namespace lazperf
@@ -41,13 +44,67 @@ protected:
     ~basic_file();
 
     bool open(std::istream& in);
+    // Open a file whose entire contents are also available in 'mem'. Points are decoded
+    // directly from memory.
+    bool open(std::istream& in, std::shared_ptr<const char> mem, size_t memSize);
+    // Open a file that's read through 'in' and also available from 'source'. Chunks are
+    // read from the source on the decoding threads when decoding in parallel.
+    bool open(std::istream& in, std::shared_ptr<range_source> source);
 
 public:
     LAZPERF_EXPORT uint64_t pointCount() const;
     LAZPERF_EXPORT const header14& header() const;
     LAZPERF_EXPORT void readPoint(char *out);
+    // Read up to 'count' points into 'out'. Returns the number of points read, which is
+    // less than 'count' only when the end of the file is reached.
+    LAZPERF_EXPORT size_t readPoints(char *out, size_t count);
+    // Read up to 'count' points into columns (see columns.hpp). Returns the number of
+    // points read.
+    LAZPERF_EXPORT size_t readColumns(const point_columns& cols, size_t count);
     LAZPERF_EXPORT laz_vlr lazVlr() const;
     LAZPERF_EXPORT std::vector<char> vlrData(const std::string& user_id, uint16_t record_id);
+    // Decode chunks on 'threads' worker threads. At most 'depth' decoded chunks are held
+    // ahead of the caller (default is twice the number of threads). Zero threads returns
+    // to decoding on the calling thread. Has no effect on uncompressed files.
+    LAZPERF_EXPORT void setThreads(size_t threads, size_t depth = 0);
+    // Read up to 'depth' buffers of 'bufferSize' bytes of the file ahead of the decoder on a
+    // background thread, so that I/O overlaps decoding. Unless this is called, or if it's
+    // called with a depth of zero, the file is read on the calling thread. Has no effect
+    // on files that are in memory.
+    LAZPERF_EXPORT void setReadAhead(size_t bufferSize, size_t depth = 2);
+    // Position the reader so that the next point read is 'pointIndex'. Only the points
+    // preceding 'pointIndex' in its chunk are decoded.
+    LAZPERF_EXPORT void seek(uint64_t pointIndex);
+    LAZPERF_EXPORT size_t chunkCount() const;
+    LAZPERF_EXPORT uint32_t chunkPointCount(size_t chunkIndex) const;
+    // Decode all the points of a chunk into 'out', which must have room for
+    // chunkPointCount(chunkIndex) points. The reader is left positioned after the chunk.
+    LAZPERF_EXPORT void readChunk(size_t chunkIndex, char *out);
+    // Select the layers to decompress for point formats 6, 7 and 8 (see layer:: in
+    // header.hpp). Layers that aren't selected are skipped and their fields are zero.
+    LAZPERF_EXPORT void setLayers(uint32_t layers);
+    // Read up to 'count' of the points following the current position that lie inside
+    // 'region' (in scaled coordinates) into 'out'. Chunks that can't contain such points
+    // are skipped without being decoded. Returns the number of points read, which
+    // is less than 'count' only when the end of the file is reached.
+    LAZPERF_EXPORT size_t queryPoints(const box& region, char *out, size_t count);
+    // As above, but points must also have a GPS time in [minTime, maxTime]. Points of
+    // formats without GPS time are considered to have a time of 0.
+    LAZPERF_EXPORT size_t queryPoints(const box& region, double minTime, double maxTime,
+        char *out, size_t count);
+    // The bounds of the points in each chunk, in scaled coordinates.
+    LAZPERF_EXPORT const std::vector<box>& chunkBounds();
+    // The chunk index used to prune queries. Unless one has been loaded or the file has
+    // chunk statistics, it's computed by decoding all the chunks in parallel the first
+    // time it's needed.
+    LAZPERF_EXPORT const chunk_index& chunkIndex();
+    // The statistics of each chunk written with the file (see
+    // writer::basic_file::setChunkStats()). Empty if the file has none.
+    LAZPERF_EXPORT const chunk_stats_vlr& chunkStats() const;
+    // Use the index in the sidecar file 'filename' if it matches this file. Returns
+    // false if it doesn't exist or doesn't match. named_file and mmap_file load the
+    // sidecar (see chunk_index::filename()) automatically.
+    LAZPERF_EXPORT bool loadIndex(const std::string& filename);
 
 private:
     // The file object is not copyable or copy constructible
@@ -76,6 +133,34 @@ public:
     LAZPERF_EXPORT generic_file(std::istream& in);
 };
 
+// A file that's memory-mapped. Points are decoded directly from the mapping, without
+// intermediate copies, and threaded decoding doesn't need to read chunks on the calling thread.
+class mmap_file : public basic_file
+{
+    struct Private;
+
+public:
+    LAZPERF_EXPORT mmap_file(const std::string& filename);
+    LAZPERF_EXPORT ~mmap_file();
+
+private:
+    std::unique_ptr<Private> p_;
+};
+
+// A file read through a range_source (see range_source.hpp). Wrap the source in a
+// cached_source if small reads are expensive.
+class source_file : public basic_file
+{
+    struct Private;
+
+public:
+    LAZPERF_EXPORT source_file(std::shared_ptr<range_source> source);
+    LAZPERF_EXPORT ~source_file();
+
+private:
+    std::unique_ptr<Private> p_;
+};
+
 class named_file : public basic_file
 {
     struct Private;
@@ -88,6 +173,33 @@ private:
     std::unique_ptr<Private> p_;
 };
 
+// A COPC (cloud-optimized point cloud) file. In addition to reading points in file order,
+// the octree nodes can be found and their points decoded. Hierarchy pages are read
+// as they're needed and cached.
+class copc_file : public basic_file
+{
+    struct Private;
+
+public:
+    LAZPERF_EXPORT copc_file(const std::string& filename);
+    LAZPERF_EXPORT ~copc_file();
+
+    LAZPERF_EXPORT const copc_info_vlr& copcInfo() const;
+    // Find the nodes with points whose bounds intersect 'region' and whose depth is no
+    // greater than 'maxDepth'. Nodes are returned in hierarchy order.
+    LAZPERF_EXPORT std::vector<copc_entry> nodes(const box& region,
+        int32_t maxDepth = (std::numeric_limits<int32_t>::max)());
+    // The bounds of a node's octree cell.
+    LAZPERF_EXPORT box nodeBounds(const copc_entry& node) const;
+    // Decode the points of a node into 'out', which must have room for
+    // node.point_count points.
+    LAZPERF_EXPORT void readNode(const copc_entry& node, char *out,
+        uint32_t layers = layer::All);
+
+private:
+    std::unique_ptr<Private> p_;
+};
+
 ///
 
 class chunk_decompressor
@@ -95,8 +207,17 @@ class chunk_decompressor
     struct Private;
 public:
     LAZPERF_EXPORT chunk_decompressor(int format, int ebCount, const char *srcbuf);
+    // Reading never goes past srcbuf + srclen. Decoding a truncated chunk yields garbage
+    // points rather than reading outside the buffer.
+    LAZPERF_EXPORT chunk_decompressor(int format, int ebCount, const char *srcbuf,
+        size_t srclen, uint32_t layers = layer::All);
     LAZPERF_EXPORT ~chunk_decompressor();
     LAZPERF_EXPORT void decompress(char *outbuf);
+    // Start decompressing a new chunk of data. This is much cheaper than constructing a
+    // new decompressor. The first form is for a decompressor constructed without the
+    // length of its data, the second for one constructed with it.
+    LAZPERF_EXPORT void reset(const char *srcbuf);
+    LAZPERF_EXPORT void reset(const char *srcbuf, size_t srclen);
 
 private:
     std::unique_ptr<Private> p_;
@@ -0,0 +1,416 @@
+/******************************************************************************
+* Copyright (c) 2026, Hobu Inc., info@hobu.co
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following
+* conditions are met:
+*
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in
+*       the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of Hobu, Inc. or Flaxen Geo Consulting nor the
+*       names of its contributors may be used to endorse or promote
+*       products derived from this software without specific prior
+*       written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+* COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+* OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+* AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+* OF SUCH DAMAGE.
+****************************************************************************/
+
+
+#include <algorithm>
+#include <cstring>
+
+#include "scale.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+#define LAZPERF_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define LAZPERF_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+namespace lazperf
+{
+namespace scale
+{
+
+namespace
+{
+
+template<typename T>
+void toScalar(const int32_t *in, size_t count, double scale, double offset,
+    char *out, size_t stride)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        T val = (T)(in[i] * scale + offset);
+        std::memcpy(out, &val, sizeof(T));
+        out += stride;
+    }
+}
+
+// Results must lie in (Low, High) to fit in an int32_t after rounding.
+const double Low = -2147483648.5;
+const double High = 2147483647.5;
+
+bool fromScalar(const char *in, size_t count, size_t stride, double scale, double offset,
+    int32_t *out)
+{
+    for (size_t i = 0; i < count; ++i, in += stride)
+    {
+        double d;
+        std::memcpy(&d, in, sizeof(d));
+        double t = (d - offset) / scale;
+        if (!(t > Low && t < High))
+            return false;
+        int32_t r = (int32_t)t;
+        double frac = t - r;
+        if (frac >= .5)
+            r++;
+        else if (frac <= -.5)
+            r--;
+        out[i] = r;
+    }
+    return true;
+}
+
+#ifdef LAZPERF_SSE2
+
+// Returns the number of values converted. The rest are left to the scalar code.
+size_t toDoubleSse2(const int32_t *in, size_t count, double scale, double offset, double *out)
+{
+    const __m128d s = _mm_set1_pd(scale);
+    const __m128d o = _mm_set1_pd(offset);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        __m128d lo = _mm_cvtepi32_pd(v);
+        __m128d hi = _mm_cvtepi32_pd(_mm_unpackhi_epi64(v, v));
+        _mm_storeu_pd(out + i, _mm_add_pd(_mm_mul_pd(lo, s), o));
+        _mm_storeu_pd(out + i + 2, _mm_add_pd(_mm_mul_pd(hi, s), o));
+    }
+    return i;
+}
+
+size_t toFloatSse2(const int32_t *in, size_t count, double scale, double offset, float *out)
+{
+    const __m128d s = _mm_set1_pd(scale);
+    const __m128d o = _mm_set1_pd(offset);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        __m128 lo = _mm_cvtpd_ps(_mm_add_pd(_mm_mul_pd(_mm_cvtepi32_pd(v), s), o));
+        __m128 hi = _mm_cvtpd_ps(_mm_add_pd(_mm_mul_pd(
+            _mm_cvtepi32_pd(_mm_unpackhi_epi64(v, v)), s), o));
+        _mm_storeu_ps(out + i, _mm_movelh_ps(lo, hi));
+    }
+    return i;
+}
+
+// Returns the number of values converted, which is less than the number that can be
+// converted with SSE2 if a value is out of range. The values are rounded as fromScalar()
+// does: the truncated value is adjusted by one if the fraction is a half or more.
+size_t fromDoubleSse2(const double *in, size_t count, double scale, double offset,
+    int32_t *out)
+{
+    const __m128d s = _mm_set1_pd(scale);
+    const __m128d o = _mm_set1_pd(offset);
+    const __m128d low = _mm_set1_pd(Low);
+    const __m128d high = _mm_set1_pd(High);
+    const __m128d half = _mm_set1_pd(.5);
+    const __m128d mhalf = _mm_set1_pd(-.5);
+    const __m128d one = _mm_set1_pd(1);
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2)
+    {
+        __m128d t = _mm_div_pd(_mm_sub_pd(_mm_loadu_pd(in + i), o), s);
+        __m128d ok = _mm_and_pd(_mm_cmpgt_pd(t, low), _mm_cmplt_pd(t, high));
+        if (_mm_movemask_pd(ok) != 0x3)
+            break;
+        __m128d r = _mm_cvtepi32_pd(_mm_cvttpd_epi32(t));
+        __m128d frac = _mm_sub_pd(t, r);
+        r = _mm_add_pd(r, _mm_and_pd(_mm_cmpge_pd(frac, half), one));
+        r = _mm_sub_pd(r, _mm_and_pd(_mm_cmple_pd(frac, mhalf), one));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(out + i), _mm_cvttpd_epi32(r));
+    }
+    return i;
+}
+
+// SSE2 has no 32-bit integer min and max, so they're selected with a comparison mask.
+size_t rangeSse2(const int32_t *in, size_t count, int32_t& min, int32_t& max)
+{
+    if (count < 4)
+        return 0;
+
+    __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in));
+    __m128i hi = lo;
+    size_t i = 4;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        __m128i lt = _mm_cmplt_epi32(v, lo);
+        lo = _mm_or_si128(_mm_and_si128(lt, v), _mm_andnot_si128(lt, lo));
+        __m128i gt = _mm_cmpgt_epi32(v, hi);
+        hi = _mm_or_si128(_mm_and_si128(gt, v), _mm_andnot_si128(gt, hi));
+    }
+    int32_t l[4];
+    int32_t h[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(l), lo);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(h), hi);
+    for (int j = 0; j < 4; ++j)
+    {
+        min = (std::min)(min, l[j]);
+        max = (std::max)(max, h[j]);
+    }
+    return i;
+}
+
+#endif // LAZPERF_SSE2
+
+#ifdef LAZPERF_AVX2
+
+__attribute__((target("avx2")))
+size_t toDoubleAvx2(const int32_t *in, size_t count, double scale, double offset, double *out)
+{
+    const __m256d s = _mm256_set1_pd(scale);
+    const __m256d o = _mm256_set1_pd(offset);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+        __m256d lo = _mm256_cvtepi32_pd(_mm256_castsi256_si128(v));
+        __m256d hi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1));
+        _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_mul_pd(lo, s), o));
+        _mm256_storeu_pd(out + i + 4, _mm256_add_pd(_mm256_mul_pd(hi, s), o));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t toFloatAvx2(const int32_t *in, size_t count, double scale, double offset, float *out)
+{
+    const __m256d s = _mm256_set1_pd(scale);
+    const __m256d o = _mm256_set1_pd(offset);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+        __m128 lo = _mm256_cvtpd_ps(_mm256_add_pd(_mm256_mul_pd(
+            _mm256_cvtepi32_pd(_mm256_castsi256_si128(v)), s), o));
+        __m128 hi = _mm256_cvtpd_ps(_mm256_add_pd(_mm256_mul_pd(
+            _mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1)), s), o));
+        _mm256_storeu_ps(out + i, _mm256_set_m128(hi, lo));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t fromDoubleAvx2(const double *in, size_t count, double scale, double offset,
+    int32_t *out)
+{
+    const __m256d s = _mm256_set1_pd(scale);
+    const __m256d o = _mm256_set1_pd(offset);
+    const __m256d low = _mm256_set1_pd(Low);
+    const __m256d high = _mm256_set1_pd(High);
+    const __m256d half = _mm256_set1_pd(.5);
+    const __m256d mhalf = _mm256_set1_pd(-.5);
+    const __m256d one = _mm256_set1_pd(1);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256d t = _mm256_div_pd(_mm256_sub_pd(_mm256_loadu_pd(in + i), o), s);
+        __m256d ok = _mm256_and_pd(_mm256_cmp_pd(t, low, _CMP_GT_OQ),
+            _mm256_cmp_pd(t, high, _CMP_LT_OQ));
+        if (_mm256_movemask_pd(ok) != 0xF)
+            break;
+        __m256d r = _mm256_cvtepi32_pd(_mm256_cvttpd_epi32(t));
+        __m256d frac = _mm256_sub_pd(t, r);
+        r = _mm256_add_pd(r, _mm256_and_pd(_mm256_cmp_pd(frac, half, _CMP_GE_OQ), one));
+        r = _mm256_sub_pd(r, _mm256_and_pd(_mm256_cmp_pd(frac, mhalf, _CMP_LE_OQ), one));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm256_cvttpd_epi32(r));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t rangeAvx2(const int32_t *in, size_t count, int32_t& min, int32_t& max)
+{
+    if (count < 8)
+        return 0;
+
+    __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in));
+    __m256i hi = lo;
+    size_t i = 8;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+        lo = _mm256_min_epi32(lo, v);
+        hi = _mm256_max_epi32(hi, v);
+    }
+    int32_t l[8];
+    int32_t h[8];
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(l), lo);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(h), hi);
+    for (int j = 0; j < 8; ++j)
+    {
+        min = (std::min)(min, l[j]);
+        max = (std::max)(max, h[j]);
+    }
+    return i;
+}
+
+#endif // LAZPERF_AVX2
+
+} // unnamed namespace
+
+void toDouble(const int32_t *in, size_t count, double scale, double offset,
+    char *out, size_t stride)
+{
+    toDouble(in, count, scale, offset, out, stride, simd::best());
+}
+
+void toDouble(const int32_t *in, size_t count, double scale, double offset,
+    char *out, size_t stride, simd::Isa isa)
+{
+    size_t done = 0;
+    if (stride == sizeof(double))
+    {
+        double *d = reinterpret_cast<double *>(out);
+        switch (isa)
+        {
+#ifdef LAZPERF_AVX2
+        case simd::Isa::Avx2:
+            done = toDoubleAvx2(in, count, scale, offset, d);
+            break;
+#endif
+#ifdef LAZPERF_SSE2
+        case simd::Isa::Sse2:
+            done = toDoubleSse2(in, count, scale, offset, d);
+            break;
+#endif
+        default:
+            break;
+        }
+        (void)d;
+    }
+    toScalar<double>(in + done, count - done, scale, offset, out + done * stride, stride);
+}
+
+void toFloat(const int32_t *in, size_t count, double scale, double offset,
+    char *out, size_t stride)
+{
+    toFloat(in, count, scale, offset, out, stride, simd::best());
+}
+
+void toFloat(const int32_t *in, size_t count, double scale, double offset,
+    char *out, size_t stride, simd::Isa isa)
+{
+    size_t done = 0;
+    if (stride == sizeof(float))
+    {
+        float *f = reinterpret_cast<float *>(out);
+        switch (isa)
+        {
+#ifdef LAZPERF_AVX2
+        case simd::Isa::Avx2:
+            done = toFloatAvx2(in, count, scale, offset, f);
+            break;
+#endif
+#ifdef LAZPERF_SSE2
+        case simd::Isa::Sse2:
+            done = toFloatSse2(in, count, scale, offset, f);
+            break;
+#endif
+        default:
+            break;
+        }
+        (void)f;
+    }
+    toScalar<float>(in + done, count - done, scale, offset, out + done * stride, stride);
+}
+
+bool fromDouble(const char *in, size_t count, size_t stride, double scale, double offset,
+    int32_t *out)
+{
+    return fromDouble(in, count, stride, scale, offset, out, simd::best());
+}
+
+bool fromDouble(const char *in, size_t count, size_t stride, double scale, double offset,
+    int32_t *out, simd::Isa isa)
+{
+    size_t done = 0;
+    if (stride == sizeof(double))
+    {
+        const double *d = reinterpret_cast<const double *>(in);
+        switch (isa)
+        {
+#ifdef LAZPERF_AVX2
+        case simd::Isa::Avx2:
+            done = fromDoubleAvx2(d, count, scale, offset, out);
+            break;
+#endif
+#ifdef LAZPERF_SSE2
+        case simd::Isa::Sse2:
+            done = fromDoubleSse2(d, count, scale, offset, out);
+            break;
+#endif
+        default:
+            break;
+        }
+        (void)d;
+    }
+    return fromScalar(in + done * stride, count - done, stride, scale, offset, out + done);
+}
+
+void range(const int32_t *in, size_t count, int32_t& min, int32_t& max)
+{
+    range(in, count, min, max, simd::best());
+}
+
+void range(const int32_t *in, size_t count, int32_t& min, int32_t& max, simd::Isa isa)
+{
+    size_t done = 0;
+    switch (isa)
+    {
+#ifdef LAZPERF_AVX2
+    case simd::Isa::Avx2:
+        done = rangeAvx2(in, count, min, max);
+        break;
+#endif
+#ifdef LAZPERF_SSE2
+    case simd::Isa::Sse2:
+        done = rangeSse2(in, count, min, max);
+        break;
+#endif
+    default:
+        break;
+    }
+    for (size_t i = done; i < count; ++i)
+    {
+        min = (std::min)(min, in[i]);
+        max = (std::max)(max, in[i]);
+    }
+}
+
+} // namespace scale
+} // namespace lazperf
@@ -0,0 +1,76 @@
+/******************************************************************************
+* Copyright (c) 2026, Hobu Inc., info@hobu.co
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following
+* conditions are met:
+*
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in
+*       the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of Hobu, Inc. or Flaxen Geo Consulting nor the
+*       names of its contributors may be used to endorse or promote
+*       products derived from this software without specific prior
+*       written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+* COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+* OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+* AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+* OF SUCH DAMAGE.
+****************************************************************************/
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "simd.hpp"
+
+namespace lazperf
+{
+namespace scale
+{
+
+// Compute out[i] = in[i] * scale + offset for 'count' values, writing each output value
+// 'stride' bytes after the last. Contiguous output is converted with SSE2 or AVX2
+// when the CPU supports it.
+void toDouble(const int32_t *in, size_t count, double scale, double offset,
+    char *out, size_t stride);
+// As above, but the double result is rounded to float.
+void toFloat(const int32_t *in, size_t count, double scale, double offset,
+    char *out, size_t stride);
+// Set out[i] to the value read 'stride' bytes after the last, less 'offset' and divided by
+// 'scale', rounded to the nearest integer with halves rounded away from zero. Contiguous
+// input is converted with SSE2 or AVX2 when the CPU supports it. Returns false if a
+// result doesn't fit in an int32_t, in which case 'out' is incomplete.
+bool fromDouble(const char *in, size_t count, size_t stride, double scale, double offset,
+    int32_t *out);
+// Lower 'min' and raise 'max' to cover the 'count' contiguous values of 'in'.
+void range(const int32_t *in, size_t count, int32_t& min, int32_t& max);
+
+// As above, but run with 'isa', which must be supported, so each vector version can be
+// tested against the scalar code.
+void toDouble(const int32_t *in, size_t count, double scale, double offset,
+    char *out, size_t stride, simd::Isa isa);
+void toFloat(const int32_t *in, size_t count, double scale, double offset,
+    char *out, size_t stride, simd::Isa isa);
+bool fromDouble(const char *in, size_t count, size_t stride, double scale, double offset,
+    int32_t *out, simd::Isa isa);
+void range(const int32_t *in, size_t count, int32_t& min, int32_t& max, simd::Isa isa);
+
+} // namespace scale
+} // namespace lazperf
@@ -29,6 +29,7 @@
 #ifndef __streams_hpp__
 #define __streams_hpp__
 
+#include <algorithm>
 #include <vector>
 #include <iostream>
 
@@ -75,9 +76,147 @@ struct InCbStream
         inCb_(b, len);
     }
 
+    // Discard 'len' bytes.
+    void skip(size_t len)
+    {
+        unsigned char buf[1024];
+        while (len)
+        {
+            size_t cnt = (std::min)(len, sizeof(buf));
+            inCb_(buf, cnt);
+            len -= cnt;
+        }
+    }
+
     InputCb inCb_;
 };
 
+// Input read directly from a contiguous range of memory. Reading past the end yields
+// zeros, so that a truncated chunk decodes to garbage rather than reading outside the range.
+struct SpanStream
+{
+    SpanStream(const unsigned char *data, size_t len) : pos_(data), end_(data + len)
+    {}
+
+    unsigned char getByte()
+    {
+        return pos_ < end_ ? *pos_++ : 0;
+    }
+
+    void getBytes(unsigned char *b, size_t len)
+    {
+        size_t avail = (std::min)(len, (size_t)(end_ - pos_));
+        std::copy(pos_, pos_ + avail, b);
+        std::fill(b + avail, b + len, 0);
+        pos_ += avail;
+    }
+
+    // Discard 'len' bytes.
+    void skip(size_t len)
+    {
+        pos_ += (std::min)(len, (size_t)(end_ - pos_));
+    }
+
+    const unsigned char *pos_;
+    const unsigned char *end_;
+};
+
+// The data of one layer of a point format 6, 7 or 8 chunk. The layer is read in place when
+// the chunk is in memory and is otherwise copied into a buffer owned by the stream.
+struct LayerStream : public SpanStream
+{
+    LayerStream() : SpanStream(nullptr, 0)
+    {}
+
+    // The copy reads from its own buffer, if the data was copied.
+    LayerStream(const LayerStream& other) : SpanStream(other), buf_(other.buf_)
+    {
+        if (buf_.size())
+        {
+            pos_ = buf_.data() + (other.pos_ - other.buf_.data());
+            end_ = buf_.data() + (other.end_ - other.buf_.data());
+        }
+    }
+
+    LayerStream& operator=(const LayerStream&) = delete;
+
+    // Read the 'len' bytes at 'data', which must remain valid while they're read.
+    void assign(const unsigned char *data, size_t len)
+    {
+        buf_.clear();
+        pos_ = data;
+        end_ = data + len;
+    }
+
+    // Copy 'len' bytes from the callback and read them.
+    void fill(const InputCb& inCb, size_t len)
+    {
+        buf_.resize(len);
+        inCb(buf_.data(), len);
+        pos_ = buf_.data();
+        end_ = pos_ + len;
+    }
+
+    // Read the next 'bytes' bytes of the source (see LayerSource).
+    template <typename TSrc>
+    void copy(TSrc& in, size_t bytes)
+    {
+        in.readLayer(*this, bytes);
+    }
+
+    std::vector<unsigned char> buf_;
+};
+
+// The input of the point format 6, 7 and 8 decompressors. It's read either through a
+// callback or from a SpanStream owned by the caller. In the latter case the layers of a
+// chunk are decoded where they lie rather than being copied.
+struct LayerSource
+{
+    LayerSource(InputCb inCb) : cb_(inCb), span_(nullptr)
+    {}
+
+    LayerSource(SpanStream& span) : cb_(InputCb()), span_(&span)
+    {}
+
+    unsigned char getByte()
+    {
+        return span_ ? span_->getByte() : cb_.getByte();
+    }
+
+    void getBytes(unsigned char *b, size_t len)
+    {
+        if (span_)
+            span_->getBytes(b, len);
+        else
+            cb_.getBytes(b, len);
+    }
+
+    // Discard 'len' bytes.
+    void skip(size_t len)
+    {
+        if (span_)
+            span_->skip(len);
+        else
+            cb_.skip(len);
+    }
+
+    // Set 'layer' to read the next 'len' bytes of input. Past the end of a span, the layer
+    // reads zeros, as when its bytes are copied.
+    void readLayer(LayerStream& layer, size_t len)
+    {
+        if (span_)
+        {
+            layer.assign(span_->pos_, (std::min)(len, (size_t)(span_->end_ - span_->pos_)));
+            span_->skip(len);
+        }
+        else
+            layer.fill(cb_.inCb_, len);
+    }
+
+    InCbStream cb_;
+    SpanStream *span_;
+};
+
 struct MemoryStream
 {
     MemoryStream() : buf(), idx(0)
@@ -124,12 +263,20 @@ struct MemoryStream
         return buf.size();
     }
 
-    // Copy bytes from the source stream to this stream.
+    // Replace the contents of this stream with bytes from the source stream.
     template <typename TSrc>
     void copy(TSrc& in, size_t bytes)
     {
         buf.resize(bytes);
         in.getBytes(buf.data(), bytes);
+        idx = 0;
+    }
+
+    // Discard the contents, keeping the allocated space.
+    void clear()
+    {
+        buf.clear();
+        idx = 0;
     }
 
     const uint8_t *data() const
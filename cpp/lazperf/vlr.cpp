@@ -563,5 +563,126 @@ evlr_header copc_info_vlr::eheader() const
     return evlr_header { 0, "copc", 1, size(), "COPC info VLR" };
 }
 
-} // namespace lazperf
+// COPC hierarchy entry
+
+const int copc_entry::Size = 32;
+
+void copc_entry::fill(const char *buf, size_t bufsize)
+{
+    LeExtractor s(buf, bufsize);
+
+    s >> depth >> x >> y >> z >> offset >> byte_size >> point_count;
+}
+
+std::vector<char> copc_entry::data() const
+{
+    std::vector<char> buf(Size);
+    LeInserter s(buf.data(), buf.size());
+
+    s << depth << x << y << z << offset << byte_size << point_count;
+    return buf;
+}
+
+// Chunk statistics
+
+const char *chunk_stats_vlr::UserId = "lazperf";
+const uint16_t chunk_stats_vlr::RecordId = 1;
+
+namespace
+{
+
+const uint32_t ChunkStatsVersion = 1;
+const size_t ChunkStatsHeaderSize = 2 * sizeof(uint32_t);
+const size_t ChunkStatsEntrySize = 8 * sizeof(double) + 32 + 16 * sizeof(uint32_t);
+
+} // unnamed namespace
+
+chunk_stats_vlr::entry::entry() : min_time((std::numeric_limits<double>::max)()),
+    max_time((std::numeric_limits<double>::lowest)()), classes(), returns()
+{}
+
+chunk_stats_vlr::chunk_stats_vlr()
+{}
+
+chunk_stats_vlr::~chunk_stats_vlr()
+{}
+
+chunk_stats_vlr chunk_stats_vlr::create(std::istream& in, uint64_t byteSize)
+{
+    chunk_stats_vlr statsVlr;
+    statsVlr.read(in, byteSize);
+    return statsVlr;
+}
+
+void chunk_stats_vlr::read(std::istream& in, uint64_t byteSize)
+{
+    std::vector<char> buf((size_t)byteSize);
+    in.read(buf.data(), buf.size());
+    fill(buf.data(), buf.size());
+}
+
+// Data of an unknown version or of the wrong size is ignored.
+void chunk_stats_vlr::fill(const char *buf, size_t bufsize)
+{
+    chunks.clear();
+    if (bufsize < ChunkStatsHeaderSize)
+        return;
+
+    LeExtractor s(buf, bufsize);
+    uint32_t version;
+    uint32_t count;
+    s >> version >> count;
+    if (version != ChunkStatsVersion ||
+            bufsize != ChunkStatsHeaderSize + count * ChunkStatsEntrySize)
+        return;
+
+    chunks.resize(count);
+    for (entry& e : chunks)
+    {
+        s >> e.bounds.min.x >> e.bounds.min.y >> e.bounds.min.z >>
+            e.bounds.max.x >> e.bounds.max.y >> e.bounds.max.z >> e.min_time >> e.max_time;
+        s.get(reinterpret_cast<unsigned char *>(e.classes), sizeof(e.classes));
+        for (uint32_t& r : e.returns)
+            s >> r;
+    }
+}
 
+void chunk_stats_vlr::write(std::ostream& out) const
+{
+    std::vector<char> buf = data();
+    out.write(buf.data(), buf.size());
+}
+
+std::vector<char> chunk_stats_vlr::data() const
+{
+    std::vector<char> buf(size());
+    LeInserter s(buf.data(), buf.size());
+
+    s << ChunkStatsVersion << (uint32_t)chunks.size();
+    for (const entry& e : chunks)
+    {
+        s << e.bounds.min.x << e.bounds.min.y << e.bounds.min.z <<
+            e.bounds.max.x << e.bounds.max.y << e.bounds.max.z << e.min_time << e.max_time;
+        s.put(reinterpret_cast<const unsigned char *>(e.classes), sizeof(e.classes));
+        for (uint32_t r : e.returns)
+            s << r;
+    }
+    return buf;
+}
+
+uint64_t chunk_stats_vlr::size() const
+{
+    return ChunkStatsHeaderSize + chunks.size() * ChunkStatsEntrySize;
+}
+
+vlr_header chunk_stats_vlr::header() const
+{
+    return vlr_header { 0, UserId, RecordId, (uint16_t)size(), "Chunk statistics" };
+}
+
+evlr_header chunk_stats_vlr::eheader() const
+{
+    return evlr_header { 0, UserId, RecordId, size(), "Chunk statistics" };
+}
+
+} // namespace lazperf
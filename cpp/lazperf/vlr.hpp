@@ -214,6 +214,60 @@ public:
     virtual vlr_header header() const;
     virtual evlr_header eheader() const;
 };
+
+// An entry in a page of the COPC hierarchy EVLR. An entry whose point count is -1
+// refers to a child hierarchy page rather than to point data.
+struct LAZPERF_EXPORT copc_entry
+{
+    int32_t depth;
+    int32_t x;
+    int32_t y;
+    int32_t z;
+    uint64_t offset;
+    int32_t byte_size;
+    int32_t point_count;
+
+    void fill(const char *buf, size_t bufsize);
+    std::vector<char> data() const;
+    static const int Size;
+};
+
+// Summary statistics of the points of each chunk of a compressed file. The writer stores
+// them in an EVLR on request (see writer::basic_file::setChunkStats()) so that readers can
+// find the chunks that may hold points of interest without decoding any of them.
+struct LAZPERF_EXPORT chunk_stats_vlr : public vlr
+{
+public:
+    struct LAZPERF_EXPORT entry
+    {
+        box bounds;  // Scaled coordinates.
+        double min_time;  // Zero for formats without GPS time.
+        double max_time;
+        uint8_t classes[32];  // Bit N of byte N / 8 is set if a point has classification N.
+        uint32_t returns[16];  // The number of points with each return number.
+
+        entry();
+        bool hasClass(uint8_t classification) const
+        { return (classes[classification / 8] >> (classification % 8)) & 1; }
+    };
+
+    std::vector<entry> chunks;
+
+    chunk_stats_vlr();
+    virtual ~chunk_stats_vlr();
+
+    static chunk_stats_vlr create(std::istream& in, uint64_t byteSize);
+    void read(std::istream& in, uint64_t byteSize);
+    void write(std::ostream& out) const;
+    void fill(const char *buf, size_t bufsize);
+    std::vector<char> data() const;
+    virtual uint64_t size() const;
+    virtual vlr_header header() const;
+    virtual evlr_header eheader() const;
+
+    static const char *UserId;
+    static const uint16_t RecordId;
+};
 #pragma warning (pop)
 
 } // namesapce lazperf
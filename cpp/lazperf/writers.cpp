@@ -28,9 +28,20 @@
 ===============================================================================
 */
 
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <unordered_set>
+
 #include "las.hpp"
 #include "lazperf.hpp"
+#include "point_codec.hpp"
+#include "scale.hpp"
 #include "streams.hpp"
+#include "threadpool.hpp"
 #include "vlr.hpp"
 #include "writers.hpp"
 
@@ -39,22 +50,196 @@ namespace lazperf
 namespace writer
 {
 
+namespace
+{
+
+// Pack the values of columns into point records. Fields without a column are zero.
+void gather(const point_columns& cols, size_t count, int format, size_t ebCount, char *out)
+{
+    const size_t pointLen = baseCount(format) + ebCount;
+    for (size_t i = 0; i < count; ++i, out += pointLen)
+    {
+        char *pos = out;
+        if (format <= 5)
+        {
+            las::point10 p;
+            p.x = cols.x ? cols.x.get(i) : 0;
+            p.y = cols.y ? cols.y.get(i) : 0;
+            p.z = cols.z ? cols.z.get(i) : 0;
+            p.intensity = cols.intensity ? cols.intensity.get(i) : 0;
+            p.return_number = cols.return_number ? cols.return_number.get(i) : 0;
+            p.number_of_returns_of_given_pulse =
+                cols.number_of_returns ? cols.number_of_returns.get(i) : 0;
+            p.scan_direction_flag = cols.scan_direction_flag ? cols.scan_direction_flag.get(i) : 0;
+            p.edge_of_flight_line = cols.edge_of_flight_line ? cols.edge_of_flight_line.get(i) : 0;
+            p.classification = cols.classification ? cols.classification.get(i) : 0;
+            p.scan_angle_rank = cols.scan_angle ? (char)cols.scan_angle.get(i) : 0;
+            p.user_data = cols.user_data ? cols.user_data.get(i) : 0;
+            p.point_source_ID = cols.point_source_id ? cols.point_source_id.get(i) : 0;
+            p.pack(pos);
+            pos += sizeof(las::point10);
+            if (format == 1 || format == 3)
+            {
+                utils::pack(cols.gps_time ? cols.gps_time.get(i) : 0.0, pos);
+                pos += sizeof(las::gpstime);
+            }
+        }
+        else
+        {
+            las::point14 p;
+            p.setX(cols.x ? cols.x.get(i) : 0);
+            p.setY(cols.y ? cols.y.get(i) : 0);
+            p.setZ(cols.z ? cols.z.get(i) : 0);
+            p.setIntensity(cols.intensity ? cols.intensity.get(i) : 0);
+            p.setReturns(0);
+            p.setReturnNum(cols.return_number ? cols.return_number.get(i) : 0);
+            p.setNumReturns(cols.number_of_returns ? cols.number_of_returns.get(i) : 0);
+            p.setFlags(0);
+            p.setClassFlags(cols.classification_flags ? cols.classification_flags.get(i) : 0);
+            p.setScannerChannel(cols.scanner_channel ? cols.scanner_channel.get(i) : 0);
+            p.setScanDirFlag(cols.scan_direction_flag ? cols.scan_direction_flag.get(i) : 0);
+            p.setEofFlag(cols.edge_of_flight_line ? cols.edge_of_flight_line.get(i) : 0);
+            p.setClassification(cols.classification ? cols.classification.get(i) : 0);
+            p.setUserData(cols.user_data ? cols.user_data.get(i) : 0);
+            p.setScanAngle(cols.scan_angle ? cols.scan_angle.get(i) : 0);
+            p.setPointSourceID(cols.point_source_id ? cols.point_source_id.get(i) : 0);
+            p.setGpsTime(cols.gps_time ? cols.gps_time.get(i) : 0);
+            p.pack(pos);
+            pos += sizeof(las::point14);
+        }
+        if (format == 2 || format == 3 || format == 7 || format == 8)
+        {
+            las::rgb rgb(cols.red ? cols.red.get(i) : 0, cols.green ? cols.green.get(i) : 0,
+                cols.blue ? cols.blue.get(i) : 0);
+            rgb.pack(pos);
+            pos += sizeof(las::rgb);
+        }
+        if (format == 8)
+        {
+            utils::pack(cols.nir ? cols.nir.get(i) : (uint16_t)0, pos);
+            pos += sizeof(las::nir14);
+        }
+        if (ebCount)
+        {
+            if (cols.extra_bytes)
+                std::memcpy(pos, cols.extra_bytes.at(i), ebCount);
+            else
+                std::memset(pos, 0, ebCount);
+        }
+    }
+}
+
+// Passes output through to another stream buffer, counting the bytes. The count is
+// reported as the position, so the position of output that can't be repositioned is known.
+class counting_buf : public std::streambuf
+{
+public:
+    counting_buf(std::streambuf *dest) : dest_(dest), count_(0)
+    {}
+
+protected:
+    int_type overflow(int_type c) override
+    {
+        if (traits_type::eq_int_type(c, traits_type::eof()))
+            return traits_type::not_eof(c);
+        if (traits_type::eq_int_type(dest_->sputc(traits_type::to_char_type(c)),
+                traits_type::eof()))
+            return traits_type::eof();
+        count_++;
+        return c;
+    }
+
+    std::streamsize xsputn(const char *s, std::streamsize n) override
+    {
+        std::streamsize written = dest_->sputn(s, n);
+        count_ += written;
+        return written;
+    }
+
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+        std::ios_base::openmode which) override
+    {
+        if (off == 0 && dir == std::ios_base::cur && (which & std::ios_base::out))
+            return pos_type(count_);
+        return pos_type(off_type(-1));
+    }
+
+    int sync() override
+    {
+        return dest_->pubsync();
+    }
+
+private:
+    std::streambuf *dest_;
+    uint64_t count_;
+};
+
+// Add a point record to the statistics of its chunk.
+void addStats(chunk_stats_vlr::entry& e, const char *p, const header12& h)
+{
+    const int format = h.pointFormat();
+    e.bounds.grow(utils::unpack<int32_t>(p) * h.scale.x + h.offset.x,
+        utils::unpack<int32_t>(p + 4) * h.scale.y + h.offset.y,
+        utils::unpack<int32_t>(p + 8) * h.scale.z + h.offset.z);
+
+    uint8_t returnNum;
+    uint8_t classification;
+    double t = 0;
+    if (format <= 5)
+    {
+        returnNum = p[14] & 0x7;
+        classification = p[15] & 0x1F;
+        if (format == 1 || format == 3)
+            t = utils::unpack<double>(p + sizeof(las::point10));
+    }
+    else
+    {
+        returnNum = p[14] & 0xF;
+        classification = (uint8_t)p[16];
+        t = utils::unpack<double>(p + 22);
+    }
+    e.min_time = (std::min)(e.min_time, t);
+    e.max_time = (std::max)(e.max_time, t);
+    e.classes[classification / 8] |= (uint8_t)(1 << (classification % 8));
+    e.returns[returnNum]++;
+}
+
+} // unnamed namespace
+
 struct basic_file::Private
 {
-    Private() : chunk_size(DefaultChunkSize), head12(head14), head13(head14),
-        f(nullptr)
+    Private() : chunk_point_num(0), chunk_size(DefaultChunkSize), head12(head14),
+        head13(head14), f(nullptr), seekable(true), expected_count(0), depth(0),
+        chunk_open(false), builder_chunk_size(0), keep_stats(false)
     {}
 
     void close();
     uint64_t newChunk();
     uint64_t firstChunkOffset() const;
     bool compressed() const;
-    bool open(std::ostream& out, const header12& h, uint32_t chunk_size);
+    bool open(std::ostream& out, const header12& h, uint32_t chunk_size, bool seekable,
+        uint64_t pointCount);
     void writePoint(const char *p);
+    void writePoints(const char *p, size_t count);
+    void writeColumns(point_columns cols, size_t count);
+    void chooseScale(const column<double>& world, size_t count, double& scale,
+        double& offset);
+    void appendRecords(const char *p, size_t count);
+    void updateBounds(const int32_t *x, const int32_t *y, const int32_t *z, size_t count);
+    uint64_t writeChunk(const std::vector<unsigned char>& data, uint32_t count);
     void updateMinMax(const las::point10& p);
     void writeHeader();
     void writeChunks();
     void writeChunkTable();
+    void setThreads(size_t threads, size_t depth);
+    void submitChunk();
+    void finishChunk();
+    chunk_builder& newBuilder();
+    void appendChunk(const std::vector<unsigned char>& data, uint32_t count,
+        const chunk_stats_vlr::entry& chunkStats);
+    void setChunkStats(bool on);
+    void finishStats();
+    void writeChunkStats();
 
     uint32_t chunk_point_num;
     uint32_t chunk_size;
@@ -65,6 +250,34 @@ struct basic_file::Private
     header14 head14;
     std::ostream *f;  // Pointer because we don't have a reference target at construction.
     std::unique_ptr<OutFileStream> stream;
+    // Output that can't be repositioned is written through 'counted' so that positions are
+    // known. The header is written on open() with the point count that's expected.
+    bool seekable;
+    std::unique_ptr<counting_buf> counter;
+    std::unique_ptr<std::ostream> counted;
+    uint64_t expected_count;
+    // VLRs written ahead of the LASzip VLR. They must be set before open() and their
+    // sizes can't change, but their contents can be updated until close().
+    std::vector<std::pair<vlr_header, std::vector<char>>> vlrs;
+    // When compressing on threads, the points of the current chunk are held in 'points'
+    // and chunks being compressed are in 'pending', oldest first. 'chunk_open' is set when
+    // a chunk has been started, as the existence of 'pcompressor' is otherwise.
+    std::unique_ptr<ThreadPool> pool;
+    size_t depth;
+    bool chunk_open;
+    std::vector<char> points;
+    std::deque<std::pair<uint32_t, std::future<std::vector<unsigned char>>>> pending;
+    // Builders for points from producer threads. 'mutex' guards the builder list and
+    // appending chunks to the file.
+    std::vector<std::unique_ptr<chunk_builder>> builders;
+    uint32_t builder_chunk_size;
+    std::mutex mutex;
+    // When 'keep_stats' is set, the statistics of each chunk are collected in 'chunk_stats'
+    // in chunk order and written as an EVLR on close. 'stats' holds those of the chunk
+    // being written with writePoint().
+    bool keep_stats;
+    chunk_stats_vlr chunk_stats;
+    chunk_stats_vlr::entry stats;
 };
 
 struct named_file::Private
@@ -80,6 +293,23 @@ struct named_file::Private
     std::ofstream file;
 };
 
+struct chunk_builder::Private
+{
+    Private(basic_file::Private *file, uint32_t chunk_size);
+
+    void writePoint(const char *p);
+    void finishChunk();
+
+    basic_file::Private *file;
+    uint32_t chunk_size;
+    uint32_t count;
+    uint64_t total;
+    box bounds;
+    chunk_stats_vlr::entry stats;
+    MemoryStream stream;
+    las_compressor::ptr pcompressor;
+};
+
 // On compressed output, the data is written in chunks. Normally the chunks are 50,000
 // points, but you can request variable sized chunking by using the value "VariableChunkSize".
 // When using variable-sized chunks, you must call newChunk() in order to start a new chunk.
@@ -98,24 +328,51 @@ struct named_file::Private
 //
 // Note that after being read, the table is fixed up to be usable when reading
 // points.
+//
+// When the output can't be repositioned, the chunk table offset is written as -1 and the
+// actual offset is written after the chunk table, at the end of the output.
 
-bool basic_file::Private::open(std::ostream& out, const header12& h, uint32_t cs)
+bool basic_file::Private::open(std::ostream& out, const header12& h, uint32_t cs,
+    bool seekable, uint64_t pointCount)
 {
     if (h.version.major != 1 || h.version.minor < 2 || h.version.minor > 4)
         return false;
+    if (!seekable)
+    {
+        // The scale can't be chosen once the header has been written.
+        if (h.scale.x == 0 || h.scale.y == 0 || h.scale.z == 0)
+            throw error("Output that can't be repositioned requires a nonzero scale.");
+        if (h.version.minor < 4 && pointCount > (std::numeric_limits<uint32_t>::max)())
+            throw error("Point count is too large for LAS version 1." +
+                std::to_string((int)h.version.minor) + ".");
+    }
 
+    this->seekable = seekable;
     f = &out;
+    if (!seekable)
+    {
+        counter.reset(new counting_buf(out.rdbuf()));
+        counted.reset(new std::ostream(counter.get()));
+        f = counted.get();
+    }
     head12 = h;
     chunk_size = cs;
+    if (!seekable)
+        head14.point_count_14 = pointCount;
     writeHeader();
+    if (!seekable)
+    {
+        expected_count = head14.point_count_14;
+        head14.point_count_14 = 0;
+    }
 
     if (compressed())
     {
         // Reserve 8 bytes for the chunk table offset.
-        const uint64_t dummy = 0;
-        out.write(reinterpret_cast<const char*>(&dummy), sizeof(uint64_t));
+        const int64_t dummy = seekable ? 0 : -1;
+        f->write(reinterpret_cast<const char*>(&dummy), sizeof(int64_t));
     }
-    stream.reset(new OutFileStream(out));
+    stream.reset(new OutFileStream(*f));
     return true;
 }
 
@@ -141,11 +398,18 @@ void basic_file::Private::updateMinMax(const las::point10& p)
 
 uint64_t basic_file::Private::newChunk()
 {
+    if (pool)
+    {
+        submitChunk();
+        return 0;
+    }
+
     pcompressor->done();
 
     uint64_t position = (uint64_t)f->tellp();
     chunks.push_back({ chunk_point_num, position });
-    pcompressor = build_las_compressor(stream->cb(), head12.pointFormat(), head12.ebCount());
+    finishStats();
+    pcompressor->reset();
     chunk_point_num = 0;
     return position;
 }
@@ -161,11 +425,29 @@ void basic_file::Private::writePoint(const char *p)
 {
     if (!compressed())
         stream->putBytes(reinterpret_cast<const unsigned char *>(p), head12.point_record_length);
+    else if (pool)
+    {
+        if (!chunk_open)
+        {
+            if (builders.size())
+                throw error("Can't write points to a file that has chunk builders.");
+            chunk_open = true;
+            chunk_point_num = 0;
+        }
+        else if ((chunk_point_num == chunk_size) && (chunk_size != VariableChunkSize))
+            submitChunk();
+
+        points.insert(points.end(), p, p + head12.point_record_length);
+        chunk_point_num++;
+        head14.point_count_14++;
+    }
     else
     {
         //ABELL - This first bit can go away if we simply always create compressor.
         if (!pcompressor)
         {
+            if (builders.size())
+                throw error("Can't write points to a file that has chunk builders.");
             pcompressor = build_las_compressor(stream->cb(), head12.pointFormat(),
                 head12.ebCount());
             chunk_point_num = 0;
@@ -178,21 +460,406 @@ void basic_file::Private::writePoint(const char *p)
         chunk_point_num++;
         head14.point_count_14++;
     }
+    if (keep_stats)
+        addStats(stats, p, head12);
     updateMinMax(*(reinterpret_cast<const las::point10*>(p)));
 }
 
+void basic_file::Private::writePoints(const char *p, size_t count)
+{
+    appendRecords(p, count);
+
+    // The bounds are computed a block at a time from the raw coordinates.
+    const size_t BlockSize = 1024;
+    const size_t len = head12.point_record_length;
+    std::vector<int32_t> xyz(3 * (std::min)(count, BlockSize));
+    while (count)
+    {
+        size_t n = (std::min)(count, BlockSize);
+        int32_t *x = xyz.data();
+        int32_t *y = x + n;
+        int32_t *z = y + n;
+        for (size_t i = 0; i < n; ++i, p += len)
+        {
+            x[i] = utils::unpack<int32_t>(p);
+            y[i] = utils::unpack<int32_t>(p + sizeof(int32_t));
+            z[i] = utils::unpack<int32_t>(p + 2 * sizeof(int32_t));
+        }
+        updateBounds(x, y, z, n);
+        count -= n;
+    }
+}
+
+void basic_file::Private::writeColumns(point_columns cols, size_t count)
+{
+    const column<int32_t> *raws[] = { &cols.x, &cols.y, &cols.z };
+    const column<double> *worlds[] = { &cols.world_x, &cols.world_y, &cols.world_z };
+    double *scales[] = { &head12.scale.x, &head12.scale.y, &head12.scale.z };
+    double *offsets[] = { &head12.offset.x, &head12.offset.y, &head12.offset.z };
+    for (int d = 0; d < 3; ++d)
+        if (*worlds[d] && *scales[d] == 0)
+            chooseScale(*worlds[d], count, *scales[d], *offsets[d]);
+
+    // Points are packed into records a block at a time.
+    const size_t BlockSize = 1024;
+    const size_t len = head12.point_record_length;
+    std::vector<char> buf((std::min)(count, BlockSize) * len);
+    std::vector<int32_t> xyz(3 * (std::min)(count, BlockSize));
+    while (count)
+    {
+        size_t n = (std::min)(count, BlockSize);
+
+        // World coordinates are quantized to the scratch space. Contiguous raw coordinate
+        // columns are used in place.
+        int32_t *v[3];
+        for (int d = 0; d < 3; ++d)
+        {
+            const column<int32_t>& raw = *raws[d];
+            const column<double>& world = *worlds[d];
+            int32_t *scratch = xyz.data() + d * n;
+            if (world)
+            {
+                if (!scale::fromDouble(world.at(0), n, world.stride, *scales[d], *offsets[d],
+                        scratch))
+                    throw error("Coordinate can't be represented with the scale and offset.");
+                v[d] = scratch;
+            }
+            else if (raw && raw.stride == sizeof(int32_t))
+                v[d] = raw.data;
+            else
+            {
+                for (size_t i = 0; i < n; ++i)
+                    scratch[i] = raw ? raw.get(i) : 0;
+                v[d] = scratch;
+            }
+        }
+
+        point_columns block(cols);
+        block.x = column<int32_t>(v[0]);
+        block.y = column<int32_t>(v[1]);
+        block.z = column<int32_t>(v[2]);
+        gather(block, n, head12.pointFormat(), head12.ebCount(), buf.data());
+        appendRecords(buf.data(), n);
+        updateBounds(v[0], v[1], v[2], n);
+        cols.advance(n);
+        count -= n;
+    }
+}
+
+// Choose a scale and offset for a dimension from the extent of the first 'count' world
+// coordinates. The scale is the power of ten nearest above 1/2^24 of the extent, which
+// leaves room for points well outside the extent. The offset is the middle of the extent
+// rounded to an integer.
+void basic_file::Private::chooseScale(const column<double>& world, size_t count,
+    double& scale, double& offset)
+{
+    double lo = (std::numeric_limits<double>::max)();
+    double hi = std::numeric_limits<double>::lowest();
+    for (size_t i = 0; i < count; ++i)
+    {
+        double d = world.get(i);
+        lo = (std::min)(lo, d);
+        hi = (std::max)(hi, d);
+    }
+    if (lo > hi)
+        return;
+    if (!std::isfinite(lo) || !std::isfinite(hi))
+        throw error("Can't choose a scale for coordinates that aren't finite.");
+
+    double extent = (std::max)(hi - lo, 1.0);
+    scale = std::pow(10.0, std::ceil(std::log10(extent / (1 << 24))));
+    offset = std::round(lo / 2 + hi / 2);
+}
+
+// Compress or write point records, starting chunks as writePoint() does.
+void basic_file::Private::appendRecords(const char *p, size_t count)
+{
+    const size_t len = head12.point_record_length;
+    if (!compressed())
+    {
+        stream->putBytes(reinterpret_cast<const unsigned char *>(p), count * len);
+        return;
+    }
+
+    while (count)
+    {
+        if (pool)
+        {
+            if (!chunk_open)
+            {
+                if (builders.size())
+                    throw error("Can't write points to a file that has chunk builders.");
+                chunk_open = true;
+                chunk_point_num = 0;
+            }
+            else if ((chunk_point_num == chunk_size) && (chunk_size != VariableChunkSize))
+                submitChunk();
+        }
+        else
+        {
+            if (!pcompressor)
+            {
+                if (builders.size())
+                    throw error("Can't write points to a file that has chunk builders.");
+                pcompressor = build_las_compressor(stream->cb(), head12.pointFormat(),
+                    head12.ebCount());
+                chunk_point_num = 0;
+            }
+            else if ((chunk_point_num == chunk_size) && (chunk_size != VariableChunkSize))
+                newChunk();
+        }
+
+        size_t n = count;
+        if (chunk_size != VariableChunkSize)
+            n = (std::min)(n, (size_t)(chunk_size - chunk_point_num));
+        if (pool)
+            points.insert(points.end(), p, p + n * len);
+        else
+            pcompressor->compressPoints(p, n);
+        if (keep_stats)
+            for (size_t i = 0; i < n; ++i)
+                addStats(stats, p + i * len, head12);
+        p += n * len;
+        count -= n;
+        chunk_point_num += (uint32_t)n;
+        head14.point_count_14 += n;
+    }
+}
+
+// Extend the header bounds to cover points with the given raw coordinates. The scaled
+// bounds are the scaled values of the raw bounds, which is exactly what scaling and
+// comparing each point gives.
+void basic_file::Private::updateBounds(const int32_t *x, const int32_t *y, const int32_t *z,
+    size_t count)
+{
+    if (!count)
+        return;
+
+    const int32_t *v[] = { x, y, z };
+    const double scales[] = { head12.scale.x, head12.scale.y, head12.scale.z };
+    const double offsets[] = { head12.offset.x, head12.offset.y, head12.offset.z };
+    double *mins[] = { &head12.minx, &head12.miny, &head12.minz };
+    double *maxs[] = { &head12.maxx, &head12.maxy, &head12.maxz };
+    for (int d = 0; d < 3; ++d)
+    {
+        int32_t lo = (std::numeric_limits<int32_t>::max)();
+        int32_t hi = (std::numeric_limits<int32_t>::min)();
+        scale::range(v[d], count, lo, hi);
+        double a = lo * scales[d] + offsets[d];
+        double b = hi * scales[d] + offsets[d];
+        *mins[d] = (std::min)(*mins[d], (std::min)(a, b));
+        *maxs[d] = (std::max)(*maxs[d], (std::max)(a, b));
+    }
+}
+
+// Write a chunk that was compressed elsewhere. Any chunk being built from points is
+// finished first. Only for use with variable-sized chunks.
+uint64_t basic_file::Private::writeChunk(const std::vector<unsigned char>& data,
+    uint32_t count)
+{
+    if (keep_stats)
+        throw error("Can't write compressed chunks to a file with chunk statistics.");
+    if (chunk_open)
+    {
+        submitChunk();
+        chunk_open = false;
+    }
+    while (pending.size())
+        finishChunk();
+    if (pcompressor)
+    {
+        pcompressor->done();
+        chunks.push_back({ chunk_point_num, (uint64_t)f->tellp() });
+        pcompressor.reset();
+    }
+    uint64_t position = (uint64_t)f->tellp();
+    f->write(reinterpret_cast<const char *>(data.data()), data.size());
+    chunks.push_back({ count, (uint64_t)f->tellp() });
+    head14.point_count_14 += count;
+    return position;
+}
+
 void basic_file::Private::close()
 {
-    if (compressed())
+    if (compressed() && builders.size())
+    {
+        for (std::unique_ptr<chunk_builder>& b : builders)
+        {
+            chunk_builder::Private& bp = *b->p_;
+            if (bp.count)
+                bp.finishChunk();
+            head12.minx = (std::min)(head12.minx, bp.bounds.min.x);
+            head12.miny = (std::min)(head12.miny, bp.bounds.min.y);
+            head12.minz = (std::min)(head12.minz, bp.bounds.min.z);
+            head12.maxx = (std::max)(head12.maxx, bp.bounds.max.x);
+            head12.maxy = (std::max)(head12.maxy, bp.bounds.max.y);
+            head12.maxz = (std::max)(head12.maxz, bp.bounds.max.z);
+            head14.point_count_14 += bp.total;
+        }
+        if (chunks.empty())
+        {
+            chunks.push_back({ 0, (uint64_t)f->tellp() });
+            finishStats();
+        }
+    }
+    else if (compressed() && pool)
+    {
+        if (chunk_open)
+            submitChunk();
+        chunk_open = false;
+        while (pending.size())
+            finishChunk();
+        if (chunks.empty())
+        {
+            chunks.push_back({ 0, (uint64_t)f->tellp() });
+            finishStats();
+        }
+    }
+    else if (compressed())
     {
         if (pcompressor)
             pcompressor->done();
-        chunks.push_back({ chunk_point_num, (uint64_t)f->tellp() });
+        if (pcompressor || chunks.empty())
+        {
+            chunks.push_back({ chunk_point_num, (uint64_t)f->tellp() });
+            finishStats();
+        }
     }
 
-    writeHeader();
     if (compressed())
         writeChunkTable();
+    if (keep_stats)
+        writeChunkStats();
+    if (seekable)
+        writeHeader();
+    else
+    {
+        f->flush();
+        if (!*f)
+            throw error("Couldn't write to the output stream.");
+        if (head14.point_count_14 != expected_count)
+            throw error("Wrote " + std::to_string(head14.point_count_14) + " points to a "
+                "stream whose header has a point count of " + std::to_string(expected_count) +
+                ".");
+    }
+}
+
+void basic_file::Private::setThreads(size_t threads, size_t depth)
+{
+    if (pcompressor || chunk_open || chunks.size() || builders.size())
+        throw error("Can't change the number of compression threads after writing points.");
+
+    pool.reset();
+    if (threads)
+    {
+        pool.reset(new ThreadPool(threads));
+        this->depth = depth ? depth : 2 * threads;
+    }
+}
+
+// Hand the points of the current chunk to the pool for compression. If enough chunks
+// are in flight, wait for the oldest and write it.
+void basic_file::Private::submitChunk()
+{
+    std::shared_ptr<std::vector<char>> buf(new std::vector<char>);
+    buf->swap(points);
+    const size_t size = head12.point_record_length;
+    const int format = head12.pointFormat();
+    const int ebCount = head12.ebCount();
+
+    std::function<std::vector<unsigned char>()> task = [buf, size, format, ebCount]()
+    {
+        chunk_compressor compressor(format, ebCount);
+        for (const char *p = buf->data(); p < buf->data() + buf->size(); p += size)
+            compressor.compress(p);
+        return compressor.done();
+    };
+    pending.push_back({ chunk_point_num, pool->async(task) });
+    // Chunks are written in the order they're submitted.
+    finishStats();
+    chunk_point_num = 0;
+    if (pending.size() >= depth)
+        finishChunk();
+}
+
+void basic_file::Private::finishChunk()
+{
+    uint32_t count = pending.front().first;
+    std::vector<unsigned char> data = pending.front().second.get();
+    pending.pop_front();
+
+    f->write(reinterpret_cast<const char *>(data.data()), data.size());
+    chunks.push_back({ count, (uint64_t)f->tellp() });
+}
+
+chunk_builder& basic_file::Private::newBuilder()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (!compressed())
+        throw error("Chunk builders can only write compressed files.");
+    if (pcompressor || chunk_open || pool)
+        throw error("Can't add a chunk builder to a file written with writePoint().");
+    // The LASzip VLR has already been written.
+    if (!seekable && chunk_size != VariableChunkSize)
+        throw error("Chunk builders writing to a stream require variable-sized chunks.");
+
+    // The chunks of the builders are interleaved, so the chunk table must hold their
+    // sizes.
+    if (!builder_chunk_size)
+    {
+        builder_chunk_size = (chunk_size == VariableChunkSize) ? DefaultChunkSize : chunk_size;
+        chunk_size = VariableChunkSize;
+    }
+    builders.emplace_back(new chunk_builder(this, builder_chunk_size));
+    return *builders.back();
+}
+
+void basic_file::Private::appendChunk(const std::vector<unsigned char>& data, uint32_t count,
+    const chunk_stats_vlr::entry& chunkStats)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    f->write(reinterpret_cast<const char *>(data.data()), data.size());
+    chunks.push_back({ count, (uint64_t)f->tellp() });
+    if (keep_stats)
+        chunk_stats.chunks.push_back(chunkStats);
+}
+
+void basic_file::Private::setChunkStats(bool on)
+{
+    if (!f)
+        throw error("Chunk statistics must be requested after the file is opened.");
+    if (pcompressor || chunk_open || chunks.size() || builders.size())
+        throw error("Can't change chunk statistics after writing points.");
+    if (on && !compressed())
+        throw error("Chunk statistics can only be written to compressed files.");
+    if (on && head14.version.minor != 4)
+        throw error("Chunk statistics require a LAS 1.4 file.");
+    if (on && !seekable)
+        throw error("Chunk statistics can't be written to a stream.");
+    keep_stats = on;
+}
+
+// Record the statistics of the chunk that was just finished and start over.
+void basic_file::Private::finishStats()
+{
+    if (keep_stats)
+    {
+        chunk_stats.chunks.push_back(stats);
+        stats = chunk_stats_vlr::entry();
+    }
+}
+
+// Append the chunk statistics EVLR to the end of the file. The header is written
+// afterward.
+void basic_file::Private::writeChunkStats()
+{
+    f->seekp(0, std::ios::end);
+    head14.evlr_offset = (uint64_t)f->tellp();
+    head14.evlr_count = 1;
+    chunk_stats.eheader().write(*f);
+    chunk_stats.write(*f);
 }
 
 void basic_file::Private::writeHeader()
@@ -216,6 +883,11 @@ void basic_file::Private::writeHeader()
     head14.header_size = head14.sizeFromVersion();
     head14.point_offset = head14.header_size;
     head14.vlr_count = 0;
+    for (auto& v : vlrs)
+    {
+        head14.point_offset += (uint32_t)(v.second.size() + vlr_header::Size);
+        head14.vlr_count++;
+    }
     if (compressed())
     {
         head14.vlr_count++;
@@ -239,7 +911,8 @@ void basic_file::Private::writeHeader()
     }
     else
         head14.point_count = (uint32_t)head14.point_count_14;
-    f->seekp(0);
+    if (seekable)
+        f->seekp(0);
     if (head14.version.minor == 2)
         head12.write(*f);
     else if (head14.version.minor == 3)
@@ -247,6 +920,11 @@ void basic_file::Private::writeHeader()
     else if (head14.version.minor == 4)
         head14.write(*f);
 
+    for (auto& v : vlrs)
+    {
+        v.first.write(*f);
+        f->write(v.second.data(), v.second.size());
+    }
     if (compressed())
     {
         // Write the VLR.
@@ -263,7 +941,8 @@ void basic_file::Private::writeHeader()
 void basic_file::Private::writeChunkTable()
 {
     // move to the end of the file to start emitting our compresed table
-    f->seekp(0, std::ios::end);
+    if (seekable)
+        f->seekp(0, std::ios::end);
 
     // take note of where we're writing the chunk table, we need this later
     int64_t chunk_table_offset = static_cast<int64_t>(f->tellp());
@@ -289,7 +968,8 @@ void basic_file::Private::writeChunkTable()
 
     compress_chunk_table(w.cb(), chunks, chunk_size == VariableChunkSize);
     // go back to where we're supposed to write chunk table offset
-    f->seekp(head12.point_offset);
+    if (seekable)
+        f->seekp(head12.point_offset);
     f->write(reinterpret_cast<char*>(&chunk_table_offset), sizeof(chunk_table_offset));
 }
 
@@ -307,7 +987,13 @@ bool basic_file::compressed() const
 
 bool basic_file::open(std::ostream& out, const header12& h, uint32_t chunk_size)
 {
-   return  p_->open(out, h, chunk_size);
+   return  p_->open(out, h, chunk_size, true, 0);
+}
+
+bool basic_file::open(std::ostream& out, const header12& h, uint32_t chunk_size,
+    bool seekable, uint64_t pointCount)
+{
+   return  p_->open(out, h, chunk_size, seekable, pointCount);
 }
 
 void basic_file::writePoint(const char *buf)
@@ -315,22 +1001,97 @@ void basic_file::writePoint(const char *buf)
     p_->writePoint(buf);
 }
 
+void basic_file::writePoints(const char *buf, size_t count)
+{
+    p_->writePoints(buf, count);
+}
+
+void basic_file::writeColumns(const point_columns& cols, size_t count)
+{
+    p_->writeColumns(cols, count);
+}
+
 uint64_t basic_file::firstChunkOffset() const
 {
     return p_->firstChunkOffset();
 }
 
+void basic_file::setThreads(size_t threads, size_t depth)
+{
+    p_->setThreads(threads, depth);
+}
+
 uint64_t basic_file::newChunk()
 {
     assert(p_->chunk_size == VariableChunkSize);
     return p_->newChunk();
 }
 
+chunk_builder& basic_file::newBuilder()
+{
+    return p_->newBuilder();
+}
+
+void basic_file::setChunkStats(bool on)
+{
+    p_->setChunkStats(on);
+}
+
 void basic_file::close()
 {
     p_->close();
 }
 
+// chunk_builder
+
+chunk_builder::Private::Private(basic_file::Private *file, uint32_t chunk_size) :
+    file(file), chunk_size(chunk_size), count(0), total(0)
+{
+    const int format = file->head12.pointFormat();
+    const int ebCount = file->head12.ebCount();
+    pcompressor = build_codec_compressor<MemoryStream&>(stream, format, ebCount);
+    if (!pcompressor)
+        pcompressor = build_las_compressor(stream.outCb(), format, ebCount);
+}
+
+void chunk_builder::Private::writePoint(const char *p)
+{
+    pcompressor->compress(p);
+
+    const las::point10& pt = *(reinterpret_cast<const las::point10*>(p));
+    const header12& h = file->head12;
+    bounds.grow(pt.x * h.scale.x + h.offset.x, pt.y * h.scale.y + h.offset.y,
+        pt.z * h.scale.z + h.offset.z);
+    if (file->keep_stats)
+        addStats(stats, p, h);
+    total++;
+    if (++count == chunk_size)
+        finishChunk();
+}
+
+// Append the chunk to the file and reset the compressor for the next one.
+void chunk_builder::Private::finishChunk()
+{
+    pcompressor->done();
+    file->appendChunk(stream.buf, count, stats);
+    stats = chunk_stats_vlr::entry();
+    stream.clear();
+    pcompressor->reset();
+    count = 0;
+}
+
+chunk_builder::chunk_builder(basic_file::Private *file, uint32_t chunk_size) :
+    p_(new Private(file, chunk_size))
+{}
+
+chunk_builder::~chunk_builder()
+{}
+
+void chunk_builder::writePoint(const char *p)
+{
+    p_->writePoint(p);
+}
+
 // named_file
 
 named_file::config::config() : scale(1.0, 1.0, 1.0), offset(0.0, 0.0, 0.0),
@@ -381,7 +1142,7 @@ void named_file::Private::open(const std::string& filename, const named_file::co
     file.open(filename, std::ios::binary | std::ios::trunc);
     if (!file.good())
         throw error("Couldn't open '" + filename + "' for writing.");
-    base->open(file, h, c.chunk_size);
+    base->open(file, h, c.chunk_size, true, 0);
 }
 
 
@@ -401,20 +1162,480 @@ void named_file::close()
         p_->file.close();
 }
 
+// stream_file
+
+stream_file::stream_file(std::ostream& out, const header12& h, uint64_t pointCount,
+    uint32_t chunk_size)
+{
+    if (!open(out, h, chunk_size, false, pointCount))
+        throw error("Can't write LAS version " + std::to_string((int)h.version.major) + "." +
+            std::to_string((int)h.version.minor) + ".");
+}
+
+stream_file::~stream_file()
+{}
+
+// copc_file
+
+namespace
+{
+
+struct NodeKey
+{
+    int32_t d;
+    int32_t x;
+    int32_t y;
+    int32_t z;
+
+    bool operator<(const NodeKey& k) const
+    {
+        if (d != k.d)
+            return d < k.d;
+        if (x != k.x)
+            return x < k.x;
+        if (y != k.y)
+            return y < k.y;
+        return z < k.z;
+    }
+};
+
+} // unnamed namespace
+
+copc_file::config::config() : scale(.01, .01, .01), offset(0, 0, 0), pdrf(6), extra_bytes(0),
+    threads(0), memory_limit(1 << 30), resolution(128), max_depth(16)
+{}
+
+copc_file::config::config(const vector3& s, const vector3& o, int pdrf) : scale(s), offset(o),
+    pdrf(pdrf), extra_bytes(0), threads(0), memory_limit(1 << 30), resolution(128),
+    max_depth(16)
+{}
+
+struct copc_file::Private
+{
+    using Base = basic_file::Private;
+
+    // Points accepted by a node. Points are held in 'points' until memory runs short,
+    // when they're appended to the node spill file. 'runs' are the offsets and point
+    // counts of the node's points in that file. 'cells' are the occupied cells of the
+    // node. If they take too much memory, they're dropped and the node is closed: it
+    // accepts no more points, which pass to its children.
+    struct Node
+    {
+        Node() : count(0), closed(false)
+        {}
+
+        std::unordered_set<uint64_t> cells;
+        std::vector<char> points;
+        std::vector<std::pair<uint64_t, uint32_t>> runs;
+        uint32_t count;
+        bool closed;
+    };
+
+    // Approximate memory used by an entry of a cell set: the value, the list link and
+    // the bucket.
+    static const size_t CellBytes = sizeof(uint64_t) + 2 * sizeof(void *) + sizeof(size_t);
+    // Input points are held in blocks of about this size, so that they can be released
+    // as they're placed in nodes.
+    static const size_t InputBlockBytes = 1 << 20;
+
+    Private(Base *b) : base(b), pointSize(0), blockPoints(0), inputBytes(0), inputCount(0),
+        nodeBytes(0), cellBytes(0),
+        nodeSpillPos(0), halfsize(0), gpsMin((std::numeric_limits<double>::max)()),
+        gpsMax(std::numeric_limits<double>::lowest())
+    {}
+
+    ~Private()
+    {
+        removeTemps();
+    }
+
+    void open(const std::string& filename, const copc_file::config& c);
+    void writePoint(const char *p);
+    void close();
+    void flushInput();
+    void assign(const char *p);
+    void spillNodes();
+    void closeNodes();
+    void writeNodes();
+    void removeTemps();
+
+    Base *base;
+    copc_file::config cfg;
+    std::ofstream file;
+    size_t pointSize;
+    size_t blockPoints;
+    std::deque<std::vector<char>> input;
+    size_t inputBytes;
+    std::string inputSpillName;
+    std::fstream inputSpill;
+    uint64_t inputCount;
+    std::map<NodeKey, Node> nodes;
+    size_t nodeBytes;
+    size_t cellBytes;
+    std::string nodeSpillName;
+    std::ofstream nodeSpill;
+    uint64_t nodeSpillPos;
+    std::vector<copc_entry> entries;
+    vector3 center;
+    double halfsize;
+    double gpsMin;
+    double gpsMax;
+};
+
+void copc_file::Private::open(const std::string& filename, const copc_file::config& c)
+{
+    if (c.pdrf < 6 || c.pdrf > 8)
+        throw error("COPC files must use point format 6, 7 or 8.");
+    if (c.resolution < 1 || c.max_depth < 0)
+        throw error("Invalid COPC resolution or maximum depth.");
+
+    cfg = c;
+    if (cfg.threads == 0)
+        cfg.threads = (std::max)(std::thread::hardware_concurrency(), 1u);
+
+    named_file::config nc(c.scale, c.offset, VariableChunkSize);
+    nc.pdrf = c.pdrf;
+    nc.minor_version = 4;
+    nc.extra_bytes = c.extra_bytes;
+    header12 h = nc.to_header();
+    pointSize = h.point_record_length;
+    blockPoints = (std::max)((size_t)1, InputBlockBytes / pointSize);
+
+    inputSpillName = filename + ".input.tmp";
+    nodeSpillName = filename + ".nodes.tmp";
+
+    file.open(filename, std::ios::binary | std::ios::trunc);
+    if (!file.good())
+        throw error("Couldn't open '" + filename + "' for writing.");
+
+    // The COPC info VLR must be the first VLR. It's rewritten on close.
+    copc_info_vlr info;
+    base->vlrs.push_back({ info.header(), info.data() });
+    base->open(file, h, VariableChunkSize, true, 0);
+}
+
+void copc_file::Private::writePoint(const char *p)
+{
+    base->updateMinMax(*(reinterpret_cast<const las::point10*>(p)));
+
+    double gpsTime;
+    memcpy(&gpsTime, p + 22, sizeof(gpsTime));
+    gpsMin = (std::min)(gpsMin, gpsTime);
+    gpsMax = (std::max)(gpsMax, gpsTime);
+
+    if (input.empty() || input.back().size() >= blockPoints * pointSize)
+    {
+        input.emplace_back();
+        input.back().reserve(blockPoints * pointSize);
+    }
+    input.back().insert(input.back().end(), p, p + pointSize);
+    inputBytes += pointSize;
+    inputCount++;
+    // At most half the limit is held, so that at least half is left for the nodes when
+    // the points are placed.
+    if (inputBytes >= cfg.memory_limit / 2)
+        flushInput();
+}
+
+void copc_file::Private::flushInput()
+{
+    if (!inputSpill.is_open())
+    {
+        inputSpill.open(inputSpillName, std::ios::binary | std::ios::in | std::ios::out |
+            std::ios::trunc);
+        if (!inputSpill.good())
+            throw error("Couldn't open '" + inputSpillName + "' for writing.");
+    }
+    for (const std::vector<char>& block : input)
+        inputSpill.write(block.data(), block.size());
+    if (!inputSpill.good())
+        throw error("Couldn't write to '" + inputSpillName + "'.");
+    input.clear();
+    inputBytes = 0;
+}
+
+// Place a point in the shallowest node that has no point in the point's cell.
+void copc_file::Private::assign(const char *p)
+{
+    const las::point10& pt = *(reinterpret_cast<const las::point10*>(p));
+    const header12& h = base->head12;
+    double pos[3] {
+        pt.x * h.scale.x + h.offset.x - (center.x - halfsize),
+        pt.y * h.scale.y + h.offset.y - (center.y - halfsize),
+        pt.z * h.scale.z + h.offset.z - (center.z - halfsize)
+    };
+
+    for (int32_t d = 0; d <= cfg.max_depth; ++d)
+    {
+        // Cell coordinates at a resolution of 'cells' across the whole cube. The node is
+        // the cell coordinates divided by the node resolution.
+        const double cells = std::ldexp((double)cfg.resolution, d);
+        const int64_t limit = (int64_t)cells - 1;
+        int64_t c[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            c[i] = (int64_t)std::floor(pos[i] / (2 * halfsize) * cells);
+            c[i] = (std::max)((int64_t)0, (std::min)(c[i], limit));
+        }
+        NodeKey key { d, (int32_t)(c[0] / cfg.resolution), (int32_t)(c[1] / cfg.resolution),
+            (int32_t)(c[2] / cfg.resolution) };
+        Node& node = nodes[key];
+        if (d < cfg.max_depth)
+        {
+            if (node.closed)
+                continue;
+            uint64_t cell = ((uint64_t)(c[0] % cfg.resolution) << 40) |
+                ((uint64_t)(c[1] % cfg.resolution) << 20) | (uint64_t)(c[2] % cfg.resolution);
+            if (!node.cells.insert(cell).second)
+                continue;
+            cellBytes += CellBytes;
+        }
+        node.points.insert(node.points.end(), p, p + pointSize);
+        node.count++;
+        nodeBytes += pointSize;
+        // Input that hasn't been placed yet counts against the limit too.
+        if (nodeBytes + cellBytes + inputBytes >= cfg.memory_limit)
+        {
+            spillNodes();
+            if (cellBytes + inputBytes >= cfg.memory_limit / 2)
+                closeNodes();
+        }
+        return;
+    }
+}
+
+void copc_file::Private::spillNodes()
+{
+    if (!nodeSpill.is_open())
+    {
+        nodeSpill.open(nodeSpillName, std::ios::binary | std::ios::trunc);
+        if (!nodeSpill.good())
+            throw error("Couldn't open '" + nodeSpillName + "' for writing.");
+    }
+    for (auto& n : nodes)
+    {
+        Node& node = n.second;
+        if (node.points.empty())
+            continue;
+        nodeSpill.write(node.points.data(), node.points.size());
+        node.runs.push_back({ nodeSpillPos, (uint32_t)(node.points.size() / pointSize) });
+        nodeSpillPos += node.points.size();
+        std::vector<char>().swap(node.points);
+    }
+    if (!nodeSpill.good())
+        throw error("Couldn't write to '" + nodeSpillName + "'.");
+    nodeBytes = 0;
+}
+
+// Drop the cells of the nodes with the most occupied cells until the cells use at most
+// a quarter of the memory limit. The nodes are closed to further points.
+void copc_file::Private::closeNodes()
+{
+    std::vector<Node *> open;
+    for (auto& n : nodes)
+        if (n.second.cells.size())
+            open.push_back(&n.second);
+    std::sort(open.begin(), open.end(),
+        [](const Node *a, const Node *b){ return a->cells.size() > b->cells.size(); });
+    for (Node *node : open)
+    {
+        if (cellBytes <= cfg.memory_limit / 4)
+            break;
+        cellBytes -= node->cells.size() * CellBytes;
+        std::unordered_set<uint64_t>().swap(node->cells);
+        node->closed = true;
+    }
+}
+
+// Compress the nodes in parallel and write them in key order, so that shallower nodes
+// come first. The number of nodes in flight is bounded to limit memory use.
+void copc_file::Private::writeNodes()
+{
+    if (nodeSpill.is_open())
+        nodeSpill.close();
+
+    using Data = std::vector<unsigned char>;
+    ThreadPool pool(cfg.threads);
+    std::deque<std::pair<NodeKey, std::future<Data>>> pending;
+    const int format = base->head12.pointFormat();
+    const int ebCount = base->head12.ebCount();
+
+    auto finish = [this, &pending]()
+    {
+        NodeKey key = pending.front().first;
+        Data data = pending.front().second.get();
+        uint32_t count = (uint32_t)nodes[key].count;
+        pending.pop_front();
+
+        uint64_t offset = base->writeChunk(data, count);
+        entries.push_back({ key.d, key.x, key.y, key.z, offset, (int32_t)data.size(),
+            (int32_t)count });
+    };
+
+    for (auto& n : nodes)
+    {
+        Node& node = n.second;
+        std::shared_ptr<std::vector<char>> points(new std::vector<char>);
+        points->swap(node.points);
+        std::unordered_set<uint64_t>().swap(node.cells);
+        std::vector<std::pair<uint64_t, uint32_t>> runs(node.runs);
+        std::string spillName(nodeSpillName);
+        size_t size(pointSize);
+
+        std::function<Data()> task = [points, runs, spillName, size, format, ebCount]()
+        {
+            chunk_compressor compressor(format, ebCount);
+            if (runs.size())
+            {
+                std::ifstream in(spillName, std::ios::binary);
+                std::vector<char> buf;
+                for (auto& r : runs)
+                {
+                    buf.resize(r.second * size);
+                    in.seekg(r.first);
+                    in.read(buf.data(), buf.size());
+                    if (!in.good())
+                        throw error("Couldn't read from '" + spillName + "'.");
+                    for (const char *p = buf.data(); p < buf.data() + buf.size(); p += size)
+                        compressor.compress(p);
+                }
+            }
+            for (const char *p = points->data(); p < points->data() + points->size(); p += size)
+                compressor.compress(p);
+            return compressor.done();
+        };
+        pending.push_back({ n.first, pool.async(task) });
+        if (pending.size() >= 2 * cfg.threads)
+            finish();
+    }
+    while (pending.size())
+        finish();
+}
+
+void copc_file::Private::close()
+{
+    header14& h = base->head14;
+    if (inputCount)
+    {
+        center = vector3((h.minx + h.maxx) / 2, (h.miny + h.maxy) / 2, (h.minz + h.maxz) / 2);
+        halfsize = (std::max)({ h.maxx - h.minx, h.maxy - h.miny, h.maxz - h.minz }) / 2;
+        if (halfsize <= 0)
+            halfsize = 1;
+
+        // Points that were spilled were written first.
+        if (inputSpill.is_open())
+        {
+            inputSpill.seekg(0);
+            std::vector<char> buf;
+            uint64_t remaining = inputCount - inputBytes / pointSize;
+            while (remaining)
+            {
+                size_t count = (size_t)(std::min)((uint64_t)blockPoints, remaining);
+                buf.resize(count * pointSize);
+                inputSpill.read(buf.data(), buf.size());
+                if (!inputSpill.good())
+                    throw error("Couldn't read from '" + inputSpillName + "'.");
+                for (const char *p = buf.data(); p < buf.data() + buf.size(); p += pointSize)
+                    assign(p);
+                remaining -= count;
+            }
+            inputSpill.close();
+        }
+        // Each block of the points still in memory is released once its points are placed.
+        while (input.size())
+        {
+            const std::vector<char>& block = input.front();
+            for (const char *p = block.data(); p < block.data() + block.size(); p += pointSize)
+                assign(p);
+            inputBytes -= block.size();
+            input.pop_front();
+        }
+        writeNodes();
+    }
+    else
+        entries.push_back({ 0, 0, 0, 0, 0, 0, 0 });
+    base->close();
+
+    // Append the hierarchy as a single page.
+    file.seekp(0, std::ios::end);
+    uint64_t evlrOffset = (uint64_t)file.tellp();
+    evlr_header eh { 0, "copc", 1000, entries.size() * copc_entry::Size, "EPT hierarchy" };
+    eh.write(file);
+    for (const copc_entry& e : entries)
+    {
+        std::vector<char> d = e.data();
+        file.write(d.data(), d.size());
+    }
+
+    copc_info_vlr info;
+    info.center_x = center.x;
+    info.center_y = center.y;
+    info.center_z = center.z;
+    info.halfsize = halfsize;
+    info.spacing = 2 * halfsize / cfg.resolution;
+    info.root_hier_offset = evlrOffset + evlr_header::Size;
+    info.root_hier_size = eh.data_length;
+    info.gpstime_minimum = inputCount ? gpsMin : 0;
+    info.gpstime_maximum = inputCount ? gpsMax : 0;
+    base->vlrs[0].second = info.data();
+    h.evlr_offset = evlrOffset;
+    h.evlr_count = 1;
+    base->writeHeader();
+
+    file.close();
+    if (!file)
+        throw error("Couldn't write COPC file.");
+    removeTemps();
+}
+
+void copc_file::Private::removeTemps()
+{
+    if (inputSpill.is_open())
+        inputSpill.close();
+    if (nodeSpill.is_open())
+        nodeSpill.close();
+    if (inputSpillName.size())
+        std::remove(inputSpillName.c_str());
+    if (nodeSpillName.size())
+        std::remove(nodeSpillName.c_str());
+}
+
+copc_file::copc_file(const std::string& filename, const copc_file::config& c) :
+    p_(new Private(basic_file::p_.get()))
+{
+    p_->open(filename, c);
+}
+
+copc_file::~copc_file()
+{}
+
+void copc_file::writePoint(const char *p)
+{
+    p_->writePoint(p);
+}
+
+void copc_file::close()
+{
+    p_->close();
+}
+
 // Chunk compressor
 
 struct chunk_compressor::Private
 {
-    las_compressor::ptr pcompressor;
     MemoryStream stream;
+    las_compressor::ptr pcompressor;
 };
 
 chunk_compressor::~chunk_compressor()
 {}
 
+// Formats 0 through 3 write to the memory stream directly.
 chunk_compressor::chunk_compressor(int format, int ebCount) : p_(new Private)
 {
-    p_->pcompressor = build_las_compressor(p_->stream.outCb(), format, ebCount);
+    p_->pcompressor = build_codec_compressor<MemoryStream&>(p_->stream, format, ebCount);
+    if (!p_->pcompressor)
+        p_->pcompressor = build_las_compressor(p_->stream.outCb(), format, ebCount);
 }
 
 void chunk_compressor::compress(const char *inbuf)
@@ -24,7 +24,10 @@
 #pragma once
 
 #include <memory>
+#include <string>
+#include <vector>
 
+#include "columns.hpp"
 #include "header.hpp"
 
 namespace lazperf
@@ -32,6 +35,8 @@ namespace lazperf
 namespace writer
 {
 
+class chunk_builder;
+
 class basic_file
 {
 protected:
@@ -42,13 +47,72 @@ protected:
 
 public:
     LAZPERF_EXPORT bool open(std::ostream& out, const header12& h, uint32_t chunk_size);
+    // If 'seekable' is false, the output is never repositioned, so it can be a pipe or a
+    // socket. The header is written by open() and isn't updated, so the bounds and a
+    // nonzero scale must be set in 'h' and 'pointCount' is the number of points that will
+    // be written (h.point_count is ignored). close() throws if a different number of points
+    // is written. The chunk table offset is written as -1 and the actual offset is written
+    // at the end of the output. Chunk statistics aren't available. 'pointCount' is ignored
+    // if 'seekable' is true.
+    LAZPERF_EXPORT bool open(std::ostream& out, const header12& h, uint32_t chunk_size,
+        bool seekable, uint64_t pointCount);
     LAZPERF_EXPORT void writePoint(const char *p);
+    // Write 'count' consecutive point records.
+    LAZPERF_EXPORT void writePoints(const char *p, size_t count);
+    // Write 'count' points from columns (see columns.hpp), starting at index 0 of each.
+    // Empty columns are written as zero. World coordinate columns are used in place of the
+    // raw coordinate columns and are quantized with the header scale and offset. If the
+    // scale of a dimension is zero, its scale and offset are chosen from the extent of the
+    // first world coordinates written. Throws if a coordinate doesn't fit. The local
+    // coordinate columns are ignored.
+    LAZPERF_EXPORT void writeColumns(const point_columns& cols, size_t count);
     LAZPERF_EXPORT void close();
     LAZPERF_EXPORT uint64_t newChunk();
     LAZPERF_EXPORT uint64_t firstChunkOffset() const;
     LAZPERF_EXPORT virtual bool compressed() const;
+    // Compress chunks on 'threads' worker threads. The points of each chunk are buffered
+    // and the chunk is compressed once it's full. At most 'depth' chunks are in flight
+    // (default is twice the number of threads) and they're written in order, so the output
+    // is the same as when compressing on the calling thread. Since chunks are written after
+    // they're compressed, newChunk() returns zero. Zero threads returns to compressing on
+    // the calling thread. Must be called before any points are written.
+    LAZPERF_EXPORT void setThreads(size_t threads, size_t depth = 0);
+    // Get a builder that accepts points from a single producer thread (see chunk_builder).
+    // Can be called from any thread, but points can't also be written with writePoint().
+    LAZPERF_EXPORT chunk_builder& newBuilder();
+    // Collect the bounds, GPS time range, classifications and return counts of the points
+    // of each chunk and write them as an EVLR (see chunk_stats_vlr) on close(). Readers
+    // use them to prune queries without decoding. Only for compressed LAS 1.4 files. Must
+    // be called after open() and before any points are written.
+    LAZPERF_EXPORT void setChunkStats(bool on = true);
 
 protected:
+    friend class chunk_builder;
+
+    std::unique_ptr<Private> p_;
+};
+
+// Compresses points written by one thread into chunks and appends each chunk to the file
+// as soon as it's full. The chunks of different builders are interleaved in the order they
+// complete, so the file uses variable-sized chunks whose size is at most the file's chunk
+// size (or the default if it's variable). When the file is closed, each builder's last
+// chunk is written and its bounds and point count are added to the header. Builders
+// belong to the file and all writing must be done before it's closed.
+class chunk_builder
+{
+    struct Private;
+    friend class basic_file;
+
+    chunk_builder(basic_file::Private *file, uint32_t chunk_size);
+
+public:
+    LAZPERF_EXPORT ~chunk_builder();
+    LAZPERF_EXPORT void writePoint(const char *p);
+
+private:
+    chunk_builder(const chunk_builder&) = delete;
+    chunk_builder& operator=(const chunk_builder&) = delete;
+
     std::unique_ptr<Private> p_;
 };
 
@@ -84,6 +148,55 @@ private:
     std::unique_ptr<Private> p_;
 };
 
+// A file written to an output that can't be repositioned (see basic_file::open()).
+class stream_file : public basic_file
+{
+public:
+    LAZPERF_EXPORT stream_file(std::ostream& out, const header12& h, uint64_t pointCount,
+        uint32_t chunk_size = DefaultChunkSize);
+    LAZPERF_EXPORT virtual ~stream_file();
+};
+
+// A COPC (cloud-optimized point cloud) file. Points can be written in any order. They're
+// held until close(), when they're sorted into an octree on the calling thread and the
+// nodes are compressed in parallel. Point data past the memory limit is spilled to temporary
+// files next to the output file.
+class copc_file : public basic_file
+{
+    struct Private;
+
+public:
+    struct LAZPERF_EXPORT config
+    {
+    public:
+        vector3 scale;
+        vector3 offset;
+        int pdrf;  // Must be 6, 7 or 8.
+        int extra_bytes;
+        size_t threads;  // Zero means use the number of hardware threads.
+        // Approximate limit, in bytes, of the point data and the cell occupancy held in
+        // memory. When the occupancy of the nodes takes too much, the fullest nodes are
+        // closed to further points, which pass to deeper nodes.
+        size_t memory_limit;
+        // A node keeps at most one point in each cell of a resolution^3 grid over its
+        // bounds. Points that don't fit are passed to its children.
+        int resolution;
+        int max_depth;  // Nodes at this depth keep all the points that reach them.
+
+        config();
+        config(const vector3& scale, const vector3& offset, int pdrf);
+    };
+
+    LAZPERF_EXPORT copc_file(const std::string& filename, const config& c);
+    LAZPERF_EXPORT virtual ~copc_file();
+
+    LAZPERF_EXPORT void writePoint(const char *p);
+    LAZPERF_EXPORT void close();
+
+private:
+    std::unique_ptr<Private> p_;
+};
+
 class chunk_compressor
 {
     struct Private;
@@ -30,8 +30,15 @@
 #pragma GCC diagnostic ignored "-Wfloat-equal"
 #endif
 
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <iterator>
 #include <memory>
 #include <random>
+#include <sstream>
+#include <thread>
 
 #include "test_main.hpp"
 
@@ -67,6 +74,13 @@ std::string makeTempFileName()
     return filename;
 }
 
+std::vector<char> readFile(const std::string& filename)
+{
+    std::ifstream in(filename, std::ios::binary);
+    return std::vector<char>((std::istreambuf_iterator<char>(in)),
+        std::istreambuf_iterator<char>());
+}
+
 TEST(io_tests, io_structs_are_of_correct_size)
 {
     EXPECT_EQ(header12::Size, 227u);
@@ -287,6 +301,35 @@ void encode(const std::string& lasFilename, const std::string& lazFilename)
     f.close();
 }
 
+// Write a compressed 1.4 file whose points are random bits that change a little from
+// point to point.
+void makeRandom14(const std::string& filename, int pdrf, int ebCount, size_t count,
+    uint32_t chunkSize = DefaultChunkSize)
+{
+    writer::named_file::config c;
+    c.minor_version = 4;
+    c.pdrf = pdrf;
+    c.extra_bytes = ebCount;
+    c.chunk_size = chunkSize;
+    writer::named_file f(filename, c);
+
+    std::mt19937 gen(1234);
+    std::vector<char> buf(baseCount(pdrf) + ebCount);
+    for (char& c : buf)
+        c = (char)std::uniform_int_distribution<>(0, 255)(gen);
+    std::uniform_int_distribution<size_t> dist(0, buf.size() * 8 - 1);
+    for (size_t i = 0; i < count; ++i)
+    {
+        for (size_t j = 0; j < 3; ++j)
+        {
+            size_t bit = dist(gen);
+            buf[bit / 8] ^= (1 << (bit % 8));
+        }
+        f.writePoint(buf.data());
+    }
+    f.close();
+}
+
 TEST(io_tests, decodes_single_chunk_files_correctly)
 {
     compare(testFile("point10.las.laz"), testFile("point10.las"));
@@ -395,6 +438,907 @@ TEST(io_tests, can_decode_large_files)
     }
 }
 
+TEST(io_tests, can_decode_with_threads)
+{
+    checkExists(testFile("autzen_trim.laz"));
+
+    auto test = [](size_t threads, size_t depth)
+    {
+        reader::named_file f1(testFile("autzen_trim.laz"));
+        reader::named_file f2(testFile("autzen_trim.laz"));
+        f2.setThreads(threads, depth);
+
+        size_t pointCount = f1.pointCount();
+        size_t pointLen = f1.header().point_record_length;
+        std::vector<char> b1(pointLen);
+        std::vector<char> b2(pointLen);
+        for (size_t i = 0; i < pointCount; ++i)
+        {
+            f1.readPoint(b1.data());
+            f2.readPoint(b2.data());
+            ASSERT_EQ(b1, b2) << "Point " << i << " differs with " << threads << " threads.";
+        }
+        EXPECT_THROW(f2.readPoint(b2.data()), error);
+    };
+
+    test(1, 1);
+    test(2, 0);
+    test(4, 2);
+    test(8, 16);
+
+    // Switch between threaded and unthreaded decoding part way through.
+    reader::named_file f1(testFile("autzen_trim.laz"));
+    reader::named_file f2(testFile("autzen_trim.laz"));
+    size_t pointLen = f1.header().point_record_length;
+    std::vector<char> b1(pointLen);
+    std::vector<char> b2(pointLen);
+    for (size_t i = 0; i < f1.pointCount(); ++i)
+    {
+        if (i == 1000)
+            f2.setThreads(3);
+        else if (i == 70000)
+            f2.setThreads(0);
+        else if (i == 80000)
+            f2.setThreads(2);
+        f1.readPoint(b1.data());
+        f2.readPoint(b2.data());
+        ASSERT_EQ(b1, b2) << "Point " << i << " differs.";
+    }
+}
+
+TEST(io_tests, can_read_points_in_bulk)
+{
+    auto test = [](const std::string& filename, size_t threads, size_t batch)
+    {
+        reader::named_file f1(testFile(filename));
+        reader::named_file f2(testFile(filename));
+        f2.setThreads(threads);
+
+        size_t pointCount = f1.pointCount();
+        size_t pointLen = f1.header().point_record_length;
+        std::vector<char> b1(pointLen * batch);
+        std::vector<char> b2(pointLen * batch);
+        size_t total = 0;
+        while (size_t cnt = f2.readPoints(b2.data(), batch))
+        {
+            ASSERT_TRUE(cnt == batch || total + cnt == pointCount);
+            for (size_t i = 0; i < cnt; ++i)
+                f1.readPoint(b1.data() + i * pointLen);
+            ASSERT_TRUE(std::equal(b1.begin(), b1.begin() + cnt * pointLen, b2.begin())) <<
+                filename << ": batch at point " << total << " differs.";
+            total += cnt;
+        }
+        EXPECT_EQ(total, pointCount);
+    };
+
+    for (size_t threads : { 0, 2 })
+        for (size_t batch : { 1, 777, 50000, 200000 })
+        {
+            test("autzen_trim.laz", threads, batch);
+            test("point10.las.laz", threads, batch);
+        }
+    test("autzen_trim.las", 0, 777);
+}
+
+TEST(io_tests, can_read_mmap_file)
+{
+    auto test = [](const std::string& filename, size_t threads)
+    {
+        reader::named_file f1(testFile(filename));
+        reader::mmap_file f2(testFile(filename));
+        f2.setThreads(threads);
+
+        size_t pointCount = f1.pointCount();
+        EXPECT_EQ(pointCount, f2.pointCount());
+        size_t pointLen = f1.header().point_record_length;
+        std::vector<char> b1(pointLen * 1000);
+        std::vector<char> b2(pointLen * 1000);
+        for (size_t i = 0; i < pointCount; i += 1000)
+        {
+            size_t cnt = f1.readPoints(b1.data(), 1000);
+            ASSERT_EQ(cnt, f2.readPoints(b2.data(), 1000));
+            ASSERT_EQ(b1, b2) << filename << ": batch at point " << i << " differs.";
+        }
+
+        f1.seek(pointCount / 2 + 7);
+        f2.seek(pointCount / 2 + 7);
+        f1.readPoint(b1.data());
+        f2.readPoint(b2.data());
+        EXPECT_EQ(b1, b2);
+    };
+
+    for (size_t threads : { 0, 2 })
+    {
+        test("autzen_trim.laz", threads);
+        test("point10.las.laz", threads);
+        test("extrabytes.laz", threads);
+    }
+    test("autzen_trim.las", 0);
+
+    EXPECT_THROW(reader::mmap_file f(testFile("does-not-exist.laz")), error);
+}
+
+TEST(io_tests, can_select_layers)
+{
+    // Clear the fields of the layers that aren't selected.
+    auto clear = [](char *buf, int pdrf, int ebCount, uint32_t layers)
+    {
+        las::point14& p = *reinterpret_cast<las::point14 *>(buf);
+        if (!(layers & layer::Z))
+            p.setZ(0);
+        if (!(layers & layer::Classification))
+            p.setClassification(0);
+        if (!(layers & layer::Flags))
+        {
+            p.setClassFlags(0);
+            p.setScanDirFlag(0);
+            p.setEofFlag(0);
+        }
+        if (!(layers & layer::Intensity))
+            p.setIntensity(0);
+        if (!(layers & layer::ScanAngle))
+            p.setScanAngle(0);
+        if (!(layers & layer::UserData))
+            p.setUserData(0);
+        if (!(layers & layer::PointSourceId))
+            p.setPointSourceID(0);
+        if (!(layers & layer::GpsTime))
+            p.setGpsTime(0);
+        buf += sizeof(las::point14);
+        if (pdrf >= 7)
+        {
+            if (!(layers & layer::Rgb))
+                std::fill(buf, buf + sizeof(las::rgb14), 0);
+            buf += sizeof(las::rgb14);
+        }
+        if (pdrf == 8)
+        {
+            if (!(layers & layer::Nir))
+                std::fill(buf, buf + sizeof(las::nir14), 0);
+            buf += sizeof(las::nir14);
+        }
+        for (int i = 0; i < ebCount; ++i)
+            if (!layer::byteSelected(layers, i))
+                buf[i] = 0;
+    };
+
+    const int ebCount = 3;
+    const uint32_t selections[] = { 0, layer::Z | layer::Classification,
+        layer::GpsTime | layer::ScanAngle | layer::PointSourceId,
+        layer::Rgb | layer::Nir | (layer::Byte0 << 1), layer::All & ~layer::Flags };
+    for (int pdrf : { 6, 7, 8 })
+    {
+        std::string filename(makeTempFileName());
+        makeRandom14(filename, pdrf, ebCount, 25000, 10000);
+
+        for (uint32_t layers : selections)
+            for (size_t threads : { 0, 2 })
+            {
+                reader::named_file f1(filename);
+                reader::named_file f2(filename);
+                f2.setLayers(layers);
+                f2.setThreads(threads);
+
+                size_t pointLen = f1.header().point_record_length;
+                std::vector<char> b1(pointLen);
+                std::vector<char> b2(pointLen);
+                for (size_t i = 0; i < f1.pointCount(); ++i)
+                {
+                    f1.readPoint(b1.data());
+                    f2.readPoint(b2.data());
+                    clear(b1.data(), pdrf, ebCount, layers);
+                    ASSERT_EQ(b1, b2) << "Point " << i << " differs. PDRF = " << pdrf <<
+                        ", layers = " << std::to_string(layers) << ".";
+                }
+            }
+    }
+}
+
+TEST(io_tests, can_seek)
+{
+    checkExists(testFile("autzen_trim.laz"));
+    checkExists(testFile("autzen_trim.las"));
+
+    // Read all the points from the uncompressed file so that we can compare.
+    test::reader fin(testFile("autzen_trim.las"));
+    size_t pointLen = fin.size_;
+    std::vector<char> all(fin.count_ * pointLen);
+    for (size_t i = 0; i < fin.count_; ++i)
+        fin.record(all.data() + i * pointLen);
+
+    auto check = [&](reader::basic_file& f, uint64_t idx, size_t count)
+    {
+        std::vector<char> buf(pointLen);
+        f.seek(idx);
+        for (size_t i = 0; i < count; ++i)
+        {
+            f.readPoint(buf.data());
+            ASSERT_TRUE(std::equal(buf.begin(), buf.end(), all.data() + (idx + i) * pointLen)) <<
+                "Point " << (idx + i) << " differs.";
+        }
+    };
+
+    for (size_t threads : { 0, 3 })
+    {
+        reader::named_file f(testFile("autzen_trim.laz"));
+        f.setThreads(threads);
+        check(f, 60000, 10);
+        check(f, 5, 10);
+        check(f, 49995, 10);
+        check(f, 0, 1);
+        check(f, 109999, 1);
+        check(f, 100000, 10);
+        EXPECT_THROW(f.seek(110001), error);
+
+        ASSERT_EQ(f.chunkCount(), 3u);
+        EXPECT_EQ(f.chunkPointCount(0), 50000u);
+        EXPECT_EQ(f.chunkPointCount(1), 50000u);
+        EXPECT_EQ(f.chunkPointCount(2), 10000u);
+        EXPECT_THROW(f.chunkPointCount(3), error);
+        EXPECT_THROW(f.readChunk(3, nullptr), error);
+
+        std::vector<char> buf(f.chunkPointCount(1) * pointLen);
+        f.readChunk(1, buf.data());
+        EXPECT_TRUE(std::equal(buf.begin(), buf.end(), all.data() + 50000 * pointLen));
+        check(f, 100000, 10);
+    }
+
+    // Uncompressed files seek directly.
+    reader::named_file f(testFile("autzen_trim.las"));
+    check(f, 76543, 10);
+    check(f, 12, 10);
+}
+
+TEST(io_tests, can_read_ahead)
+{
+    checkExists(testFile("autzen_trim.laz"));
+    checkExists(testFile("autzen_trim.las"));
+
+    test::reader fin(testFile("autzen_trim.las"));
+    size_t pointLen = fin.size_;
+    std::vector<char> all(fin.count_ * pointLen);
+    for (size_t i = 0; i < fin.count_; ++i)
+        fin.record(all.data() + i * pointLen);
+
+    for (const char *name : { "autzen_trim.laz", "autzen_trim.las" })
+    {
+        reader::named_file f(testFile(name));
+        f.setReadAhead(4096, 3);
+
+        // Read part of the file, look at a VLR, then read the rest and seek around.
+        std::vector<char> buf(all.size());
+        EXPECT_EQ(f.readPoints(buf.data(), 30000), 30000u);
+        EXPECT_FALSE(f.vlrData("LASF_Projection", 34735).empty());
+        EXPECT_EQ(f.readPoints(buf.data() + 30000 * pointLen, fin.count_), fin.count_ - 30000);
+        EXPECT_TRUE(buf == all);
+
+        f.seek(76543);
+        f.readPoints(buf.data(), 1000);
+        EXPECT_TRUE(std::equal(buf.begin(), buf.begin() + 1000 * pointLen,
+            all.data() + 76543 * pointLen));
+
+        // Return to reading on this thread.
+        f.setReadAhead(0, 0);
+        f.readPoints(buf.data(), 1000);
+        EXPECT_TRUE(std::equal(buf.begin(), buf.begin() + 1000 * pointLen,
+            all.data() + 77543 * pointLen));
+    }
+}
+
+namespace
+{
+
+// Count the reads of another source.
+class counting_source : public range_source
+{
+public:
+    counting_source(std::shared_ptr<range_source> source) : reads(0), source_(source)
+    {}
+
+    virtual uint64_t size() const
+    { return source_->size(); }
+    virtual void read(uint64_t offset, size_t len, char *dst)
+    {
+        reads++;
+        source_->read(offset, len, dst);
+    }
+
+    std::atomic<int> reads;
+
+private:
+    std::shared_ptr<range_source> source_;
+};
+
+} // unnamed namespace
+
+TEST(io_tests, can_read_from_source)
+{
+    checkExists(testFile("autzen_trim.laz"));
+    checkExists(testFile("autzen_trim.las"));
+
+    test::reader fin(testFile("autzen_trim.las"));
+    size_t pointLen = fin.size_;
+    std::vector<char> all(fin.count_ * pointLen);
+    for (size_t i = 0; i < fin.count_; ++i)
+        fin.record(all.data() + i * pointLen);
+
+    std::ifstream in(testFile("autzen_trim.laz"), std::ios::binary);
+    std::vector<char> contents((std::istreambuf_iterator<char>(in)),
+        std::istreambuf_iterator<char>());
+
+    // Adjacent missing blocks are read together and cached blocks aren't read again.
+    std::shared_ptr<counting_source> counter(
+        new counting_source(std::make_shared<file_source>(testFile("autzen_trim.laz"))));
+    cached_source cache(counter, 100, 10);
+    std::vector<char> buf(450);
+    cache.read(50, 200, buf.data());
+    EXPECT_EQ(counter->reads, 1);
+    EXPECT_TRUE(std::equal(buf.begin(), buf.begin() + 200, contents.begin() + 50));
+    cache.read(120, 100, buf.data());
+    EXPECT_EQ(counter->reads, 1);
+    EXPECT_TRUE(std::equal(buf.begin(), buf.begin() + 100, contents.begin() + 120));
+    cache.read(0, 450, buf.data());
+    EXPECT_EQ(counter->reads, 2);
+    EXPECT_TRUE(std::equal(buf.begin(), buf.end(), contents.begin()));
+    buf.resize(1000);
+    cache.read(10000, 1000, buf.data());  // Larger than half the cache.
+    EXPECT_EQ(counter->reads, 3);
+    EXPECT_THROW(cache.read(contents.size() - 10, 20, buf.data()), error);
+
+    std::vector<std::shared_ptr<range_source>> sources {
+        std::make_shared<file_source>(testFile("autzen_trim.laz")),
+        std::make_shared<mem_source>(contents.data(), contents.size()),
+        std::make_shared<cached_source>(
+            std::make_shared<file_source>(testFile("autzen_trim.laz"))) };
+    for (auto& source : sources)
+        for (size_t threads : { 0, 3 })
+        {
+            reader::source_file f(source);
+            f.setThreads(threads);
+            std::vector<char> points(all.size());
+            EXPECT_EQ(f.readPoints(points.data(), fin.count_), fin.count_);
+            EXPECT_TRUE(points == all);
+        }
+}
+
+TEST(io_tests, can_read_columns)
+{
+    struct Xyz
+    {
+        int32_t x;
+        int32_t y;
+        int32_t z;
+    };
+
+    // Random point data can have NaN GPS times, so compare the bits.
+    auto bits = [](double d)
+    {
+        uint64_t u;
+        memcpy(&u, &d, sizeof(u));
+        return u;
+    };
+
+    // Read the points of a file as records and as columns and check that they match.
+    auto check = [&bits](const std::string& filename, size_t threads)
+    {
+        reader::named_file f1(filename);
+        reader::named_file f2(filename);
+        f2.setThreads(threads);
+
+        const int pdrf = f1.header().point_format_id;
+        const size_t ebCount = f1.header().ebCount();
+        const size_t pointLen = f1.header().point_record_length;
+        const size_t count = f1.pointCount();
+
+        // XYZ are interleaved to check the stride.
+        std::vector<Xyz> xyz(count);
+        std::vector<uint16_t> intensity(count);
+        std::vector<uint8_t> classification(count);
+        std::vector<uint8_t> flags(count);
+        std::vector<double> gpsTime(count);
+        std::vector<uint16_t> blue(count);
+        std::vector<uint16_t> nir(count);
+        std::vector<uint8_t> eb(count * ebCount);
+
+        point_columns cols;
+        cols.x = column<int32_t>(&xyz[0].x, sizeof(Xyz));
+        cols.y = column<int32_t>(&xyz[0].y, sizeof(Xyz));
+        cols.z = column<int32_t>(&xyz[0].z, sizeof(Xyz));
+        cols.intensity = intensity.data();
+        cols.classification = classification.data();
+        cols.classification_flags = flags.data();
+        cols.gps_time = gpsTime.data();
+        cols.blue = blue.data();
+        cols.nir = nir.data();
+        if (ebCount)
+            cols.extra_bytes = column<uint8_t>(eb.data(), ebCount);
+
+        // Read in batches that don't line up with the chunks.
+        size_t total = 0;
+        while (size_t n = f2.readColumns(cols, 7777))
+        {
+            cols.advance(n);
+            total += n;
+        }
+        ASSERT_EQ(total, count);
+
+        std::vector<char> buf(pointLen);
+        for (size_t i = 0; i < count; ++i)
+        {
+            f1.readPoint(buf.data());
+            const char *pos = buf.data();
+            std::string msg = "Point " + std::to_string(i) + " of " + filename + " differs.";
+            if (pdrf < 6)
+            {
+                las::point10 p(pos);
+                pos += sizeof(las::point10);
+                ASSERT_EQ(xyz[i].x, p.x) << msg;
+                ASSERT_EQ(xyz[i].y, p.y) << msg;
+                ASSERT_EQ(xyz[i].z, p.z) << msg;
+                ASSERT_EQ(intensity[i], p.intensity) << msg;
+                ASSERT_EQ(classification[i], p.classification) << msg;
+                if (pdrf == 1 || pdrf == 3)
+                {
+                    ASSERT_EQ(bits(gpsTime[i]), bits(utils::unpack<double>(pos))) << msg;
+                    pos += sizeof(las::gpstime);
+                }
+                if (pdrf == 2 || pdrf == 3)
+                {
+                    ASSERT_EQ(blue[i], las::rgb(pos).b) << msg;
+                    pos += sizeof(las::rgb);
+                }
+            }
+            else
+            {
+                las::point14 p(pos);
+                pos += sizeof(las::point14);
+                ASSERT_EQ(xyz[i].x, p.x()) << msg;
+                ASSERT_EQ(xyz[i].y, p.y()) << msg;
+                ASSERT_EQ(xyz[i].z, p.z()) << msg;
+                ASSERT_EQ(intensity[i], p.intensity()) << msg;
+                ASSERT_EQ(classification[i], p.classification()) << msg;
+                ASSERT_EQ(flags[i], p.classFlags()) << msg;
+                ASSERT_EQ(bits(gpsTime[i]), bits(p.gpsTime())) << msg;
+                if (pdrf == 7 || pdrf == 8)
+                {
+                    ASSERT_EQ(blue[i], las::rgb(pos).b) << msg;
+                    pos += sizeof(las::rgb);
+                }
+                if (pdrf == 8)
+                {
+                    ASSERT_EQ(nir[i], las::nir14(pos).val) << msg;
+                    pos += sizeof(las::nir14);
+                }
+            }
+            ASSERT_TRUE(std::equal(pos, pos + ebCount, (const char *)eb.data() + i * ebCount)) <<
+                msg;
+        }
+    };
+
+    std::string filename(makeTempFileName());
+    makeRandom14(filename, 8, 5, 25000, 10000);
+    for (size_t threads : { 0, 2 })
+    {
+        check(testFile("autzen_trim.laz"), threads);
+        check(testFile("autzen_trim.las"), threads);
+        check(filename, threads);
+    }
+}
+
+TEST(io_tests, can_read_scaled_coordinates)
+{
+    struct World
+    {
+        double x;
+        double y;
+        double z;
+    };
+
+    for (size_t threads : { 0, 2 })
+    {
+        reader::named_file f(testFile("autzen_trim.laz"));
+        f.setThreads(threads);
+        const header14& h = f.header();
+        const size_t count = f.pointCount();
+
+        std::vector<int32_t> x(count);
+        std::vector<int32_t> z(count);
+        std::vector<World> world(count);
+        std::vector<float> localX(count);
+        std::vector<float> localY(count);
+
+        // World coordinates are interleaved and local coordinates are contiguous
+        // to exercise both conversion paths.
+        point_columns cols;
+        cols.x = x.data();
+        cols.z = z.data();
+        cols.world_x = column<double>(&world[0].x, sizeof(World));
+        cols.world_y = column<double>(&world[0].y, sizeof(World));
+        cols.world_z = column<double>(&world[0].z, sizeof(World));
+        cols.local_x = localX.data();
+        cols.local_y = localY.data();
+        cols.origin[0] = h.minx;
+        cols.origin[1] = h.miny;
+        ASSERT_EQ(f.readColumns(cols, count), count);
+
+        reader::named_file f2(testFile("autzen_trim.laz"));
+        std::vector<char> buf(h.point_record_length);
+        for (size_t i = 0; i < count; ++i)
+        {
+            f2.readPoint(buf.data());
+            las::point10 p(buf.data());
+            ASSERT_EQ(x[i], p.x);
+            ASSERT_EQ(z[i], p.z);
+            ASSERT_EQ(world[i].x, p.x * h.scale.x + h.offset.x);
+            ASSERT_EQ(world[i].y, p.y * h.scale.y + h.offset.y);
+            ASSERT_EQ(world[i].z, p.z * h.scale.z + h.offset.z);
+            ASSERT_EQ(localX[i], (float)(p.x * h.scale.x + (h.offset.x - h.minx)));
+            ASSERT_EQ(localY[i], (float)(p.y * h.scale.y + (h.offset.y - h.miny)));
+        }
+    }
+}
+
+TEST(io_tests, can_query_points)
+{
+    checkExists(testFile("autzen_trim.laz"));
+    checkExists(testFile("autzen_trim.las"));
+
+    reader::named_file fin(testFile("autzen_trim.las"));
+    const header14& h = fin.header();
+    const size_t pointLen = h.point_record_length;
+    std::vector<char> all(fin.pointCount() * pointLen);
+    fin.readPoints(all.data(), fin.pointCount());
+
+    auto position = [&h](const char *p)
+    {
+        return vector3(utils::unpack<int32_t>(p) * h.scale.x + h.offset.x,
+            utils::unpack<int32_t>(p + 4) * h.scale.y + h.offset.y,
+            utils::unpack<int32_t>(p + 8) * h.scale.z + h.offset.z);
+    };
+
+    // A small window in the middle of the data and one that contains everything.
+    double cx = (h.maxx + h.minx) / 2;
+    double cy = (h.maxy + h.miny) / 2;
+    double dx = (h.maxx - h.minx) / 20;
+    double dy = (h.maxy - h.miny) / 20;
+    const box queries[] = {
+        box(vector3(cx - dx, cy - dy, h.minz), vector3(cx + dx, cy + dy, h.maxz)),
+        box(vector3(h.minx, h.miny, h.minz), vector3(h.maxx, h.maxy, h.maxz)) };
+    for (const box& query : queries)
+    {
+        std::vector<char> expected;
+        for (const char *p = all.data(); p < all.data() + all.size(); p += pointLen)
+        {
+            vector3 v = position(p);
+            if (query.contains(v.x, v.y, v.z))
+                expected.insert(expected.end(), p, p + pointLen);
+        }
+        ASSERT_FALSE(expected.empty());
+
+        for (size_t threads : { 0, 2 })
+            for (const char *filename : { "autzen_trim.laz", "autzen_trim.las" })
+            {
+                reader::named_file f(testFile(filename));
+                f.setThreads(threads);
+
+                // Read in small batches to check that reading picks up where it left off.
+                std::vector<char> found;
+                std::vector<char> buf(1000 * pointLen);
+                while (size_t n = f.queryPoints(query, buf.data(), 1000))
+                    found.insert(found.end(), buf.begin(), buf.begin() + n * pointLen);
+                EXPECT_TRUE(expected == found) << filename << " with " << threads <<
+                    " threads.";
+            }
+    }
+
+    reader::named_file f(testFile("autzen_trim.laz"));
+    const std::vector<box>& bounds = f.chunkBounds();
+    ASSERT_EQ(bounds.size(), 3u);
+    const char *p = all.data();
+    for (size_t i = 0; i < bounds.size(); ++i)
+        for (size_t j = 0; j < f.chunkPointCount(i); ++j, p += pointLen)
+        {
+            vector3 v = position(p);
+            ASSERT_TRUE(bounds[i].contains(v.x, v.y, v.z));
+        }
+}
+
+TEST(io_tests, can_use_chunk_index)
+{
+    checkExists(testFile("autzen_trim.laz"));
+
+    EXPECT_EQ(chunk_index::filename("/a.b/c.laz"), "/a.b/c.lzi");
+    EXPECT_EQ(chunk_index::filename("/a.b/c"), "/a.b/c.lzi");
+
+    reader::named_file f1(testFile("autzen_trim.laz"));
+    const header14& h = f1.header();
+    const size_t pointLen = h.point_record_length;
+    std::vector<char> all(f1.pointCount() * pointLen);
+    f1.readPoints(all.data(), f1.pointCount());
+    const chunk_index& index = f1.chunkIndex();
+    ASSERT_EQ(index.bounds.size(), 3u);
+
+    // Check the time ranges of the chunks and find a query range.
+    double minTime = (std::numeric_limits<double>::max)();
+    double maxTime = (std::numeric_limits<double>::lowest)();
+    const char *p = all.data();
+    for (size_t i = 0; i < index.bounds.size(); ++i)
+        for (size_t j = 0; j < f1.chunkPointCount(i); ++j, p += pointLen)
+        {
+            double t = utils::unpack<double>(p + sizeof(las::point10));
+            ASSERT_GE(t, index.min_time[i]);
+            ASSERT_LE(t, index.max_time[i]);
+            minTime = (std::min)(minTime, t);
+            maxTime = (std::max)(maxTime, t);
+        }
+    double t0 = minTime + (maxTime - minTime) / 3;
+    double t1 = maxTime - (maxTime - minTime) / 3;
+
+    std::string filename(makeTempFileName());
+    index.write(filename);
+
+    reader::named_file f2(testFile("autzen_trim.laz"));
+    ASSERT_TRUE(f2.loadIndex(filename));
+    const chunk_index& index2 = f2.chunkIndex();
+    ASSERT_EQ(index2.bounds.size(), index.bounds.size());
+    for (size_t i = 0; i < index.bounds.size(); ++i)
+    {
+        EXPECT_TRUE(index2.bounds[i].min == index.bounds[i].min);
+        EXPECT_TRUE(index2.bounds[i].max == index.bounds[i].max);
+        EXPECT_EQ(index2.min_time[i], index.min_time[i]);
+        EXPECT_EQ(index2.max_time[i], index.max_time[i]);
+    }
+
+    box all3d(vector3(h.minx, h.miny, h.minz), vector3(h.maxx, h.maxy, h.maxz));
+    std::vector<char> expected;
+    for (const char *p = all.data(); p < all.data() + all.size(); p += pointLen)
+    {
+        double t = utils::unpack<double>(p + sizeof(las::point10));
+        if (t >= t0 && t <= t1)
+            expected.insert(expected.end(), p, p + pointLen);
+    }
+    ASSERT_FALSE(expected.empty());
+    std::vector<char> found(all.size());
+    size_t n = f2.queryPoints(all3d, t0, t1, found.data(), f2.pointCount());
+    found.resize(n * pointLen);
+    EXPECT_TRUE(expected == found);
+
+    // An index for another file isn't used.
+    std::string otherName(makeTempFileName());
+    makeRandom14(otherName, 6, 0, 100);
+    reader::named_file other(otherName);
+    other.chunkIndex().write(filename);
+    reader::named_file f3(testFile("autzen_trim.laz"));
+    EXPECT_FALSE(f3.loadIndex(filename));
+    EXPECT_FALSE(f3.loadIndex(filename + "xxx"));
+
+    std::remove(filename.c_str());
+    std::remove(otherName.c_str());
+}
+
+namespace
+{
+
+struct CopcNode
+{
+    copc_entry entry;
+    std::vector<char> points;
+};
+
+// Write a small COPC file by writing each node as a chunk of a variable-chunk LAZ file
+// and then appending the COPC info and hierarchy EVLRs. The node (1, 1, 1, 1) and its
+// child are in a separate hierarchy page.
+std::vector<CopcNode> makeCopc(const std::string& filename)
+{
+    writer::named_file::config c(vector3(.01, .01, .01), vector3(0, 0, 0), VariableChunkSize);
+    c.minor_version = 4;
+    c.pdrf = 6;
+
+    std::vector<CopcNode> nodes {
+        { { 0, 0, 0, 0, 0, 0, 100 }, {} },
+        { { 1, 0, 0, 0, 0, 0, 50 }, {} },
+        { { 1, 1, 1, 1, 0, 0, 50 }, {} },
+        { { 2, 3, 3, 3, 0, 0, 30 }, {} } };
+
+    std::mt19937 gen(1234);
+    {
+        writer::named_file w(filename, c);
+        uint64_t offset = w.firstChunkOffset();
+        for (size_t i = 0; i < nodes.size(); ++i)
+        {
+            CopcNode& n = nodes[i];
+            double size = 100.0 / (1 << n.entry.depth);
+            std::uniform_real_distribution<> dist(0, size);
+            n.points.resize(n.entry.point_count * sizeof(las::point14));
+            for (int32_t j = 0; j < n.entry.point_count; ++j)
+            {
+                las::point14 p;
+                p.setX((int32_t)((n.entry.x * size + dist(gen)) * 100));
+                p.setY((int32_t)((n.entry.y * size + dist(gen)) * 100));
+                p.setZ((int32_t)((n.entry.z * size + dist(gen)) * 100));
+                p.setGpsTime(j);
+                char *buf = n.points.data() + j * sizeof(las::point14);
+                memcpy(buf, &p, sizeof(p));
+                w.writePoint(buf);
+            }
+            n.entry.offset = offset;
+            if (i + 1 < nodes.size())
+            {
+                offset = w.newChunk();
+                n.entry.byte_size = (int32_t)(offset - n.entry.offset);
+            }
+        }
+        w.close();
+    }
+
+    std::fstream f(filename, std::ios::binary | std::ios::in | std::ios::out);
+    header14 h = header14::create(f);
+
+    // The last chunk ends where the chunk table begins.
+    uint64_t tableOffset;
+    f.seekg(h.point_offset);
+    f.read((char *)&tableOffset, sizeof(tableOffset));
+    nodes.back().entry.byte_size = (int32_t)(tableOffset - nodes.back().entry.offset);
+
+    f.seekp(0, std::ios::end);
+    h.evlr_offset = f.tellp();
+    h.evlr_count = 2;
+
+    copc_info_vlr info;
+    info.center_x = info.center_y = info.center_z = 50;
+    info.halfsize = 50;
+    info.spacing = 1;
+    info.root_hier_offset = h.evlr_offset + 2 * evlr_header::Size + info.size();
+    info.root_hier_size = 3 * copc_entry::Size;
+    info.gpstime_minimum = 0;
+    info.gpstime_maximum = 99;
+    info.eheader().write(f);
+    info.write(f);
+
+    copc_entry pageEntry = nodes[2].entry;
+    pageEntry.offset = info.root_hier_offset + info.root_hier_size;
+    pageEntry.byte_size = 2 * copc_entry::Size;
+    pageEntry.point_count = -1;
+    std::vector<copc_entry> entries { nodes[0].entry, nodes[1].entry, pageEntry,
+        nodes[2].entry, nodes[3].entry };
+    evlr_header { 0, "copc", 1000, entries.size() * copc_entry::Size, "" }.write(f);
+    for (const copc_entry& e : entries)
+    {
+        std::vector<char> buf = e.data();
+        f.write(buf.data(), buf.size());
+    }
+
+    f.seekp(0);
+    h.write(f);
+    return nodes;
+}
+
+} // unnamed namespace
+
+TEST(io_tests, can_read_copc)
+{
+    std::string filename(makeTempFileName());
+    std::vector<CopcNode> expected = makeCopc(filename);
+
+    reader::copc_file f(filename);
+    EXPECT_EQ(f.copcInfo().halfsize, 50);
+    EXPECT_EQ(f.pointCount(), 230u);
+
+    auto keys = [](const std::vector<copc_entry>& nodes)
+    {
+        std::vector<int32_t> keys;
+        for (const copc_entry& e : nodes)
+            keys.push_back(e.depth * 1000 + e.x * 100 + e.y * 10 + e.z);
+        return keys;
+    };
+
+    box all(vector3(0, 0, 0), vector3(100, 100, 100));
+    box high(vector3(80, 80, 80), vector3(90, 90, 90));
+    box low(vector3(10, 10, 10), vector3(20, 20, 20));
+    EXPECT_EQ(keys(f.nodes(all)), (std::vector<int32_t>{ 0, 1000, 1111, 2333 }));
+    EXPECT_EQ(keys(f.nodes(high)), (std::vector<int32_t>{ 0, 1111, 2333 }));
+    EXPECT_EQ(keys(f.nodes(high, 1)), (std::vector<int32_t>{ 0, 1111 }));
+    EXPECT_EQ(keys(f.nodes(low)), (std::vector<int32_t>{ 0, 1000 }));
+    EXPECT_TRUE(f.nodes(box(vector3(200, 200, 200), vector3(300, 300, 300))).empty());
+
+    box b = f.nodeBounds(expected[3].entry);
+    EXPECT_TRUE(b.min == vector3(75, 75, 75));
+    EXPECT_TRUE(b.max == vector3(100, 100, 100));
+
+    for (const copc_entry& e : f.nodes(all))
+    {
+        auto it = std::find_if(expected.begin(), expected.end(),
+            [&e](const CopcNode& n){ return n.entry.depth == e.depth && n.entry.x == e.x; });
+        ASSERT_TRUE(it != expected.end());
+        std::vector<char> buf(e.point_count * f.header().point_record_length);
+        f.readNode(e, buf.data());
+        EXPECT_TRUE(buf == it->points);
+    }
+    std::remove(filename.c_str());
+}
+
+TEST(io_tests, can_write_copc)
+{
+    std::string filename(makeTempFileName());
+
+    writer::copc_file::config c(vector3(.01, .01, .01), vector3(0, 0, 0), 6);
+    c.threads = 2;
+    c.resolution = 16;
+    c.max_depth = 6;
+    c.memory_limit = 30000;  // Force spilling.
+
+    // Half the points are at two locations so that some reach the deepest nodes.
+    const size_t count = 5000;
+    const size_t size = sizeof(las::point14);
+    std::vector<char> written(count * size);
+    std::mt19937 gen(4321);
+    std::uniform_int_distribution<int32_t> dist(0, 10000);
+    {
+        writer::copc_file w(filename, c);
+        for (size_t i = 0; i < count; ++i)
+        {
+            las::point14 p;
+            if (i % 2)
+            {
+                p.setX(dist(gen));
+                p.setY(dist(gen));
+                p.setZ(dist(gen));
+            }
+            else
+            {
+                p.setX((int32_t)(i % 4) * 1000 + 2000);
+                p.setY(5000);
+                p.setZ(5000);
+            }
+            // Set the corners of the bounds.
+            if (i < 2)
+            {
+                p.setX((int32_t)i * 10000);
+                p.setY((int32_t)i * 10000);
+                p.setZ((int32_t)i * 10000);
+            }
+            p.setGpsTime((double)i);
+            char *buf = written.data() + i * size;
+            memcpy(buf, &p, sizeof(p));
+            w.writePoint(buf);
+        }
+        w.close();
+    }
+
+    reader::copc_file f(filename);
+    EXPECT_EQ(f.pointCount(), count);
+    EXPECT_EQ(f.copcInfo().center_x, 50);
+    EXPECT_EQ(f.copcInfo().halfsize, 50);
+    EXPECT_EQ(f.copcInfo().spacing, 6.25);
+    EXPECT_EQ(f.copcInfo().gpstime_maximum, count - 1);
+
+    // Every point is in exactly one node and lies within the node's bounds.
+    std::vector<copc_entry> nodes = f.nodes(box(vector3(0, 0, 0), vector3(100, 100, 100)));
+    ASSERT_GT(nodes.size(), 1u);
+    EXPECT_EQ(nodes[0].depth, 0);
+    std::vector<std::string> read;
+    for (const copc_entry& e : nodes)
+    {
+        box b = f.nodeBounds(e);
+        std::vector<char> buf(e.point_count * size);
+        f.readNode(e, buf.data());
+        for (int32_t i = 0; i < e.point_count; ++i)
+        {
+            las::point14 p;
+            memcpy(&p, buf.data() + i * size, size);
+            EXPECT_TRUE(b.contains(p.x() * .01, p.y() * .01, p.z() * .01));
+            read.emplace_back(buf.data() + i * size, size);
+        }
+    }
+    std::vector<std::string> expected;
+    for (size_t i = 0; i < count; ++i)
+        expected.emplace_back(written.data() + i * size, size);
+    std::sort(read.begin(), read.end());
+    std::sort(expected.begin(), expected.end());
+    EXPECT_TRUE(read == expected);
+    std::remove(filename.c_str());
+}
+
 TEST(io_tests, can_encode_large_files)
 {
     checkExists(testFile("autzen_trim.laz"));
@@ -488,6 +1432,603 @@ TEST(io_tests, variable_chunks)
 }
 
 
+TEST(io_tests, can_compress_with_threads)
+{
+    checkExists(testFile("autzen_trim.las"));
+
+    // Write autzen with 'threads' compression threads. Variable-sized chunks are ended
+    // at pseudo-random points.
+    auto write = [](size_t threads, unsigned chunkSize)
+    {
+        std::string fname = makeTempFileName();
+        {
+            writer::named_file::config c({0.01, 0.01, 0.01}, {0.0, 0.0, 0.0}, chunkSize);
+            c.pdrf = 3;
+            writer::named_file f(fname, c);
+            f.setThreads(threads, 2);
+
+            test::reader fin(testFile("autzen_trim.las"));
+            std::mt19937 rd(4);
+            std::uniform_int_distribution<uint32_t> dist(500, 10000);
+            uint32_t remaining = dist(rd);
+            std::vector<char> p(fin.size_);
+            for (size_t i = 0; i < fin.count_; ++i)
+            {
+                fin.record(p.data());
+                f.writePoint(p.data());
+                if (chunkSize == VariableChunkSize && --remaining == 0)
+                {
+                    f.newChunk();
+                    remaining = dist(rd);
+                }
+            }
+            f.close();
+        }
+        std::vector<char> data = readFile(fname);
+        std::remove(fname.c_str());
+        return data;
+    };
+
+    for (unsigned chunkSize : { 5000u, 10000u, VariableChunkSize })
+    {
+        std::vector<char> serial = write(0, chunkSize);
+        EXPECT_TRUE(write(3, chunkSize) == serial);
+        EXPECT_TRUE(write(1, chunkSize) == serial);
+    }
+
+    // An empty file matches too.
+    std::string fname = makeTempFileName();
+    std::vector<char> serial;
+    for (size_t threads : { 0, 2 })
+    {
+        {
+            writer::named_file::config c({0.01, 0.01, 0.01}, {0.0, 0.0, 0.0});
+            c.pdrf = 7;
+            c.minor_version = 4;
+            writer::named_file f(fname, c);
+            f.setThreads(threads);
+            f.close();
+        }
+        if (threads)
+            EXPECT_TRUE(readFile(fname) == serial);
+        else
+            serial = readFile(fname);
+    }
+    std::remove(fname.c_str());
+}
+
+TEST(io_tests, can_write_points_in_bulk)
+{
+    checkExists(testFile("autzen_trim.las"));
+
+    test::reader fin(testFile("autzen_trim.las"));
+    const size_t size = fin.size_;
+    const size_t count = fin.count_;
+    std::vector<char> points(count * size);
+    for (size_t i = 0; i < count; ++i)
+        fin.record(points.data() + i * size);
+
+    auto write = [](const writer::named_file::config& c, size_t threads,
+        std::function<void(writer::named_file&)> fn)
+    {
+        std::string fname = makeTempFileName();
+        {
+            writer::named_file f(fname, c);
+            f.setThreads(threads);
+            fn(f);
+            f.close();
+        }
+        std::vector<char> data = readFile(fname);
+        std::remove(fname.c_str());
+        return data;
+    };
+
+    writer::named_file::config c({0.01, 0.01, 0.01}, {0.0, 0.0, 0.0}, 5000);
+    c.pdrf = 3;
+    for (unsigned chunkSize : { 5000u, 0u })
+    {
+        c.chunk_size = chunkSize;
+        std::vector<char> expected = write(c, 0, [&](writer::named_file& f)
+        {
+            for (size_t i = 0; i < count; ++i)
+                f.writePoint(points.data() + i * size);
+        });
+
+        // Batches of random size that cross chunk boundaries.
+        for (size_t threads : { 0, 2 })
+            EXPECT_TRUE(write(c, threads, [&](writer::named_file& f)
+            {
+                std::mt19937 gen(9);
+                std::uniform_int_distribution<size_t> dist(0, 7000);
+                size_t pos = 0;
+                while (pos < count)
+                {
+                    size_t n = (std::min)(dist(gen), count - pos);
+                    f.writePoints(points.data() + pos * size, n);
+                    pos += n;
+                }
+            }) == expected);
+    }
+
+    // Columns read from a file write the same file, including formats 6-8. The record
+    // offsets of each column are used directly as strided columns.
+    std::mt19937 gen(3);
+    std::uniform_int_distribution<int> dist(0, 255);
+    for (int format : { 0, 1, 3, 6, 8 })
+    {
+        writer::named_file::config c({0.01, 0.01, 0.01}, {1.0, 2.0, 3.0}, 1000);
+        c.pdrf = format;
+        c.minor_version = format >= 6 ? 4 : 2;
+        c.extra_bytes = 3;
+        const size_t len = baseCount(format) + c.extra_bytes;
+        const size_t num = 4321;
+        std::vector<char> recs(num * len);
+        for (char& ch : recs)
+            ch = (char)dist(gen);
+        std::vector<char> expected = write(c, 0, [&](writer::named_file& f)
+        {
+            f.writePoints(recs.data(), num);
+        });
+
+        std::string fname = makeTempFileName();
+        {
+            std::ofstream out(fname, std::ios::binary);
+            out.write(expected.data(), expected.size());
+        }
+        reader::named_file r(fname);
+        std::vector<int32_t> x(num), y(num), z(num);
+        std::vector<uint16_t> intensity(num), psid(num), red(num), green(num), blue(num),
+            nir(num);
+        std::vector<uint8_t> rn(num), nr(num), cf(num), sc(num), sd(num), eof(num), cls(num),
+            ud(num), eb(num * 3);
+        std::vector<int16_t> angle(num);
+        std::vector<double> gps(num);
+        point_columns cols;
+        cols.x = column<int32_t>(x.data());
+        cols.y = column<int32_t>(y.data());
+        cols.z = column<int32_t>(z.data());
+        cols.intensity = column<uint16_t>(intensity.data());
+        cols.return_number = column<uint8_t>(rn.data());
+        cols.number_of_returns = column<uint8_t>(nr.data());
+        cols.classification_flags = column<uint8_t>(cf.data());
+        cols.scanner_channel = column<uint8_t>(sc.data());
+        cols.scan_direction_flag = column<uint8_t>(sd.data());
+        cols.edge_of_flight_line = column<uint8_t>(eof.data());
+        cols.classification = column<uint8_t>(cls.data());
+        cols.user_data = column<uint8_t>(ud.data());
+        cols.scan_angle = column<int16_t>(angle.data());
+        cols.point_source_id = column<uint16_t>(psid.data());
+        cols.gps_time = column<double>(gps.data());
+        cols.red = column<uint16_t>(red.data());
+        cols.green = column<uint16_t>(green.data());
+        cols.blue = column<uint16_t>(blue.data());
+        cols.nir = column<uint16_t>(nir.data());
+        cols.extra_bytes = column<uint8_t>(eb.data(), 3);
+        EXPECT_EQ(r.readColumns(cols, num), num);
+        std::remove(fname.c_str());
+
+        EXPECT_TRUE(write(c, 0, [&](writer::named_file& f)
+        {
+            f.writeColumns(cols, 1000);
+            point_columns rest(cols);
+            rest.advance(1000);
+            // Strided coordinates aren't used in place.
+            rest.x = column<int32_t>(reinterpret_cast<int32_t *>(recs.data() + 1000 * len), len);
+            f.writeColumns(rest, num - 1000);
+        }) == expected);
+    }
+}
+
+TEST(io_tests, can_write_world_coordinates)
+{
+    const size_t num = 3000;
+    std::mt19937 gen(8);
+    std::uniform_int_distribution<int32_t> dist(-10000000, 10000000);
+    std::vector<int32_t> raw(3 * num);
+    std::vector<double> world(3 * num);
+    const double scale[] { .01, .001, .01 };
+    const double offset[] { 1000, -20, 0 };
+    for (size_t i = 0; i < num; ++i)
+        for (int d = 0; d < 3; ++d)
+        {
+            raw[3 * i + d] = dist(gen);
+            world[3 * i + d] = raw[3 * i + d] * scale[d] + offset[d];
+        }
+
+    auto write = [num](const vector3& scale, const vector3& offset, const point_columns& cols)
+    {
+        std::string fname = makeTempFileName();
+        {
+            writer::named_file::config c(scale, offset, 1000);
+            c.pdrf = 6;
+            c.minor_version = 4;
+            writer::named_file f(fname, c);
+            f.writeColumns(cols, num);
+            f.close();
+        }
+        return fname;
+    };
+
+    point_columns rawCols;
+    rawCols.x = column<int32_t>(raw.data(), 3 * sizeof(int32_t));
+    rawCols.y = column<int32_t>(raw.data() + 1, 3 * sizeof(int32_t));
+    rawCols.z = column<int32_t>(raw.data() + 2, 3 * sizeof(int32_t));
+    point_columns worldCols;
+    worldCols.world_x = column<double>(world.data(), 3 * sizeof(double));
+    worldCols.world_y = column<double>(world.data() + 1, 3 * sizeof(double));
+    worldCols.world_z = column<double>(world.data() + 2, 3 * sizeof(double));
+
+    const vector3 s(scale[0], scale[1], scale[2]);
+    const vector3 o(offset[0], offset[1], offset[2]);
+    std::string rawName = write(s, o, rawCols);
+    std::string worldName = write(s, o, worldCols);
+    EXPECT_TRUE(readFile(rawName) == readFile(worldName));
+    std::remove(rawName.c_str());
+    std::remove(worldName.c_str());
+
+    // A coordinate that doesn't fit with the scale throws.
+    {
+        std::string fname = makeTempFileName();
+        writer::named_file::config c(s, o, 1000);
+        writer::named_file f(fname, c);
+        std::vector<double> bad(world);
+        bad[3 * 100] = 1e10;
+        point_columns cols(worldCols);
+        cols.world_x = column<double>(bad.data(), 3 * sizeof(double));
+        EXPECT_THROW(f.writeColumns(cols, num), error);
+        std::remove(fname.c_str());
+    }
+
+    // A scale of zero is chosen from the extent, as is the offset. X and Z span 2e5, so
+    // the scale is the power of ten just above 2e5 / 2^24.
+    std::string autoName = write(vector3(0, .01, 0), vector3(0, -20, 0), worldCols);
+    {
+        reader::named_file r(autoName);
+        const header14& h = r.header();
+        EXPECT_DOUBLE_EQ(h.scale.x, .1);
+        EXPECT_DOUBLE_EQ(h.scale.y, .01);
+        EXPECT_DOUBLE_EQ(h.scale.z, .1);
+        EXPECT_NEAR(h.offset.x, 1000, 1e6);
+        EXPECT_EQ(h.offset.x, std::round(h.offset.x));
+        EXPECT_EQ(h.offset.y, -20);
+
+        std::vector<double> x(num), y(num), z(num);
+        point_columns cols;
+        cols.world_x = column<double>(x.data());
+        cols.world_y = column<double>(y.data());
+        cols.world_z = column<double>(z.data());
+        EXPECT_EQ(r.readColumns(cols, num), num);
+        for (size_t i = 0; i < num; ++i)
+        {
+            EXPECT_NEAR(x[i], world[3 * i], .05 + 1e-9);
+            EXPECT_NEAR(y[i], world[3 * i + 1], .005 + 1e-9);
+            EXPECT_NEAR(z[i], world[3 * i + 2], .05 + 1e-9);
+        }
+    }
+    std::remove(autoName.c_str());
+}
+
+TEST(io_tests, can_write_from_many_threads)
+{
+    checkExists(testFile("autzen_trim.las"));
+
+    test::reader fin(testFile("autzen_trim.las"));
+    const size_t size = fin.size_;
+    const size_t count = fin.count_;
+    std::vector<char> points(count * size);
+    for (size_t i = 0; i < count; ++i)
+        fin.record(points.data() + i * size);
+
+    std::string fname = makeTempFileName();
+    header12 expected;
+    {
+        writer::named_file::config c({0.01, 0.01, 0.01}, {0.0, 0.0, 0.0}, 5000);
+        c.pdrf = 3;
+        writer::named_file f(fname, c);
+        for (size_t i = 0; i < count; ++i)
+            f.writePoint(points.data() + i * size);
+        f.close();
+        reader::named_file r(fname);
+        expected = r.header();
+    }
+
+    // Each thread writes an interleaved quarter of the points.
+    const size_t numThreads = 4;
+    {
+        writer::named_file::config c({0.01, 0.01, 0.01}, {0.0, 0.0, 0.0}, 5000);
+        c.pdrf = 3;
+        writer::named_file f(fname, c);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < numThreads; ++t)
+            threads.emplace_back([&f, &points, t, size, count]()
+            {
+                writer::chunk_builder& b = f.newBuilder();
+                for (size_t i = t; i < count; i += numThreads)
+                    b.writePoint(points.data() + i * size);
+            });
+        for (std::thread& t : threads)
+            t.join();
+        EXPECT_THROW(f.writePoint(points.data()), error);
+        f.close();
+    }
+
+    reader::named_file r(fname);
+    const header14& h = r.header();
+    EXPECT_EQ(r.pointCount(), count);
+    EXPECT_EQ(r.lazVlr().chunk_size, VariableChunkSize);
+    EXPECT_GE(r.chunkCount(), numThreads * (count / numThreads / 5000));
+    EXPECT_DOUBLE_EQ(h.minx, expected.minx);
+    EXPECT_DOUBLE_EQ(h.miny, expected.miny);
+    EXPECT_DOUBLE_EQ(h.minz, expected.minz);
+    EXPECT_DOUBLE_EQ(h.maxx, expected.maxx);
+    EXPECT_DOUBLE_EQ(h.maxy, expected.maxy);
+    EXPECT_DOUBLE_EQ(h.maxz, expected.maxz);
+
+    // The points are in a different order, so compare them sorted.
+    std::vector<char> out(count * size);
+    EXPECT_EQ(r.readPoints(out.data(), count), count);
+    auto sorted = [size, count](const std::vector<char>& buf)
+    {
+        std::vector<std::string> v;
+        for (size_t i = 0; i < count; ++i)
+            v.emplace_back(buf.data() + i * size, size);
+        std::sort(v.begin(), v.end());
+        return v;
+    };
+    EXPECT_TRUE(sorted(out) == sorted(points));
+    std::remove(fname.c_str());
+}
+
+TEST(io_tests, can_write_chunk_stats)
+{
+    std::mt19937 gen(5);
+    std::uniform_int_distribution<int> dist(0, 255);
+    for (int format : { 1, 6 })
+    {
+        writer::named_file::config c({0.01, 0.01, 0.01}, {1.0, 2.0, 3.0}, 1000);
+        c.pdrf = format;
+        c.minor_version = 4;
+        const size_t len = baseCount(format);
+        const size_t timePos = format == 1 ? 20 : 22;
+        const size_t num = 4321;
+        std::vector<char> recs(num * len);
+        for (char& ch : recs)
+            ch = (char)dist(gen);
+        for (size_t i = 0; i < num; ++i)
+            utils::pack((double)(i % 1500), recs.data() + i * len + timePos);
+
+        // The statistics don't depend on how the points are written.
+        std::vector<char> expected;
+        for (size_t threads : { 0, 2 })
+        {
+            std::string fname = makeTempFileName();
+            {
+                writer::named_file f(fname, c);
+                f.setThreads(threads);
+                f.setChunkStats();
+                if (threads)
+                    f.writePoints(recs.data(), num);
+                else
+                    for (size_t i = 0; i < num; ++i)
+                        f.writePoint(recs.data() + i * len);
+                EXPECT_THROW(f.setChunkStats(false), error);
+                f.close();
+            }
+            std::vector<char> data = readFile(fname);
+            if (expected.empty())
+                expected = data;
+            EXPECT_TRUE(data == expected);
+
+            reader::named_file r(fname);
+            const chunk_stats_vlr& stats = r.chunkStats();
+            ASSERT_EQ(stats.chunks.size(), r.chunkCount());
+            EXPECT_EQ(r.header().evlr_count, 1u);
+            const std::vector<box>& bounds = r.chunkBounds();
+            std::vector<char> buf(1000 * len);
+            for (size_t i = 0; i < r.chunkCount(); ++i)
+            {
+                const chunk_stats_vlr::entry& e = stats.chunks[i];
+                r.readChunk(i, buf.data());
+                chunk_stats_vlr::entry expect;
+                for (size_t j = 0; j < r.chunkPointCount(i); ++j)
+                {
+                    const char *p = buf.data() + j * len;
+                    expect.bounds.grow(utils::unpack<int32_t>(p) * .01 + 1.0,
+                        utils::unpack<int32_t>(p + 4) * .01 + 2.0,
+                        utils::unpack<int32_t>(p + 8) * .01 + 3.0);
+                    double t = utils::unpack<double>(p + timePos);
+                    expect.min_time = (std::min)(expect.min_time, t);
+                    expect.max_time = (std::max)(expect.max_time, t);
+                    uint8_t cls = format == 1 ? (p[15] & 0x1F) : (uint8_t)p[16];
+                    expect.classes[cls / 8] |= (uint8_t)(1 << (cls % 8));
+                    expect.returns[p[14] & (format == 1 ? 0x7 : 0xF)]++;
+                }
+                EXPECT_TRUE(e.bounds.min == expect.bounds.min);
+                EXPECT_TRUE(e.bounds.max == expect.bounds.max);
+                EXPECT_TRUE(bounds[i].min == e.bounds.min);
+                EXPECT_TRUE(bounds[i].max == e.bounds.max);
+                EXPECT_EQ(e.min_time, expect.min_time);
+                EXPECT_EQ(e.max_time, expect.max_time);
+                EXPECT_TRUE(std::equal(e.classes, e.classes + 32, expect.classes));
+                EXPECT_TRUE(std::equal(e.returns, e.returns + 16, expect.returns));
+            }
+
+            // Chunks without points of a time range aren't decoded.
+            std::vector<char> out(num * len);
+            size_t found = r.queryPoints(box(vector3(-1e9, -1e9, -1e9), vector3(1e9, 1e9, 1e9)),
+                1600, 2000, out.data(), num);
+            EXPECT_EQ(found, 0u);
+            r.seek(0);
+            found = r.queryPoints(box(vector3(-1e9, -1e9, -1e9), vector3(1e9, 1e9, 1e9)),
+                1000, 1100, out.data(), num);
+            EXPECT_EQ(found, 303u);
+            std::remove(fname.c_str());
+        }
+    }
+
+    // Statistics are only written to compressed LAS 1.4 files.
+    std::string fname = makeTempFileName();
+    writer::named_file::config c({0.01, 0.01, 0.01}, {0.0, 0.0, 0.0});
+    c.minor_version = 2;
+    writer::named_file f(fname, c);
+    EXPECT_THROW(f.setChunkStats(), error);
+    f.close();
+    std::remove(fname.c_str());
+}
+
+TEST(io_tests, can_write_to_a_stream)
+{
+    checkExists(testFile("autzen_trim.las"));
+
+    // Output that can't be repositioned, like a pipe.
+    struct pipe_buf : public std::streambuf
+    {
+        std::string data;
+
+        int_type overflow(int_type c) override
+        {
+            if (!traits_type::eq_int_type(c, traits_type::eof()))
+                data.push_back(traits_type::to_char_type(c));
+            return traits_type::not_eof(c);
+        }
+
+        std::streamsize xsputn(const char *s, std::streamsize n) override
+        {
+            data.append(s, (size_t)n);
+            return n;
+        }
+    };
+
+    test::reader fin(testFile("autzen_trim.las"));
+    const size_t size = fin.size_;
+    const size_t count = fin.count_;
+    std::vector<char> points(count * size);
+    for (size_t i = 0; i < count; ++i)
+        fin.record(points.data() + i * size);
+
+    writer::named_file::config c({0.01, 0.01, 0.01}, {0.0, 0.0, 0.0}, 5000);
+    c.pdrf = 3;
+    std::string fname = makeTempFileName();
+    {
+        writer::named_file f(fname, c);
+        f.writePoints(points.data(), count);
+        f.close();
+    }
+    std::vector<char> expected = readFile(fname);
+    std::remove(fname.c_str());
+    header12 h;
+    {
+        reader::mem_file r(expected.data(), expected.size());
+        h = c.to_header();
+        h.point_count = (uint32_t)r.pointCount();
+        h.minx = r.header().minx;
+        h.miny = r.header().miny;
+        h.minz = r.header().minz;
+        h.maxx = r.header().maxx;
+        h.maxy = r.header().maxy;
+        h.maxz = r.header().maxz;
+        h.point_offset = r.header().point_offset;
+    }
+
+    for (size_t threads : { 0, 2 })
+    {
+        pipe_buf buf;
+        std::ostream out(&buf);
+        writer::stream_file f(out, h, count, c.chunk_size);
+        f.setThreads(threads);
+        EXPECT_THROW(f.setChunkStats(), error);
+        f.writePoints(points.data(), count);
+        f.close();
+
+        // The output differs only in the chunk table offset, which is -1 and follows
+        // the chunk table.
+        std::vector<char> data(buf.data.begin(), buf.data.end());
+        ASSERT_EQ(data.size(), expected.size() + sizeof(int64_t));
+        const size_t tablePos = h.point_offset;
+        EXPECT_EQ(utils::unpack<int64_t>(data.data() + tablePos), -1);
+        EXPECT_EQ(utils::unpack<int64_t>(data.data() + expected.size()),
+            utils::unpack<int64_t>(expected.data() + tablePos));
+        std::copy(expected.data() + tablePos, expected.data() + tablePos + sizeof(int64_t),
+            data.data() + tablePos);
+        data.resize(expected.size());
+        EXPECT_TRUE(data == expected);
+
+        data.assign(buf.data.begin(), buf.data.end());
+        reader::mem_file r(data.data(), data.size());
+        EXPECT_EQ(r.pointCount(), count);
+        std::vector<char> in(count * size);
+        EXPECT_EQ(r.readPoints(in.data(), count), count);
+        EXPECT_TRUE(in == points);
+    }
+
+    // The point count must match the one given.
+    {
+        pipe_buf buf;
+        std::ostream out(&buf);
+        writer::stream_file f(out, h, count, c.chunk_size);
+        f.writePoints(points.data(), count - 1);
+        EXPECT_THROW(f.close(), error);
+    }
+
+    // World coordinates are quantized with the scale in the header, which must be set
+    // because the header can't be rewritten. LAS 1.4 allows more than 2^32 points.
+    const size_t num = 3000;
+    std::vector<double> world(3 * num);
+    for (size_t i = 0; i < world.size(); ++i)
+        world[i] = 1000.0 + (double)i * .25;
+    point_columns cols;
+    cols.world_x = column<double>(world.data(), 3 * sizeof(double));
+    cols.world_y = column<double>(world.data() + 1, 3 * sizeof(double));
+    cols.world_z = column<double>(world.data() + 2, 3 * sizeof(double));
+
+    writer::named_file::config wc({0.01, 0.01, 0.01}, {1000.0, 1000.0, 1000.0}, 1000);
+    wc.pdrf = 6;
+    wc.minor_version = 4;
+    header12 wh = wc.to_header();
+    {
+        pipe_buf buf;
+        std::ostream out(&buf);
+        writer::stream_file f(out, wh, num, wc.chunk_size);
+        f.writeColumns(cols, num);
+        f.close();
+
+        std::vector<char> data(buf.data.begin(), buf.data.end());
+        reader::mem_file r(data.data(), data.size());
+        ASSERT_EQ(r.pointCount(), num);
+        std::vector<double> x(num), y(num), z(num);
+        point_columns in;
+        in.world_x = column<double>(x.data());
+        in.world_y = column<double>(y.data());
+        in.world_z = column<double>(z.data());
+        EXPECT_EQ(r.readColumns(in, num), num);
+        for (size_t i = 0; i < num; ++i)
+        {
+            EXPECT_DOUBLE_EQ(x[i], world[3 * i]);
+            EXPECT_DOUBLE_EQ(y[i], world[3 * i + 1]);
+            EXPECT_DOUBLE_EQ(z[i], world[3 * i + 2]);
+        }
+    }
+    {
+        pipe_buf buf;
+        std::ostream out(&buf);
+        writer::stream_file f(out, wh, 5000000000ull, wc.chunk_size);
+        std::istringstream in(buf.data);
+        EXPECT_EQ(header14::create(in).point_count_14, 5000000000ull);
+    }
+    {
+        pipe_buf buf;
+        std::ostream out(&buf);
+        header12 zero(wh);
+        zero.scale.y = 0;
+        EXPECT_THROW(writer::stream_file(out, zero, num, wc.chunk_size), error);
+        header12 old(wh);
+        old.version.minor = 2;
+        old.point_format_id = 3;
+        old.point_record_length = (uint16_t)baseCount(3);
+        EXPECT_THROW(writer::stream_file(out, old, 5000000000ull, wc.chunk_size), error);
+    }
+}
+
 TEST(io_tests, compression_decompression_is_symmetric)
 {
     std::string fname = makeTempFileName();
@@ -580,6 +2121,30 @@ TEST(io_tests, can_decode_large_files_from_memory)
     }
 }
 
+TEST(io_tests, corrupt_chunks_decode_alike_in_memory)
+{
+    checkExists(testFile("autzen_trim.laz"));
+
+    std::vector<char> buf = readFile(testFile("autzen_trim.laz"));
+    uint32_t chunkStart;
+    {
+        reader::mem_file f(buf.data(), buf.size());
+        chunkStart = f.header().point_offset + sizeof(int64_t);
+    }
+    // Garble the first chunk. Decoding on the calling thread and on the decoding threads
+    // reads the same bytes, and neither reads past the end of the chunk.
+    std::fill(buf.begin() + chunkStart + 100, buf.begin() + chunkStart + 2000, (char)0xFF);
+
+    reader::mem_file f(buf.data(), buf.size());
+    const size_t size = f.header().point_record_length;
+    std::vector<char> sequential(f.chunkPointCount(0) * size);
+    f.readChunk(0, sequential.data());
+    f.setThreads(2);
+    std::vector<char> threaded(sequential.size());
+    f.readChunk(0, threaded.data());
+    EXPECT_TRUE(sequential == threaded);
+}
+
 TEST(io_tests, writes_bbox_to_header)
 {
     // First write a few points
@@ -35,11 +35,16 @@
 
 #include <ctime>
 #include <fstream>
+#include <limits>
+#include <random>
 
 #include <lazperf/encoder.hpp>
 #include <lazperf/decoder.hpp>
 #include <lazperf/writers.hpp>
 #include <lazperf/las.hpp>
+#include <lazperf/point_codec.hpp>
+#include <lazperf/readers.hpp>
+#include <lazperf/scale.hpp>
 
 #include "reader.hpp"
 
@@ -424,6 +429,296 @@ TEST(lazperf_tests, dynamic_compressor_works) {
 }
 
 
+TEST(lazperf_tests, can_decompress_from_memory)
+{
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int> dist(0, 255);
+    const size_t count = 5000;
+    const size_t ebCount = 2;
+
+    for (int format : { 0, 1, 2, 3, 6, 7, 8 })
+    {
+        const size_t size = baseCount(format) + ebCount;
+        std::vector<char> points(count * size);
+        for (size_t i = 0; i < points.size(); ++i)
+            points[i] = (char)(i % size < 12 ? dist(gen) % 4 : dist(gen));
+
+        MemoryStream s;
+        las_compressor::ptr compressor = build_las_compressor(s.outCb(), format, ebCount);
+        for (size_t i = 0; i < count; ++i)
+            compressor->compress(points.data() + i * size);
+        compressor->done();
+
+        las_decompressor::ptr decompressor =
+            build_las_decompressor(s.buf.data(), s.buf.size(), format, ebCount);
+        std::vector<char> out(points.size());
+        decompressor->decompressPoints(out.data(), count);
+        EXPECT_TRUE(out == points) << "Format " << format << " differs.";
+
+        // Truncated data decodes to garbage without reading past the end. It's the same
+        // garbage as when the data is read through a callback.
+        decompressor = build_las_decompressor(s.buf.data(), s.buf.size() / 2, format, ebCount);
+        decompressor->decompressPoints(out.data(), count);
+        SpanStream span(s.buf.data(), s.buf.size() / 2);
+        InputCb cb = [&span](unsigned char *b, size_t n){ span.getBytes(b, n); };
+        std::vector<char> cbOut(points.size());
+        build_las_decompressor(cb, format, ebCount)->decompressPoints(cbOut.data(), count);
+        EXPECT_TRUE(out == cbOut) << "Format " << format << " differs when truncated.";
+    }
+}
+
+TEST(lazperf_tests, layers_are_read_in_place)
+{
+    std::vector<unsigned char> data(100);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = (unsigned char)i;
+
+    // From a span, the layer points into the data.
+    SpanStream span(data.data(), data.size());
+    LayerSource source(span);
+    source.skip(10);
+    LayerStream layer;
+    source.readLayer(layer, 20);
+    EXPECT_EQ(layer.pos_, data.data() + 10);
+    EXPECT_EQ(layer.getByte(), 10);
+    EXPECT_EQ(source.getByte(), 30);
+
+    // A layer past the end of the span reads zeros, as when read through a callback.
+    source.readLayer(layer, 80);
+    EXPECT_EQ(layer.end_, data.data() + data.size());
+    unsigned char buf[80];
+    layer.getBytes(buf, 80);
+    EXPECT_EQ(buf[68], 99);
+    EXPECT_EQ(buf[69], 0);
+
+    // From a callback, the layer is copied, and so are copies of the layer.
+    SpanStream cbSpan(data.data(), data.size());
+    LayerSource cbSource([&cbSpan](unsigned char *b, size_t n){ cbSpan.getBytes(b, n); });
+    cbSource.readLayer(layer, 20);
+    LayerStream copy(layer);
+    EXPECT_NE(layer.pos_, data.data());
+    EXPECT_NE(copy.pos_, layer.pos_);
+    EXPECT_EQ(copy.getByte(), 0);
+    EXPECT_EQ(layer.getByte(), 0);
+}
+
+TEST(lazperf_tests, reset_matches_new_coders)
+{
+    std::mt19937 gen(11);
+    std::uniform_int_distribution<int> dist(0, 255);
+    const size_t count = 1000;
+    const size_t ebCount = 3;
+
+    for (int format : { 0, 1, 2, 3, 6, 7, 8 })
+    {
+        const size_t size = baseCount(format) + ebCount;
+        std::vector<std::vector<char>> chunks(3, std::vector<char>(count * size));
+        for (std::vector<char>& points : chunks)
+            for (size_t i = 0; i < points.size(); ++i)
+                points[i] = (char)(i % size < 12 ? dist(gen) % 4 : dist(gen));
+
+        // A compressor that's reset for each chunk writes what new ones do.
+        std::vector<std::vector<unsigned char>> expected;
+        for (std::vector<char>& points : chunks)
+        {
+            MemoryStream s;
+            las_compressor::ptr compressor = build_las_compressor(s.outCb(), format, ebCount);
+            for (size_t i = 0; i < count; ++i)
+                compressor->compress(points.data() + i * size);
+            compressor->done();
+            expected.push_back(s.buf);
+        }
+
+        MemoryStream s;
+        las_compressor::ptr compressor = build_las_compressor(s.outCb(), format, ebCount);
+        for (size_t c = 0; c < chunks.size(); ++c)
+        {
+            if (c)
+                compressor->reset();
+            s.buf.clear();
+            for (size_t i = 0; i < count; ++i)
+                compressor->compress(chunks[c].data() + i * size);
+            compressor->done();
+            EXPECT_TRUE(s.buf == expected[c]) << "Format " << format << " differs.";
+        }
+
+        // Stop part way through the first chunk to check that reset discards the state.
+        std::vector<char> out(count * size);
+        reader::chunk_decompressor d(format, ebCount, (const char *)expected[0].data(),
+            expected[0].size());
+        for (size_t i = 0; i < count / 2; ++i)
+            d.decompress(out.data() + i * size);
+        for (size_t c = 0; c < chunks.size(); ++c)
+        {
+            d.reset((const char *)expected[c].data(), expected[c].size());
+            for (size_t i = 0; i < count; ++i)
+                d.decompress(out.data() + i * size);
+            EXPECT_TRUE(out == chunks[c]) << "Format " << format << " differs.";
+        }
+        EXPECT_THROW(d.reset((const char *)expected[0].data()), error);
+    }
+}
+
+TEST(lazperf_tests, point_codec_matches_point_compressor)
+{
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<int> dist(0, 255);
+    const size_t count = 2000;
+    const size_t size = baseCount(3) + 2;
+
+    std::vector<char> points(count * size);
+    for (char& c : points)
+        c = (char)dist(gen);
+
+    MemoryStream expected;
+    point_compressor_3 compressor(expected.outCb(), 2);
+    for (size_t i = 0; i < count; ++i)
+        compressor.compress(points.data() + i * size);
+    compressor.done();
+
+    MemoryStream s;
+    point_codec<3, 2>::compressor<MemoryStream> codec(s);
+    for (size_t i = 0; i < count; ++i)
+        codec.compress(points.data() + i * size);
+    codec.done();
+    EXPECT_TRUE(s.buf == expected.buf);
+
+    SpanStream in(s.buf.data(), s.buf.size());
+    point_codec<3, VariableEbCount>::decompressor<SpanStream> decodec(in, 2);
+    std::vector<char> out(points.size());
+    decodec.decompressPoints(out.data(), count);
+    EXPECT_TRUE(out == points);
+}
+
+TEST(lazperf_tests, model_kernels_match_scalar)
+{
+    std::mt19937 gen(5);
+    std::uniform_int_distribution<uint32_t> dist(1, 1 << 15);
+
+    // Each vector version is run, as well as the one the CPU selects.
+    for (simd::Isa isa : { simd::Isa::Sse2, simd::Isa::Avx2, simd::best() })
+    {
+        if (!simd::supported(isa))
+            continue;
+
+        // Cover the vector widths and the scalar tails.
+        for (uint32_t symbols : { 2u, 3u, 5u, 8u, 13u, 64u, 255u, 256u, 1025u, 2048u })
+        {
+            std::vector<uint32_t> counts(symbols);
+            for (uint32_t& c : counts)
+                c = dist(gen) / symbols + 1;
+            std::vector<uint32_t> expected(counts);
+
+            uint32_t total = models::kernels::halve(counts.data(), symbols, isa);
+            EXPECT_EQ(total, models::kernels::halveScalar(expected.data(), symbols));
+            EXPECT_TRUE(counts == expected) << symbols << " symbols.";
+
+            uint32_t scale = 0x80000000U / total;
+            std::vector<uint32_t> d(symbols);
+            std::vector<uint32_t> expectedD(symbols);
+            models::kernels::distribute(counts.data(), d.data(), symbols, scale, isa);
+            models::kernels::distributeScalar(counts.data(), expectedD.data(), symbols, scale);
+            EXPECT_TRUE(d == expectedD) << symbols << " symbols.";
+        }
+    }
+}
+
+TEST(lazperf_tests, scale_kernels_match_scalar)
+{
+    std::mt19937 gen(6);
+    std::uniform_int_distribution<int32_t> dist((std::numeric_limits<int32_t>::min)(),
+        (std::numeric_limits<int32_t>::max)());
+
+    for (simd::Isa isa : { simd::Isa::Sse2, simd::Isa::Avx2 })
+    {
+        if (!simd::supported(isa))
+            continue;
+
+        // Cover the vector widths and the scalar tails.
+        for (size_t count : { 1, 3, 4, 7, 8, 9, 17, 1000 })
+        {
+            std::vector<int32_t> in(count);
+            for (int32_t& i : in)
+                i = dist(gen);
+
+            std::vector<double> d(count);
+            std::vector<double> expectedD(count);
+            scale::toDouble(in.data(), count, .01, 1000, (char *)d.data(), sizeof(double), isa);
+            scale::toDouble(in.data(), count, .01, 1000, (char *)expectedD.data(),
+                sizeof(double), simd::Isa::Scalar);
+            EXPECT_TRUE(d == expectedD) << count << " values.";
+
+            std::vector<float> f(count);
+            std::vector<float> expectedF(count);
+            scale::toFloat(in.data(), count, .01, 1000, (char *)f.data(), sizeof(float), isa);
+            scale::toFloat(in.data(), count, .01, 1000, (char *)expectedF.data(),
+                sizeof(float), simd::Isa::Scalar);
+            EXPECT_TRUE(f == expectedF) << count << " values.";
+
+            std::vector<int32_t> out(count);
+            std::vector<int32_t> expectedOut(count);
+            EXPECT_TRUE(scale::fromDouble((const char *)d.data(), count, sizeof(double), .01,
+                1000, out.data(), isa));
+            EXPECT_TRUE(scale::fromDouble((const char *)d.data(), count, sizeof(double), .01,
+                1000, expectedOut.data(), simd::Isa::Scalar));
+            EXPECT_TRUE(out == expectedOut) << count << " values.";
+
+            // A value out of range is found by the vector code and by the scalar tail.
+            d[count - 1] = 1e300;
+            EXPECT_FALSE(scale::fromDouble((const char *)d.data(), count, sizeof(double), .01,
+                1000, out.data(), isa));
+
+            int32_t min = (std::numeric_limits<int32_t>::max)();
+            int32_t max = (std::numeric_limits<int32_t>::min)();
+            int32_t expectedMin = min;
+            int32_t expectedMax = max;
+            scale::range(in.data(), count, min, max, isa);
+            scale::range(in.data(), count, expectedMin, expectedMax, simd::Isa::Scalar);
+            EXPECT_EQ(min, expectedMin);
+            EXPECT_EQ(max, expectedMax);
+        }
+    }
+}
+
+TEST(lazperf_tests, quantization_rounds_halves_away_from_zero)
+{
+    std::mt19937 gen(2);
+    std::uniform_real_distribution<double> dist(-1e6, 1e6);
+
+    std::vector<double> in { .5, -.5, 1.5, -1.5, 2.5, -2.5, .49999999999999994,
+        -.49999999999999994, 2147483647.4, -2147483648.4, 0, -0.0 };
+    for (int i = 0; i < 1001; ++i)
+        in.push_back(dist(gen));
+    for (int i = 0; i < 100; ++i)
+        in.push_back(std::floor(dist(gen)) + .5);
+
+    // Contiguous and strided input.
+    std::vector<double> strided(2 * in.size());
+    for (size_t i = 0; i < in.size(); ++i)
+        strided[2 * i] = in[i];
+    std::vector<int32_t> out(in.size());
+    std::vector<int32_t> outStrided(in.size());
+    EXPECT_TRUE(scale::fromDouble((const char *)in.data(), in.size(), sizeof(double), 1, 0,
+        out.data()));
+    EXPECT_TRUE(scale::fromDouble((const char *)strided.data(), in.size(),
+        2 * sizeof(double), 1, 0, outStrided.data()));
+    for (size_t i = 0; i < in.size(); ++i)
+    {
+        EXPECT_EQ(out[i], (int32_t)std::round(in[i])) << in[i];
+        EXPECT_EQ(outStrided[i], out[i]);
+    }
+
+    // Values that don't fit are reported wherever they are.
+    for (double bad : { 2147483647.5, -2147483648.5, 1e300, std::nan("") })
+        for (size_t pos : { (size_t)0, (size_t)5, in.size() - 1 })
+        {
+            std::vector<double> v(in);
+            v[pos] = bad;
+            EXPECT_FALSE(scale::fromDouble((const char *)v.data(), v.size(), sizeof(double),
+                1, 0, out.data()));
+        }
+}
+
 TEST(lazperf_tests, empty_file_write) {
 
     writer::named_file::config c({0.01,0.01,0.01}, {0.0,0.0,0.0});
@@ -0,0 +1,114 @@
+/******************************************************************************
+* Copyright (c) 2026, Hobu Inc., info@hobu.co
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following
+* conditions are met:
+*
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in
+*       the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of Hobu, Inc. or Flaxen Geo Consulting nor the
+*       names of its contributors may be used to endorse or promote
+*       products derived from this software without specific prior
+*       written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+* COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+* OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+* AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+* OF SUCH DAMAGE.
+****************************************************************************/
+
+
+// Write a sidecar chunk index for LAZ files so that queries can skip chunks without
+// first scanning the file.
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "chunk_index.hpp"
+#include "readers.hpp"
+
+void outputHelp();
+bool indexFile(const std::string& filename, size_t threads);
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+        outputHelp();
+
+    size_t threads = 0;
+    int argNum = 1;
+    if (std::string(argv[argNum]) == "-t")
+    {
+        if (argc < 4)
+            outputHelp();
+        size_t cnt;
+        std::string threadString = argv[argNum + 1];
+        threads = std::stoul(threadString, &cnt);
+        if (cnt != threadString.size())
+        {
+            std::cerr << "Invalid thread count '" << threadString << "'.\n";
+            return -1;
+        }
+        argNum += 2;
+    }
+
+    int ret = 0;
+    for (; argNum < argc; ++argNum)
+        if (!indexFile(argv[argNum], threads))
+            ret = -1;
+    return ret;
+}
+
+void outputHelp()
+{
+    std::cout << "lazindex [-t <threads>] <filename> [<filename> ...]\n";
+    exit(0);
+}
+
+bool indexFile(const std::string& filename, size_t threads)
+{
+    using namespace lazperf;
+
+    try
+    {
+        // A generic_file doesn't load any existing index, so the index is always
+        // computed from the points.
+        std::ifstream in(filename, std::ios::binary);
+        reader::generic_file f(in);
+        if (f.chunkCount() == 0)
+        {
+            std::cerr << filename << ": no compressed chunks. No index written.\n";
+            return false;
+        }
+        if (threads)
+            f.setThreads(threads);
+
+        const chunk_index& index = f.chunkIndex();
+        std::string indexFilename = chunk_index::filename(filename);
+        index.write(indexFilename);
+        std::cout << filename << ": indexed " << index.bounds.size() << " chunks to " <<
+            indexFilename << ".\n";
+    }
+    catch (const std::exception& err)
+    {
+        std::cerr << filename << ": " << err.what() << "\n";
+        return false;
+    }
+    return true;
+}